@@ -1,7 +1,70 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <Limits>
+#include <string_view>
+#include <limits>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <charconv>
+#include <random>
+#include <ctime>
+
+#ifdef _WIN32
+#include <io.h>
+#define fsync _commit
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VS_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Latency metrics on the hot paths; compiled out when NDEBUG is set (release builds)
+// unless VS_METRICS=1 is passed.
+#ifndef VS_METRICS
+#ifdef NDEBUG
+#define VS_METRICS 0
+#else
+#define VS_METRICS 1
+#endif
+#endif
 
 using namespace std;
 
@@ -16,62 +79,554 @@ enum class ElectionStatus
     CLOSED
 };
 
+enum class VoteStatus
+{
+    ACCEPTED,
+    ELECTION_NOT_FOUND,
+    ELECTION_NOT_OPEN,
+    CANDIDATE_NOT_FOUND,
+    VOTER_NOT_ALLOWED,
+    ALREADY_VOTED,
+    INVALID_RANKING, // ranked ballot that is empty or ranks a candidate twice
+    NOT_DURABLE // the vote log could not be written, so the vote was not recorded
+};
+
+inline const char *voteStatusName(VoteStatus status)
+{
+    switch (status)
+    {
+    case VoteStatus::ACCEPTED:
+        return "accepted";
+    case VoteStatus::ELECTION_NOT_FOUND:
+        return "election not found";
+    case VoteStatus::ELECTION_NOT_OPEN:
+        return "election not open";
+    case VoteStatus::CANDIDATE_NOT_FOUND:
+        return "candidate not in election";
+    case VoteStatus::VOTER_NOT_ALLOWED:
+        return "voter not allowed";
+    case VoteStatus::ALREADY_VOTED:
+        return "already voted";
+    case VoteStatus::INVALID_RANKING:
+        return "invalid ranking";
+    default:
+        return "not durable";
+    }
+}
+
+// Outcome of a VotingSystem edit: REJECTED left everything as it was,
+// NOT_DURABLE was applied in memory but its log record could not be written.
+enum class ChangeStatus
+{
+    APPLIED,
+    REJECTED,
+    NOT_DURABLE
+};
+
+// values are stored in snapshots, append only
+enum class UserRole
+{
+    VOTER,
+    CANDIDATE,
+    ADMIN
+};
+
+inline const char *roleName(UserRole role)
+{
+    switch (role)
+    {
+    case UserRole::CANDIDATE:
+        return "Candidate";
+    case UserRole::ADMIN:
+        return "Admin";
+    default:
+        return "Voter";
+    }
+}
+
+/* ---------- VotedSet ---------- */
+// Which voters already voted in one election.
+// Ids in a compact range live in a bitmap, ids far outside it go to a hash set.
+class VotedSet
+{
+private:
+    static const size_t minDenseBits = 4096;
+    static const size_t maxBitsPerVoter = 32; // keeps the bitmap from growing for a few huge ids
+
+    vector<uint64_t> bits;
+    unordered_set<int> sparse;
+    size_t count = 0;
+
+    bool inBitmap(int voterId) const
+    {
+        return voterId >= 0 && (size_t)voterId < bits.size() * 64;
+    }
+
+public:
+    bool contains(int voterId) const
+    {
+        if (inBitmap(voterId) && (bits[voterId / 64] >> (voterId % 64)) & 1)
+            return true;
+        return !sparse.empty() && sparse.count(voterId) > 0;
+    }
+
+    // Check-and-mark in one step: returns false if the voter was already there.
+    bool insert(int voterId)
+    {
+        if (contains(voterId))
+            return false;
+
+        size_t denseLimit = (count + 1) * maxBitsPerVoter;
+        if (denseLimit < minDenseBits)
+            denseLimit = minDenseBits;
+        if (!inBitmap(voterId) && voterId >= 0 && (size_t)voterId < denseLimit)
+            bits.resize(voterId / 64 + 1, 0);
+
+        if (inBitmap(voterId))
+            bits[voterId / 64] |= uint64_t(1) << (voterId % 64);
+        else
+            sparse.insert(voterId);
+
+        count++;
+        return true;
+    }
+
+    // Undoes insert; false if the voter was not there.
+    bool erase(int voterId)
+    {
+        if (inBitmap(voterId) && (bits[voterId / 64] >> (voterId % 64)) & 1)
+            bits[voterId / 64] &= ~(uint64_t(1) << (voterId % 64));
+        else if (sparse.empty() || !sparse.erase(voterId))
+            return false;
+        count--;
+        return true;
+    }
+
+    size_t size() const { return count; }
+
+    template <typename Fn>
+    void forEach(Fn fn) const
+    {
+        for (size_t w = 0; w < bits.size(); w++)
+        {
+            for (uint64_t word = bits[w]; word; word &= word - 1)
+                fn((int)(w * 64 + __builtin_ctzll(word)));
+        }
+        for (int id : sparse)
+            fn(id);
+    }
+
+    size_t memoryBytes() const
+    {
+        // bucket array + one node (next pointer, cached hash, value) per sparse id
+        return bits.capacity() * sizeof(uint64_t) +
+               sparse.bucket_count() * sizeof(void *) +
+               sparse.size() * (sizeof(void *) + sizeof(size_t) + sizeof(int));
+    }
+};
+
+/* ---------- CandidateResult ---------- */
+struct CandidateResult
+{
+    int candidateId;
+    long long votes;
+};
+
+/* ---------- CandidateTally ---------- */
+// One candidate's vote counter, split over cache-line sized stripes so
+// threads counting votes for the same candidate don't fight over one atomic.
+struct alignas(64) TallyStripe
+{
+    atomic<long long> votes{0};
+};
+
+class CandidateTally
+{
+private:
+    static const int stripeCount = 8; // power of two
+
+    TallyStripe stripes[stripeCount];
+    uint64_t id; // tells a re-added candidate's tally from the one removed before it
+
+public:
+    explicit CandidateTally(uint64_t tallyId) : id(tallyId) {}
+
+    uint64_t getId() const { return id; }
+
+    void add(int hint, long long count = 1)
+    {
+        stripes[hint & (stripeCount - 1)].votes.fetch_add(count, memory_order_relaxed);
+    }
+
+    long long total() const
+    {
+        long long sum = 0;
+        for (const TallyStripe &s : stripes)
+            sum += s.votes.load(memory_order_relaxed);
+        return sum;
+    }
+};
+
+/* ---------- RankingTrie ---------- */
+// Ranked ballots grouped by shared prefix. The ranking A > B > C walks
+// root -> A -> B -> C, adding one to each node's total on the way and one to
+// C's ending count, so identical rankings share every node and a runoff round
+// touches distinct prefixes rather than ballots.
+class RankingTrie
+{
+public:
+    struct Node
+    {
+        int candidateId;
+        uint32_t firstChild;  // 0 = none; node 0 is the root, never anyone's child
+        uint32_t nextSibling;
+        long long total;  // ballots through this node
+        long long ending; // ballots whose last preference is this node
+    };
+
+private:
+    vector<Node> nodes{Node{-1, 0, 0, 0, 0}};
+
+    template <typename Fn>
+    void forEachRankingFrom(uint32_t node, vector<int> &path, Fn &fn) const
+    {
+        for (uint32_t c = nodes[node].firstChild; c; c = nodes[c].nextSibling)
+        {
+            path.push_back(nodes[c].candidateId);
+            if (nodes[c].ending)
+                fn(path, nodes[c].ending);
+            forEachRankingFrom(c, path, fn);
+            path.pop_back();
+        }
+    }
+
+public:
+    void add(const int *ranking, size_t length, long long count = 1);
+
+    const vector<Node> &getNodes() const { return nodes; }
+    long long ballots() const { return nodes[0].total; }
+    size_t distinctPrefixes() const { return nodes.size() - 1; }
+    size_t memoryBytes() const { return nodes.capacity() * sizeof(Node); }
+
+    // fn(const vector<int> &ranking, long long ballots) once per distinct ranking
+    template <typename Fn>
+    void forEachRanking(Fn fn) const
+    {
+        vector<int> path;
+        forEachRankingFrom(0, path, fn);
+    }
+};
+
+// Instant-runoff count: every round each ballot counts for its highest ranked
+// candidate still in the race, and the last placed candidate drops out until
+// someone holds a majority of the ballots still counting.
+struct RunoffRound
+{
+    vector<CandidateResult> counts; // continuing candidates, most votes first
+    long long exhausted;            // ballots with no continuing candidate left
+    int eliminated;                 // dropped after this round, -1 in the final one
+};
+
+struct RunoffResult
+{
+    int winner = -1; // -1 without candidates or ballots
+    long long ballots = 0;
+    vector<RunoffRound> rounds;
+};
+
+// Head-to-head counts between every pair of an election's candidates.
+struct PairwiseMatrix
+{
+    vector<int> candidateIds; // ascending, as in the election
+    vector<long long> prefer; // row-major: prefer[i * n + j] ballots put i above j
+    long long ballots = 0;
+
+    long long at(size_t i, size_t j) const { return prefer[i * candidateIds.size() + j]; }
+};
+
+// Condorcet counts over one matrix. Schulze path strength is the winning-votes
+// measure: a link i -> j carries prefer[i][j] only when i beats j head to head.
+struct PairwiseResult
+{
+    PairwiseMatrix matrix;
+    int condorcetWinner = -1;         // beats every rival head to head; -1 if nobody does
+    int schulzeWinner = -1;           // unbeaten on strongest paths; -1 on a tie
+    vector<CandidateResult> copeland; // 2 points per head-to-head win, 1 per tie, most first
+    vector<CandidateResult> schulze;  // rivals beaten on strongest paths, most first
+};
+
+PairwiseResult tabulatePairwise(PairwiseMatrix matrix);
+
+class ThreadPool;
+
 /* ---------- Election ---------- */
+// Safe to vote into from many threads at once. Candidate list edits take the
+// lock exclusively, votes share it and only serialize per voter shard.
 class Election
 {
 private:
+    static const int voterShardCount = 16; // power of two
+
+    struct VoterShard
+    {
+        mutex lock;
+        VotedSet voted; // holds voterId / voterShardCount, keeps each bitmap compact
+    };
+
+    // hot fields first; title/description are only read for display
     int electionId;
+    atomic<ElectionStatus> status;
+    vector<int> candidateIds; // ✅ candidates inside election, kept sorted (flat set)
+    vector<unique_ptr<CandidateTally>> tallies; // same order as candidateIds
+    mutable shared_mutex candidatesLock; // also guards title and description
+    mutable VoterShard voterShards[voterShardCount]; // who already voted here
+    mutable mutex rankingLock; // after candidatesLock; also held while a ranked ballot's tally moves
+    RankingTrie rankings;      // full rankings of the ranked ballots; tallies hold their first choices
+    uint64_t talliesCreated = 0; // under candidatesLock
+    // reserved votes and batches not yet published or withdrawn; waitSettled sleeps
+    // on settledWake, which is only signalled once the election has closed
+    atomic<int> unsettled{0};
+    mutex settleLock;
+    condition_variable settledWake;
     string title;
     string description;
-    ElectionStatus status;
-    vector<int> candidateIds; // ✅ candidates inside election
+
+    VoterShard &shardFor(int voterId) const
+    {
+        return voterShards[(unsigned)voterId & (voterShardCount - 1)];
+    }
+    static int shardKey(int voterId) { return (int)((unsigned)voterId / voterShardCount); }
+
+    int findCandidateLocked(int candidateId) const
+    {
+        auto it = lower_bound(candidateIds.begin(), candidateIds.end(), candidateId);
+        return it != candidateIds.end() && *it == candidateId ? (int)(it - candidateIds.begin()) : -1;
+    }
+    // candidate slot of every trie node, -1 once removed from the election
+    vector<int> trieSlotsLocked() const;
+    // single-choice votes by slot: each tally less the ranked ballots that put that candidate first
+    vector<long long> singleChoiceVotesLocked(const vector<int> &slotOf) const;
+    VoteStatus checkRankingLocked(const vector<int> &ranking) const;
+    bool markVoter(int voterId); // false if the voter already voted here
+    // Counted before the open check, so a close either turns the reservation away
+    // or finds it in unsettled and waits for it.
+    bool beginReservation();
+    void settle();
 
 public:
     Election(int id, string t, string d)
-        : electionId(id), title(t), description(d),
-          status(ElectionStatus::CREATED) {}
+        : electionId(id), status(ElectionStatus::CREATED),
+          title(t), description(d) {}
 
     int getElectionId() const { return electionId; }
     ElectionStatus getStatus() const { return status; }
 
-    void open() { status = ElectionStatus::OPENED; }
-    void close() { status = ElectionStatus::CLOSED; }
+    // both return false if the election was not in the expected state
+    bool open()
+    {
+        ElectionStatus expected = ElectionStatus::CREATED;
+        return status.compare_exchange_strong(expected, ElectionStatus::OPENED);
+    }
+    bool close()
+    {
+        ElectionStatus expected = ElectionStatus::OPENED;
+        return status.compare_exchange_strong(expected, ElectionStatus::CLOSED);
+    }
 
     bool isOpen() const { return status == ElectionStatus::OPENED; }
 
-    void addCandidate(int candidateId)
+    // false if the candidate was already in (add) or not in (remove) the election.
+    // logged runs after a change, before votes can see it, so it can log the change
+    // in the order votes and edits were applied.
+    bool addCandidate(int candidateId, const function<void()> &logged = nullptr)
     {
-        candidateIds.push_back(candidateId);
+        unique_lock<shared_mutex> guard(candidatesLock);
+        auto it = lower_bound(candidateIds.begin(), candidateIds.end(), candidateId);
+        if (it != candidateIds.end() && *it == candidateId)
+            return false;
+        tallies.emplace(tallies.begin() + (it - candidateIds.begin()), new CandidateTally(++talliesCreated));
+        candidateIds.insert(it, candidateId);
+        if (logged)
+            logged();
+        return true;
     }
 
-    void removeCandidate(int candidateId)
+    bool removeCandidate(int candidateId, const function<void()> &logged = nullptr)
     {
-        for (auto i = candidateIds.begin(); i != candidateIds.end(); ++i)
-        {
-            if (*i == candidateId)
-            {
-                candidateIds.erase(i);
-                return;
-            }
-        }
+        unique_lock<shared_mutex> guard(candidatesLock);
+        int slot = findCandidateLocked(candidateId);
+        if (slot < 0)
+            return false;
+        candidateIds.erase(candidateIds.begin() + slot);
+        tallies.erase(tallies.begin() + slot);
+        if (logged)
+            logged();
+        return true;
+    }
+
+    // position of the candidate in this election, -1 if not part of it
+    int findCandidate(int candidateId) const
+    {
+        shared_lock<shared_mutex> guard(candidatesLock);
+        return findCandidateLocked(candidateId);
     }
 
-    vector<int> &getCandidates()
+    // Checks the candidate, marks the voter and counts the vote as one step.
+    // requireOpen is off only when loading votes that were already accepted.
+    VoteStatus recordVote(int voterId, int candidateId, bool requireOpen = true);
+    // Ranked ballot, most preferred first. Its first choice counts in the tallies like
+    // a single-choice vote; the whole ranking is kept for runInstantRunoff.
+    VoteStatus recordRankedVote(int voterId, const vector<int> &ranking, bool requireOpen = true);
+
+    // recordVote split around the log write, for votes acknowledged only once durable.
+    // reserveVote checks the ballot (ranking null for a single choice) and marks the
+    // voter, then calls logged() while candidate edits still wait. Nothing is counted
+    // until publishVote; withdrawVote frees the voter if the record never got to disk.
+    VoteStatus reserveVote(int voterId, int candidateId, const vector<int> *ranking,
+                           const function<void()> &logged, uint64_t &tallyId);
+    // A first choice removed since the reservation counts nowhere, as on replay.
+    void publishVote(int voterId, int candidateId, const vector<int> *ranking, uint64_t tallyId);
+    void withdrawVote(int voterId);
+    // After close(): waits until every vote reserved while open is published or withdrawn.
+    void waitSettled();
+    // reserveVote for n ballots at once: one candidate lock and one lock per voter shard.
+    // Writes each outcome to status and each accepted ballot's tally to tallyIds, then
+    // calls logged() under the candidate lock. publishBatch adds one count per candidate.
+    void reserveBatch(const int *voterIds, const int *candidateIds, size_t n, VoteStatus *status,
+                      const function<void()> &logged, uint64_t *tallyIds);
+    void publishBatch(const int *candidateIds, size_t n, const VoteStatus *status, const uint64_t *tallyIds);
+    void withdrawBatch(const int *voterIds, size_t n, const VoteStatus *status);
+
+    long long getVoteCount(int candidateId) const
     {
+        shared_lock<shared_mutex> guard(candidatesLock);
+        int slot = findCandidateLocked(candidateId);
+        return slot < 0 ? 0 : tallies[slot]->total();
+    }
+    long long getTotalVotes() const;
+    // fn(candidateId, votes) per candidate in ascending id order, one consistent candidate list
+    template <typename Fn>
+    void forEachTally(Fn fn) const
+    {
+        shared_lock<shared_mutex> guard(candidatesLock);
+        for (size_t i = 0; i < candidateIds.size(); i++)
+            fn(candidateIds[i], tallies[i]->total());
+    }
+
+    vector<CandidateResult> getResults() const; // leaderboard, most votes first
+    // Single-choice votes take part as rankings of one candidate. Candidates removed
+    // from the election count as eliminated from the start.
+    RunoffResult runInstantRunoff() const;
+    // Same ballots counted head to head: a candidate beats everyone ranked below
+    // it or left off the ballot. Trie nodes are split across the pool.
+    PairwiseMatrix countPairwise(ThreadPool &pool) const;
+    long long getRankedBallots() const
+    {
+        lock_guard<mutex> guard(rankingLock);
+        return rankings.ballots();
+    }
+
+    vector<int> copyCandidates() const // ascending ids, safe while candidates are being edited
+    {
+        shared_lock<shared_mutex> guard(candidatesLock);
         return candidateIds;
     }
-    string getTitle() const { return title; }
-    string getDescription() const { return description; }
+    string getTitle() const
+    {
+        shared_lock<shared_mutex> guard(candidatesLock);
+        return title;
+    }
+    string getDescription() const
+    {
+        shared_lock<shared_mutex> guard(candidatesLock);
+        return description;
+    }
 
     void setTitle(const string &newTitle)
     { // for updating election
+        unique_lock<shared_mutex> guard(candidatesLock);
         title = newTitle;
     }
 
     void setDescription(const string &newDescription)
     { // for updating election
+        unique_lock<shared_mutex> guard(candidatesLock);
         description = newDescription;
     }
+
+    bool hasVoted(int voterId) const
+    {
+        VoterShard &shard = shardFor(voterId);
+        lock_guard<mutex> guard(shard.lock);
+        return shard.voted.contains(shardKey(voterId));
+    }
+    size_t getVoterCount() const;
+    size_t getVotedMemoryBytes() const;
+
+    /* snapshot support: read and restore state without going through voting */
+    template <typename Fn>
+    void forEachVoter(Fn fn) const
+    {
+        for (int s = 0; s < voterShardCount; s++)
+        {
+            lock_guard<mutex> guard(voterShards[s].lock);
+            voterShards[s].voted.forEach([&](int key)
+                                         { fn((int)((unsigned)key * voterShardCount + s)); });
+        }
+    }
+    void restoreStatus(ElectionStatus restored) { status = restored; }
+    void restoreVoter(int voterId)
+    {
+        VoterShard &shard = shardFor(voterId);
+        lock_guard<mutex> guard(shard.lock);
+        shard.voted.insert(shardKey(voterId));
+    }
+    void restoreTally(int candidateId, long long votes)
+    {
+        shared_lock<shared_mutex> guard(candidatesLock);
+        int slot = findCandidateLocked(candidateId);
+        if (slot >= 0)
+            tallies[slot]->add(0, votes);
+    }
+    template <typename Fn>
+    void forEachRanking(Fn fn) const
+    {
+        lock_guard<mutex> guard(rankingLock);
+        rankings.forEachRanking(fn);
+    }
+    void restoreRanking(const int *ranking, size_t length, long long ballots) // tallies come separately
+    {
+        lock_guard<mutex> guard(rankingLock);
+        rankings.add(ranking, length, ballots);
+    }
+};
+
+/* ---------- Credentials ---------- */
+// Salted PBKDF2-HMAC-SHA256. The log and snapshot keep it as text:
+// "pbkdf2-sha256$<iterations>$<salt hex>$<digest hex>".
+struct PasswordHash
+{
+    uint32_t cost = 0; // PBKDF2 iterations, 0 = not set yet
+    uint8_t salt[16] = {};
+    uint8_t digest[32] = {};
+
+    bool isSet() const { return cost != 0; }
+    static PasswordHash create(string_view password, uint32_t cost); // fresh random salt
+    bool matches(string_view password) const; // constant-time compare
+    string encode() const;
+    static bool decode(string_view text, PasswordHash &out);
+};
+
+// 128 random bits handed out at login; zero means no session.
+struct SessionToken
+{
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    bool empty() const { return (high | low) == 0; }
+    bool operator==(const SessionToken &other) const { return high == other.high && low == other.low; }
+    string toString() const; // 32 hex digits
+    static bool parse(string_view text, SessionToken &out);
 };
 
 /* ---------- User ---------- */
@@ -79,25 +634,33 @@ class User
 {
 protected:
     int userId;
+    UserRole role; // fixed by the subclass, so role checks need no virtual call
     string username;
     string email;
-    string password; // ✅ added
+    string password; // ✅ added; plain text only until the system stores the user
+    PasswordHash credential;
     bool isBanned;
     VotingSystem *system; // ✅ system reference
 
 public:
-    User(int id, string uname, string mail, string pass, VotingSystem *sys)
-        : userId(id), username(uname), email(mail),
-          password(pass), isBanned(false), system(sys) {}
+    User(int id, UserRole r, string uname, string mail, string pass, VotingSystem *sys)
+        : userId(id), role(r), username(move(uname)), email(move(mail)),
+          password(move(pass)), isBanned(false), system(sys) {}
 
     virtual ~User() {}
 
-    virtual string getRole() const = 0;
+    UserRole getRole() const { return role; }
 
     virtual void login();
     virtual void registerUser();
     virtual void logout();
 
+protected:
+    virtual void promptCredentials(); // fills in the fields registerUser saves
+    virtual bool addToSystem() const = 0; // the system keeps its own copy
+
+public:
+
     bool getBanStatus() const { return isBanned; }
     void ban() { isBanned = true; }
 
@@ -105,6 +668,13 @@ public:
 
     int getUserId() const { return userId; }
     string getPassword() const { return password; }
+    const PasswordHash &getCredential() const { return credential; }
+    void setCredential(const PasswordHash &hash)
+    {
+        credential = hash;
+        string().swap(password); // drop the plain text for good
+    }
+    bool checkPassword(string_view attempt) const { return credential.isSet() && credential.matches(attempt); }
 
     string getUsername() const { return username; }
     string getEmail() const { return email; }
@@ -141,14 +711,18 @@ class Voter : public User
 {
 public:
     Voter(int id, string uname, string mail, string pass, VotingSystem *sys)
-        : User(id, uname, mail, pass, sys) {}
+        : User(id, UserRole::VOTER, move(uname), move(mail), move(pass), sys) {}
 
-    string getRole() const override { return "Voter"; }
 
     void vote(int electionId, int candidateId);
+    void rankedVote(int electionId, const vector<int> &ranking); // most preferred first
     bool hasVoted(int electionId) const;
     void viewVotingStatus() {}
 
+protected:
+    bool addToSystem() const override;
+
+public:
     void login() override
     {
         cout << "Enter username: ";
@@ -170,16 +744,20 @@ private:
 public:
     Candidate(int id, string uname, string mail,
               string pass, string profile, VotingSystem *sys)
-        : User(id, uname, mail, pass, sys),
-          profileInfo(profile) {}
+        : User(id, UserRole::CANDIDATE, move(uname), move(mail), move(pass), sys),
+          profileInfo(move(profile)) {}
 
-    string getRole() const override { return "Candidate"; }
     // void login() override;
-    void registerUser() override;
     // void logout() override;
 
     void viewMyElections();
     void viewVoteCount(int electionId);
+
+    string getProfileInfo() const { return profileInfo; }
+
+protected:
+    void promptCredentials() override; // also asks for the profile
+    bool addToSystem() const override;
 };
 
 /* ---------- Admin ---------- */
@@ -187,9 +765,8 @@ class Admin : public User
 {
 public:
     Admin(int id, string uname, string mail, string pass, VotingSystem *sys)
-        : User(id, uname, mail, pass, sys) {}
+        : User(id, UserRole::ADMIN, move(uname), move(mail), move(pass), sys) {}
 
-    string getRole() const override { return "Admin"; }
 
     int createElection();
 
@@ -204,10 +781,17 @@ public:
 
     void viewVoters() {}
     void banVoter(int voterId) {}
-    void viewResults(int electionId) {}
+    void viewResults(int electionId);
+    void viewRunoff(int electionId); // instant-runoff rounds
+    void viewPairwise(int electionId); // head-to-head matrix, Copeland and Schulze
+    void auditElection(int electionId); // recount from the ballots and compare
+
+protected:
+    bool addToSystem() const override;
 };
 
 /* ---------- Vote ---------- */
+// For a ranked ballot candidateId is the first choice; the full ranking lives in the election.
 class Vote
 {
 private:
@@ -221,798 +805,10009 @@ public:
         : voteId(vId), electionId(eId),
           voterId(vrId), candidateId(cId) {}
 
+    int getVoteId() const { return voteId; }
     int getVoterId() const { return voterId; }
     int getElectionId() const { return electionId; }
+    int getCandidateId() const { return candidateId; }
 };
 
-/* ---------- VotingSystem ---------- */
-class VotingSystem
+/* ---------- Ballot ---------- */
+// A vote that has not been accepted yet (no id), as fed to ingestVotes.
+struct Ballot
 {
-private:
-    vector<User *> users;
-    vector<Election> elections;
-    vector<Vote> votes;
-
-public:
-    vector<Election> &getElections() { return elections; }
-    vector<User *> &getUsers() { return users; }
-    vector<Vote> &getVotes() { return votes; }
-
-    void fillDate()
-    {
-        /* ----------- Elections ----------- */
-        elections.push_back(
-            Election(1, "Student Union Election", "Choose the student union president"));
+    int electionId;
+    int voterId;
+    int candidateId;
+};
 
-        elections.push_back(
-            Election(2, "Club Leader Election", "Choose the club leader"));
+struct IngestReport
+{
+    long long accepted = 0;
+    long long alreadyVoted = 0;
+    long long rejected = 0; // any other VoteStatus
+};
 
-        /* ----------- Candidates ----------- */
-        users.push_back(new Candidate(101, "cand1", "c1@mail.com", "123", "Profile 1", this));
-        users.push_back(new Candidate(102, "cand2", "c2@mail.com", "123", "Profile 2", this));
-        users.push_back(new Candidate(103, "cand3", "c3@mail.com", "123", "Profile 3", this));
-        users.push_back(new Candidate(104, "cand4", "c4@mail.com", "123", "Profile 4", this));
-        users.push_back(new Candidate(105, "cand5", "c5@mail.com", "123", "Profile 5", this));
+struct ImportRejection
+{
+    size_t row; // index into the imported ballots
+    VoteStatus status;
+};
 
-        // Election 1 → 2 candidates
-        elections[0].addCandidate(101);
-        elections[0].addCandidate(102);
+struct ImportReport
+{
+    long long accepted = 0;
+    vector<ImportRejection> rejections; // in row order
+    bool durable = true;                // false if the vote log could not be written
+    double seconds = 0;
+};
 
-        // Election 2 → 3 candidates
-        elections[1].addCandidate(103);
-        elections[1].addCandidate(104);
-        elections[1].addCandidate(105);
+/* ---------- Ballot files ---------- */
+// CSV: "electionId,voterId,candidateId" per line, optional header line.
+// Binary: the 8-byte magic below, then 3 little-endian int32 per ballot.
+static const char ballotFileMagic[8] = {'V', 'S', 'B', 'A', 'L', 'L', 'O', 'T'};
 
-        /* ----------- Voters (10) ----------- */
-        users.push_back(new Voter(1, "voter1", "v1@mail.com", "123", this));
-        users.push_back(new Voter(2, "voter2", "v2@mail.com", "123", this));
-        users.push_back(new Voter(3, "voter3", "v3@mail.com", "123", this));
-        users.push_back(new Voter(4, "voter4", "v4@mail.com", "123", this));
-        users.push_back(new Voter(5, "voter5", "v5@mail.com", "123", this));
-        users.push_back(new Voter(6, "voter6", "v6@mail.com", "123", this));
-        users.push_back(new Voter(7, "voter7", "v7@mail.com", "123", this));
-        users.push_back(new Voter(8, "voter8", "v8@mail.com", "123", this));
-        users.push_back(new Voter(9, "voter9", "v9@mail.com", "123", this));
-        users.push_back(new Voter(10, "voter10", "v10@mail.com", "123", this));
+struct BallotFile
+{
+    vector<Ballot> ballots;
+    vector<size_t> sources;   // line (CSV) or record number (binary) of each ballot, 1-based
+    vector<size_t> malformed; // lines/records that could not be parsed
+};
 
-        /* ----------- Admins (10) ----------- */
-        users.push_back(new Admin(1001, "admin1", "admin1@mail.com", "123", this));
-        users.push_back(new Admin(1002, "admin2", "admin2@mail.com", "123", this));
-        users.push_back(new Admin(1003, "admin3", "admin3@mail.com", "123", this));
-        users.push_back(new Admin(1004, "admin4", "admin4@mail.com", "123", this));
-        users.push_back(new Admin(1005, "admin5", "admin5@mail.com", "123", this));
-        users.push_back(new Admin(1006, "admin6", "admin6@mail.com", "123", this));
-        users.push_back(new Admin(1007, "admin7", "admin7@mail.com", "123", this));
-        users.push_back(new Admin(1008, "admin8", "admin8@mail.com", "123", this));
-        users.push_back(new Admin(1009, "admin9", "admin9@mail.com", "123", this));
-        users.push_back(new Admin(1010, "admin10", "admin10@mail.com", "123", this));
+// Streams the file through mapped windows, handing each window's ballots to
+// onBatch(ballots, sources, n); memory stays bounded by the window size.
+// Small windows keep each batch in cache: 4 MB beat 64 MB by ~1.5x here.
+bool streamBallotFile(const string &path,
+                      const function<void(const Ballot *, const size_t *, size_t)> &onBatch,
+                      vector<size_t> &malformed, size_t windowBytes = 4 << 20);
+bool readBallotFile(const string &path, BallotFile &out); // whole file into memory
+bool writeBallotFile(const string &path, const vector<Ballot> &ballots, bool binary);
+
+/* ---------- Roster files ---------- */
+// CSV: "role,userId,username,email,password[,profile]" per line, role being
+// Voter, Candidate or Admin; optional header line. Fields can't contain commas.
+struct RosterRow
+{
+    size_t line;
+    UserRole role;
+    int userId;
+    string_view username; // point into the mapped file, valid during the callback
+    string_view email;
+    string_view password;
+    string_view profile;
+};
 
-        /* ----------- Votes (5) ----------- */
-        votes.push_back(Vote(1, 1, 1, 101)); // voter1 → election1 → candidate101
-        votes.push_back(Vote(2, 1, 2, 102));
-        votes.push_back(Vote(3, 2, 3, 103));
-        votes.push_back(Vote(4, 2, 4, 104));
-        votes.push_back(Vote(5, 2, 5, 105));
-    }
-    void run() {}
+bool streamRosterFile(const string &path, const function<void(const RosterRow &)> &onRow,
+                      vector<size_t> &malformed, size_t windowBytes = 4 << 20);
 
-    void guestMenu() {}
-    void voterMenu(Voter *voter) {}
-    void adminMenu(Admin *admin) {}
+struct RosterReport
+{
+    bool readable = true;
+    long long added = 0;
+    vector<size_t> duplicates; // lines whose id, username or email was taken
+    vector<size_t> malformed;
+    bool durable = true;
+    double seconds = 0;
 };
 
-//////////////////////////////
+/* ---------- VoteColumns ---------- */
+// Votes stored column by column (4 bytes per field, no per-vote index), so a
+// scan only streams the fields it needs. Rows stay in vote id order, which
+// makes lookup by id a binary search.
+class VoteColumns
+{
+private:
+    vector<int> voteIds;
+    vector<int> electionIds;
+    vector<int> voterIds;
+    vector<int> candidateIds;
 
-/* ---------- Test Cases ---------- */
-void TestCandidate(VotingSystem &system);
+public:
+    size_t size() const { return voteIds.size(); }
 
-/* ---------- User method implementation ---------- */
-void User::viewElections()
-{
-    for (const Election &e : system->getElections())
+    void reserve(size_t rows)
     {
-        cout << "Id: " << e.getElectionId() << endl;
-        cout << "Status: " << e.isOpen() << endl;
+        if (rows <= voteIds.capacity())
+            return;
+        rows = max(rows, voteIds.capacity() * 2); // keep repeated batches amortized
+        voteIds.reserve(rows);
+        electionIds.reserve(rows);
+        voterIds.reserve(rows);
+        candidateIds.reserve(rows);
     }
-}
 
-void User::login()
-{
-    bool validInput = false;
-    string inputUsername, inputPassword;
-    do
+    void append(int voteId, int electionId, int voterId, int candidateId)
     {
-        cout << "Enter username: ";
-        cin >> inputUsername;
-
-        cout << "Enter password: ";
-        cin >> inputPassword;
+        voteIds.push_back(voteId);
+        electionIds.push_back(electionId);
+        voterIds.push_back(voterId);
+        candidateIds.push_back(candidateId);
 
-        for (User *user : system->getUsers())
-        {
-            if (user->getUsername() == inputUsername &&
-                user->getPassword() == inputPassword)
-            {
-                username = inputUsername;
-                password = inputPassword;
-                cout << "Login successful!" << endl;
-                validInput = true;
-                break;
-            }
-        }
-        if (!validInput)
+        // concurrent voters can arrive slightly out of id order: slide the row into place
+        for (size_t i = voteIds.size() - 1; i > 0 && voteIds[i - 1] > voteIds[i]; i--)
         {
-            cout << "Invalid username or password. Please try again." << endl;
+            swap(voteIds[i], voteIds[i - 1]);
+            swap(electionIds[i], electionIds[i - 1]);
+            swap(voterIds[i], voterIds[i - 1]);
+            swap(candidateIds[i], candidateIds[i - 1]);
         }
+    }
 
-    } while (!validInput);
+    // row holding voteId, -1 if there is none
+    long find(int voteId) const
+    {
+        auto it = lower_bound(voteIds.begin(), voteIds.end(), voteId);
+        return (it == voteIds.end() || *it != voteId) ? -1 : (long)(it - voteIds.begin());
+    }
 
-    // Navigation to menu will be added later
-}
+    Vote row(size_t i) const
+    {
+        return Vote(voteIds[i], electionIds[i], voterIds[i], candidateIds[i]);
+    }
 
-void User::registerUser()
-{
-    bool exists = false;
-    string inputUsername, inputEmail, inputPassword;
+    const vector<int> &getVoteIds() const { return voteIds; }
+    const vector<int> &getElectionIds() const { return electionIds; }
+    const vector<int> &getVoterIds() const { return voterIds; }
+    const vector<int> &getCandidateIds() const { return candidateIds; }
 
-    do
+    size_t memoryBytes() const
     {
-        exists = false;
-        cout << "Enter username: ";
-        cin >> inputUsername;
+        return (voteIds.capacity() + electionIds.capacity() +
+                voterIds.capacity() + candidateIds.capacity()) * sizeof(int);
+    }
+};
 
-        if (inputUsername.empty())
+/* ---------- PackedBallots ---------- */
+// One election's ballots compressed for archiving and audit: voter ids sorted
+// and stored as varint gaps, candidates as varint slots into a small table.
+// Most ballots take 2-3 bytes instead of 16.
+class PackedBallots
+{
+private:
+    vector<int> slotCandidates; // slot -> candidate id
+    string voterGaps;
+    string candidateSlots;
+    size_t count = 0;
+
+    static void putVarint(string &out, uint32_t value)
+    {
+        while (value >= 0x80)
         {
-            cout << "Username cannot be empty." << endl;
+            out += (char)((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += (char)value;
+    }
+
+    static uint32_t getVarint(const string &in, size_t &pos)
+    {
+        uint32_t value = 0;
+        for (int shift = 0; pos < in.size(); shift += 7)
+        {
+            uint8_t b = (uint8_t)in[pos++];
+            value |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                break;
+        }
+        return value;
+    }
+
+public:
+    // ballots are (voterId, candidateId) pairs in any order
+    void pack(vector<pair<int, int>> ballots)
+    {
+        sort(ballots.begin(), ballots.end(),
+             [](const pair<int, int> &a, const pair<int, int> &b)
+             { return (uint32_t)a.first < (uint32_t)b.first; });
+
+        unordered_map<int, uint32_t> slotOf;
+        slotCandidates.clear();
+        voterGaps.clear();
+        candidateSlots.clear();
+        count = ballots.size();
+
+        uint32_t previous = 0;
+        for (const auto &b : ballots)
+        {
+            putVarint(voterGaps, (uint32_t)b.first - previous);
+            previous = (uint32_t)b.first;
+
+            auto slot = slotOf.find(b.second);
+            if (slot == slotOf.end())
+            {
+                slot = slotOf.emplace(b.second, (uint32_t)slotCandidates.size()).first;
+                slotCandidates.push_back(b.second);
+            }
+            putVarint(candidateSlots, slot->second);
+        }
+    }
+
+    // fn(voterId, candidateId), voters in ascending order
+    template <typename Fn>
+    void forEach(Fn fn) const
+    {
+        size_t voterPos = 0, slotPos = 0;
+        uint32_t voter = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            voter += getVarint(voterGaps, voterPos);
+            fn((int)voter, slotCandidates[getVarint(candidateSlots, slotPos)]);
+        }
+    }
+
+    size_t size() const { return count; }
+    size_t memoryBytes() const
+    {
+        return voterGaps.capacity() + candidateSlots.capacity() +
+               slotCandidates.capacity() * sizeof(int);
+    }
+};
+
+/* ---------- UserPool ---------- */
+// Owns the users of one role, constructed in place in fixed-size chunks: one
+// allocation per chunk instead of one per user, and addresses never move.
+template <class T>
+class UserPool
+{
+private:
+    static constexpr size_t chunkSize = 1024;
+    struct Chunk
+    {
+        alignas(T) unsigned char bytes[chunkSize * sizeof(T)];
+    };
+    vector<unique_ptr<Chunk>> chunks;
+    size_t count = 0;
+
+    T *slot(size_t i) const { return reinterpret_cast<T *>(chunks[i / chunkSize]->bytes) + i % chunkSize; }
+
+public:
+    UserPool() {}
+    UserPool(const UserPool &) = delete;
+    UserPool &operator=(const UserPool &) = delete;
+    ~UserPool()
+    {
+        while (count > 0)
+            popBack();
+    }
+
+    template <class... Args>
+    T *emplace(Args &&...args)
+    {
+        if (count == chunks.size() * chunkSize)
+            chunks.emplace_back(new Chunk);
+        T *user = new (slot(count)) T(std::forward<Args>(args)...);
+        count++;
+        return user;
+    }
+    void popBack() { slot(--count)->~T(); }
+
+    size_t size() const { return count; }
+    T &operator[](size_t i) const { return *slot(i); }
+    size_t memoryBytes() const { return chunks.size() * sizeof(Chunk); }
+
+    template <class Fn>
+    void forEach(Fn fn) const
+    {
+        for (size_t c = 0; c * chunkSize < count; c++)
+        {
+            T *first = reinterpret_cast<T *>(chunks[c]->bytes);
+            size_t n = min(chunkSize, count - c * chunkSize);
+            for (size_t i = 0; i < n; i++)
+                fn(first[i]);
+        }
+    }
+};
+
+/* ---------- ThreadPool ---------- */
+// Fixed set of worker threads that split a batch of numbered tasks between them.
+class ThreadPool
+{
+private:
+    vector<thread> workers;
+    mutex callLock; // one parallelFor at a time
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+    const function<void(size_t, int)> *job = nullptr;
+    size_t taskCount = 0;
+    atomic<size_t> nextTask{0};
+    int busy = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void workerLoop(int worker);
+
+public:
+    explicit ThreadPool(int threadCount = 0); // 0 = one per hardware thread
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    int size() const { return (int)workers.size(); }
+
+    // Runs fn(task, worker) for every task in [0, tasks) and waits for all of them.
+    // worker is in [0, size()), handy for indexing per-thread scratch space.
+    void parallelFor(size_t tasks, const function<void(size_t, int)> &fn);
+};
+
+/* ---------- Metrics ---------- */
+// Per-operation call counts and latency histograms. Every thread records into its
+// own block; readers merge the blocks of all threads, live and exited.
+enum class Metric
+{
+    VOTE,
+    LOGIN,
+    OPEN_ELECTION,
+    CLOSE_ELECTION,
+    RESULTS,
+    VOTE_COUNT,
+    COUNT // number of metrics, not a metric
+};
+
+const char *metricName(Metric metric);
+
+// HDR-style log-linear buckets over nanoseconds: exact below 16 ns, then 16 buckets
+// per power of two, so a reported value is within 1/16 of the real one. Anything
+// from 2^40 ns (about 18 minutes) up shares the last bucket.
+struct LatencyHistogram
+{
+    static constexpr int subBuckets = 16;
+    static constexpr int bucketCount = (40 - 3) * subBuckets;
+
+    uint64_t buckets[bucketCount] = {};
+    uint64_t count = 0;
+    uint64_t failed = 0; // calls that ended in an error status
+    uint64_t totalNanos = 0;
+    uint64_t maxNanos = 0;
+
+    static int bucketOf(uint64_t nanos);
+    static uint64_t bucketValue(int bucket); // middle of the bucket's range
+    void merge(const LatencyHistogram &other);
+    uint64_t percentile(double fraction) const; // nanoseconds, 0 when empty
+};
+
+void recordMetric(Metric metric, uint64_t nanos, bool ok);
+vector<LatencyHistogram> collectMetrics(); // indexed by Metric
+void resetMetrics(); // for quiet moments; a call recorded at the same time may survive it
+void writeMetrics(ostream &out); // one line per metric that has calls
+bool exportMetrics(const string &path); // JSON lines
+
+// Times a scope and records it on exit; it counts as failed unless succeeded(true) was called.
+// Use it through the macros so that a VS_METRICS=0 build carries no trace of it.
+#if VS_METRICS
+class MetricTimer
+{
+private:
+    Metric metric;
+    bool ok = false;
+    chrono::steady_clock::time_point start;
+
+public:
+    explicit MetricTimer(Metric m) : metric(m), start(chrono::steady_clock::now()) {}
+    MetricTimer(const MetricTimer &) = delete;
+    MetricTimer &operator=(const MetricTimer &) = delete;
+    ~MetricTimer()
+    {
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start);
+        recordMetric(metric, (uint64_t)elapsed.count(), ok);
+    }
+
+    void succeeded(bool success) { ok = success; }
+};
+#define VS_METRIC_TIMER(timer, metric) MetricTimer timer(metric)
+#define VS_METRIC_OK(timer, success) timer.succeeded(success)
+#else
+#define VS_METRIC_TIMER(timer, metric) ((void)0)
+#define VS_METRIC_OK(timer, success) ((void)0)
+#endif
+
+/* ---------- ElectionResults ---------- */
+struct ElectionResults
+{
+    int electionId;
+    long long totalVotes;
+    vector<CandidateResult> results; // most votes first
+};
+
+/* ---------- Recount kernels ---------- */
+// Audit recount straight from the vote columns, independent of the tallies.
+// Each kernel adds to counts[k] the ballots with the given electionId and
+// candidateIds[k]; the SIMD ones compare 4 or 8 ballots per instruction.
+enum class RecountKernel
+{
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+RecountKernel bestRecountKernel(); // picked once from what the CPU supports
+const char *recountKernelName(RecountKernel kernel);
+void recountColumns(RecountKernel kernel, const int *electionIds, const int *candidateIds,
+                    size_t count, int electionId, const vector<int> &candidates,
+                    long long *counts);
+
+/* ---------- WriteAheadLog ---------- */
+enum class LogRecordType : uint8_t
+{
+    LOG_HEADER = 0, // first record of a log file: its generation
+    USER_ADD = 1,
+    ELECTION_CREATE,
+    ELECTION_UPDATE,
+    ELECTION_OPEN,
+    ELECTION_CLOSE,
+    CANDIDATE_ADD,
+    CANDIDATE_REMOVE,
+    VOTE,
+    RANKED_VOTE // a VOTE's fields, then the ranking: count and candidate ids
+};
+
+// One log entry: a type byte plus fields packed little-endian.
+struct LogRecord
+{
+    LogRecordType type;
+    string payload;
+    size_t readPos = 0;
+
+    explicit LogRecord(LogRecordType t = LogRecordType::VOTE) : type(t) {}
+
+    void putInt(int32_t value)
+    {
+        uint32_t u = (uint32_t)value;
+        for (int i = 0; i < 4; i++)
+            payload += (char)((u >> (8 * i)) & 0xFF);
+    }
+    void putString(const string &value)
+    {
+        putInt((int32_t)value.size());
+        payload += value;
+    }
+
+    bool getInt(int &value)
+    {
+        if (readPos + 4 > payload.size())
+            return false;
+        uint32_t u = 0;
+        for (int i = 0; i < 4; i++)
+            u |= (uint32_t)(uint8_t)payload[readPos + i] << (8 * i);
+        readPos += 4;
+        value = (int32_t)u;
+        return true;
+    }
+    bool getString(string &value)
+    {
+        int len;
+        if (!getInt(len) || len < 0 || readPos + len > payload.size())
+            return false;
+        value = payload.substr(readPos, len);
+        readPos += len;
+        return true;
+    }
+};
+
+// Append-only log of every state change, replayed on startup.
+// On disk each record is [uint32 size][uint32 crc32][type byte + payload].
+// Group commit: writers buffer records, and whoever waits for durability first
+// writes and fsyncs everything buffered so far, so concurrent voters share one fsync.
+class WriteAheadLog
+{
+private:
+    FILE *file = nullptr;
+    mutex lock;
+    condition_variable flushed;
+    string pending;          // encoded records not written yet
+    uint64_t appendedLsn = 0; // sequence number of the last buffered record
+    uint64_t durableLsn = 0;  // everything up to here is fsynced
+    bool flushing = false;
+    bool failed = false;
+    uint64_t fsyncCount = 0;
+
+public:
+    ~WriteAheadLog() { close(); }
+
+    // Feeds every intact record to apply, then cuts off a torn or corrupt tail.
+    // Returns the number of records replayed (0 if the file does not exist).
+    static long long replay(const string &path, const function<void(LogRecord &)> &apply);
+
+    // Appends to path; a new or empty file starts with a LOG_HEADER for generation.
+    bool open(const string &path, int generation);
+    // Starts path over as an empty log of the given generation (after a snapshot).
+    bool reset(const string &path, int generation);
+    void close();
+
+    uint64_t append(const LogRecord &record); // returns the record's sequence number
+    bool waitDurable(uint64_t lsn);           // false if the log could not be written
+
+    uint64_t getRecordCount()
+    {
+        lock_guard<mutex> guard(lock);
+        return appendedLsn;
+    }
+    uint64_t getFsyncCount()
+    {
+        lock_guard<mutex> guard(lock);
+        return fsyncCount;
+    }
+};
+
+/* ---------- MappedFile ---------- */
+// Read-only view of a whole file: mmap where available, plain read otherwise.
+class MappedFile
+{
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    string buffer;
+#endif
+
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string &path);
+    void close();
+
+    const char *begin() const { return data; }
+    size_t length() const { return size; }
+};
+
+/* ---------- MappedStream ---------- */
+// Read-only view of a file through one mapped window at a time, so files
+// bigger than memory can be parsed in place from front to back.
+class MappedStream
+{
+private:
+    uint64_t fileSize = 0;
+    size_t windowBytes;
+    const char *window = nullptr; // current mapping
+    size_t windowLength = 0;
+#ifdef _WIN32
+    FILE *file = nullptr;
+    string buffer;
+#else
+    int fd = -1;
+#endif
+
+    void unmap();
+
+public:
+    explicit MappedStream(size_t window = 64 << 20) : windowBytes(max<size_t>(window, 4096)) {}
+    MappedStream(const MappedStream &) = delete;
+    MappedStream &operator=(const MappedStream &) = delete;
+    ~MappedStream() { close(); }
+
+    bool open(const string &path);
+    void close();
+    uint64_t size() const { return fileSize; }
+
+    // Maps up to the window size starting at offset; drops the previous window.
+    bool view(uint64_t offset, const char *&data, size_t &length);
+};
+
+/* ---------- Snapshot format ---------- */
+// Fixed-width little-endian tables so a mapped snapshot is read in place.
+// Every section starts on an 8-byte boundary; strings live in one blob.
+struct SnapshotString
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SnapshotHeader
+{
+    char magic[8]; // "VSSNAP02"; "VSSNAP01" files end before the ranking tables
+    int32_t logGeneration; // log generation fully contained in this snapshot
+    int32_t nextVoteId;
+    uint64_t userCount, userOffset;
+    uint64_t electionCount, electionOffset;
+    uint64_t candidateCount, candidateOffset;
+    uint64_t voterCount, voterOffset;
+    uint64_t voteCount, voteOffset;
+    uint64_t stringBytes, stringOffset;
+    uint64_t rankingCount, rankingOffset;
+    uint64_t preferenceCount, preferenceOffset; // int32 candidate ids the ranking rows point into
+};
+
+struct SnapshotUser
+{
+    int32_t userId;
+    int32_t role; // 0 voter, 1 candidate, 2 admin
+    SnapshotString username, email, credential, profile; // credential: PasswordHash::encode
+};
+
+struct SnapshotElection
+{
+    int32_t electionId;
+    int32_t status;
+    SnapshotString title, description;
+    uint64_t firstCandidate, candidateCount; // rows in the candidate table
+    uint64_t firstVoter, voterCount;         // rows in the voter table
+};
+
+struct SnapshotCandidate
+{
+    int32_t candidateId;
+    int32_t unused;
+    int64_t votes;
+};
+
+struct SnapshotVote
+{
+    int32_t voteId, electionId, voterId, candidateId;
+};
+
+// one distinct ranking of an election and how many ballots carry it
+struct SnapshotRanking
+{
+    int32_t electionId;
+    uint32_t length;
+    uint64_t firstPreference; // row in the preference table
+    int64_t ballots;
+};
+
+struct StartupStats
+{
+    long long snapshotUsers = 0;
+    long long snapshotVotes = 0;
+    double snapshotMs = 0;
+    long long replayedRecords = 0;
+    double replayMs = 0;
+};
+
+/* ---------- SessionTable ---------- */
+// token -> user, sharded so logins and vote checks on different tokens
+// rarely share a lock. Expired sessions are swept while issuing new ones.
+class SessionTable
+{
+private:
+    struct Session
+    {
+        User *user;
+        chrono::steady_clock::time_point expires;
+    };
+    struct TokenHash
+    {
+        size_t operator()(const SessionToken &token) const { return (size_t)token.low; } // already random
+    };
+    struct alignas(64) Shard
+    {
+        mutable shared_mutex lock;
+        unordered_map<SessionToken, Session, TokenHash> sessions;
+        uint64_t issued = 0;
+    };
+
+    static constexpr int shardCount = 16; // power of two
+    static constexpr uint64_t sweepEvery = 1024; // issues per shard between expiry sweeps
+    Shard shards[shardCount];
+    atomic<long long> lifetimeMs{8 * 3600 * 1000};
+
+    Shard &shardFor(const SessionToken &token) { return shards[token.high & (shardCount - 1)]; }
+    const Shard &shardFor(const SessionToken &token) const { return shards[token.high & (shardCount - 1)]; }
+
+public:
+    void setLifetime(chrono::milliseconds lifetime) { lifetimeMs = lifetime.count(); }
+    SessionToken issue(User *user);
+    User *resolve(const SessionToken &token) const; // null if unknown or expired
+    bool revoke(const SessionToken &token);
+    size_t size() const;
+};
+
+/* ---------- TallyFeed ---------- */
+struct TallyDelta
+{
+    int electionId;
+    int candidateId;
+    long long delta; // votes since the previous batch
+    long long total;
+};
+
+// Published once and shared by every reader, so fan-out costs no copies.
+struct TallyBatch
+{
+    uint64_t sequence;
+    chrono::steady_clock::time_point publishedAt;
+    bool resync; // full totals for a reader that fell behind; delta == total
+    vector<TallyDelta> changes;
+    vector<int> closedElections; // their totals in this batch are final
+};
+
+// Polls the election tallies (never the vote log) every interval and publishes
+// what changed as one batch, so a burst of votes becomes one delta per candidate.
+// Readers keep only a cursor into the recent-batch ring.
+class TallyFeed
+{
+private:
+    struct Published
+    {
+        vector<int> candidates; // ascending
+        vector<long long> totals;
+        bool closed = false;
+    };
+
+    const VotingSystem &system;
+    const size_t history;
+
+    mutex tickLock; // one tick at a time; resync reads `published` under it
+    unordered_map<int, Published> published;
+
+    mutable mutex lock;
+    condition_variable newBatch;
+    deque<shared_ptr<const TallyBatch>> recent;
+    uint64_t lastSequence = 0;
+    bool stopping = false;
+
+    thread publisher;
+
+    shared_ptr<const TallyBatch> buildResync();
+
+public:
+    explicit TallyFeed(const VotingSystem &sys, size_t historyBatches = 256)
+        : system(sys), history(historyBatches) {}
+    ~TallyFeed() { stop(); }
+    TallyFeed(const TallyFeed &) = delete;
+    TallyFeed &operator=(const TallyFeed &) = delete;
+
+    void start(chrono::milliseconds interval); // background publishing
+    void stop();
+    // One tick: publishes a batch if any tally or status changed; returns its sequence or 0.
+    uint64_t publishNow();
+    // Batches after `cursor` (then advanced), waiting up to timeout for the first one.
+    vector<shared_ptr<const TallyBatch>> waitAfter(uint64_t &cursor, chrono::milliseconds timeout);
+};
+
+// One reader's position in the feed. Cheap, and not shared between threads.
+class TallySubscription
+{
+private:
+    TallyFeed *feed;
+    uint64_t cursor = 0; // 0: the first read brings the current totals
+    vector<int> electionIds; // sorted, empty = every election
+
+public:
+    TallySubscription(TallyFeed &f, vector<int> ids) : feed(&f), electionIds(move(ids))
+    {
+        sort(electionIds.begin(), electionIds.end());
+    }
+
+    vector<shared_ptr<const TallyBatch>> next(chrono::milliseconds timeout)
+    {
+        return feed->waitAfter(cursor, timeout);
+    }
+    bool covers(int electionId) const
+    {
+        return electionIds.empty() || binary_search(electionIds.begin(), electionIds.end(), electionId);
+    }
+};
+
+/* ---------- ElectionCatalog ---------- */
+// What guests browse, as immutable versions. An edit copies the path from the root
+// down to one election's entry and publishes the new root with a single pointer
+// swap, so a reader keeps one consistent version without taking a lock and an edit
+// never waits for readers. Replaced nodes are freed once no reader can still see them.
+struct CatalogEntry
+{
+    int electionId;
+    uint64_t sequence; // creation order
+    string title;
+    string description;
+    ElectionStatus status;
+    vector<int> candidates; // ascending
+};
+
+class ElectionCatalog
+{
+public:
+    static constexpr int bits = 5;
+    static constexpr int fanout = 1 << bits;
+    static constexpr int maxLevels = (32 + bits - 1) / bits;
+
+    struct Node
+    {
+        const Node *children[fanout] = {};        // every level but the last
+        const CatalogEntry *entries[fanout] = {}; // the last level
+    };
+
+    // One published version: a radix trie over the election id, `bits` of it per level.
+    struct Version
+    {
+        const Node *root = nullptr;
+        int levels = 1;
+        size_t size = 0;
+        uint64_t number = 0; // one more per published edit
+
+        const CatalogEntry *find(int electionId) const;
+        // fn(const CatalogEntry &) in ascending id order, negative ids last
+        template <typename Fn>
+        void forEach(Fn fn) const
+        {
+            forEachFrom(root, levels - 1, fn);
+        }
+
+    private:
+        template <typename Fn>
+        static void forEachFrom(const Node *node, int level, Fn &fn)
+        {
+            if (!node)
+                return;
+            for (int i = 0; i < fanout; i++)
+            {
+                if (level > 0)
+                    forEachFrom(node->children[i], level - 1, fn);
+                else if (node->entries[i])
+                    fn(*node->entries[i]);
+            }
+        }
+    };
+
+private:
+    // what one edit replaced, freed once every reader still inside a view started after it
+    struct Garbage
+    {
+        uint64_t epoch = 0;
+        const Version *version = nullptr;
+        vector<const Node *> nodes;
+        const CatalogEntry *entry = nullptr;
+    };
+
+    atomic<const Version *> current;
+    mutable mutex writeLock; // one edit at a time
+    deque<Garbage> retired; // oldest first
+    uint64_t nextSequence = 0;
+
+    const Node *copyPath(const Node *node, int level, uint32_t key, const CatalogEntry *entry, Garbage &garbage,
+                         const CatalogEntry *&replaced);
+    void publishLocked(const Version *old, const CatalogEntry *entry, bool added);
+    void retireLocked(Garbage garbage);
+    static void freeTree(const Node *node, int level);
+
+    friend class CatalogView;
+
+public:
+    ElectionCatalog() : current(new Version()) {}
+    ~ElectionCatalog(); // no view may outlive the catalog
+    ElectionCatalog(const ElectionCatalog &) = delete;
+    ElectionCatalog &operator=(const ElectionCatalog &) = delete;
+
+    // Publishes a new version with one election's entry added or replaced. fill(entry)
+    // starts from the old entry and runs under the edit lock, so reading the live
+    // election there leaves the newest state published last.
+    template <typename Fn>
+    void publish(int electionId, Fn fill)
+    {
+        lock_guard<mutex> guard(writeLock);
+        const Version *old = current.load();
+        const CatalogEntry *existing = old->find(electionId);
+        CatalogEntry *entry = existing ? new CatalogEntry(*existing)
+                                       : new CatalogEntry{electionId, nextSequence++, "", "", ElectionStatus::CREATED, {}};
+        fill(*entry);
+        publishLocked(old, entry, existing == nullptr);
+    }
+
+    size_t retiredCount() const; // edits not freed yet, for tests
+};
+
+// A reader's pinned version of the catalog. Cheap to take, and the version it shows
+// stays intact until the view goes away; meant for short reads on one thread.
+class CatalogView
+{
+private:
+    const ElectionCatalog::Version *version;
+
+public:
+    explicit CatalogView(const ElectionCatalog &catalog);
+    ~CatalogView();
+    CatalogView(const CatalogView &) = delete;
+    CatalogView &operator=(const CatalogView &) = delete;
+
+    const ElectionCatalog::Version &operator*() const { return *version; }
+    const ElectionCatalog::Version *operator->() const { return version; }
+};
+
+/* ---------- VotingSystem ---------- */
+class VotingSystem
+{
+private:
+    static const int voteShardCount = 16; // power of two
+    static constexpr uint32_t defaultHashCost = 10000; // PBKDF2 iterations for new passwords
+
+    // vote log shard, picked by vote id so consecutive votes spread over locks
+    struct alignas(64) VoteShard
+    {
+        mutable mutex lock;
+        VoteColumns columns;
+    };
+
+    // each role lives in its own pool; users is the registration-order view
+    UserPool<Voter> voterPool;
+    UserPool<Candidate> candidatePool;
+    UserPool<Admin> adminPool;
+    vector<User *> users;
+    deque<Election> elections; // deque so Election* in the index stay valid on growth
+    VoteShard voteShards[voteShardCount];
+    atomic<int> nextVoteId{1};
+
+    unique_ptr<WriteAheadLog> wal; // null until openLog, so replay doesn't log again
+    string logPath;
+    string snapshotPath;
+    int logGeneration = 0;
+
+    // Every mutation holds this shared; a snapshot holds it exclusively so it
+    // sees a consistent state and can swap the log underneath.
+    mutable shared_mutex checkpointLock;
+    atomic<uint64_t> snapshotEvery{0}; // log records between snapshots, 0 = off
+    atomic<uint64_t> recordsAtSnapshot{0};
+    thread snapshotter;
+    mutex snapshotterLock;
+    condition_variable snapshotterWake;
+    bool stopping = false;
+    StartupStats startupStats;
+
+    /* lookup indexes, only touched by the add* methods below */
+    mutable shared_mutex indexLock;
+    unordered_map<int, Election *> electionById;
+    unordered_map<int, User *> userById;
+    unordered_map<string, User *> userByUsername;
+    unordered_map<string, User *> userByEmail;
+    unordered_map<int, vector<int>> electionsByCandidate; // sorted election ids
+
+    SessionTable sessions;
+    atomic<uint32_t> hashCost{defaultHashCost};
+    ElectionCatalog catalog; // guest-facing copy, republished after every election edit
+    TallyFeed tallyFeed{*this}; // last member: its thread stops before anything it reads goes away
+
+    VoteShard &shardFor(int voteId) { return voteShards[(unsigned)voteId & (voteShardCount - 1)]; }
+    const VoteShard &shardFor(int voteId) const { return voteShards[(unsigned)voteId & (voteShardCount - 1)]; }
+
+    bool commitChange(const LogRecord &record); // true if logged durably (or no log attached)
+    uint64_t logChange(const LogRecord &record); // appends only; 0 without a log
+    bool awaitChange(uint64_t lsn);              // commitChange's second half
+    void applyLogRecord(LogRecord &record);
+    bool loadSnapshot(const string &path, int &generation);
+    template <class T>
+    T *storeUser(UserPool<T> &pool, const T &user, const string &profile,
+                 uint64_t *pendingLsn = nullptr, // set: caller holds the checkpoint and commits
+                 ChangeStatus *status = nullptr);
+    void restoreVote(const Vote &vote); // snapshot load: no checks, no logging
+    bool addAcceptedVote(const Vote &vote, const vector<int> *ranking); // addVote / addRankedVote
+    void linkCandidate(int electionId, int candidateId, bool linked); // reverse index
+    void publishElection(const Election &e); // refreshes its catalog entry
+
+public:
+    VotingSystem() {}
+    VotingSystem(const VotingSystem &) = delete;
+    VotingSystem &operator=(const VotingSystem &) = delete;
+    ~VotingSystem();
+
+    const deque<Election> &getElections() const { return elections; }
+    const vector<User *> &getUsers() const { return users; }
+    const UserPool<Voter> &getVoters() const { return voterPool; }
+    const UserPool<Candidate> &getCandidates() const { return candidatePool; }
+    const UserPool<Admin> &getAdmins() const { return adminPool; }
+    size_t getUserStoreBytes() const;
+    vector<Vote> getVotes() const; // snapshot ordered by vote id
+    size_t getVoteCount() const;
+    size_t getVoteStoreBytes() const;
+
+    // Calls fn(const VoteColumns &) once per shard while holding that shard's lock.
+    template <typename Fn>
+    void scanVotes(Fn fn) const
+    {
+        for (const VoteShard &shard : voteShards)
+        {
+            lock_guard<mutex> guard(shard.lock);
+            fn(shard.columns);
+        }
+    }
+    // Compressed copy of one election's ballots for archiving or audit.
+    PackedBallots packElection(int electionId) const;
+    // Full recount of one election from the vote columns (not the tallies).
+    vector<CandidateResult> recountElection(int electionId,
+                                            RecountKernel kernel = bestRecountKernel());
+    // Recounts every CLOSED election in one parallel pass over the vote log.
+    vector<ElectionResults> computeClosedResults(ThreadPool &pool);
+
+    Election *findElection(int electionId);
+    User *findUser(int userId) const;
+    User *findUserByUsername(const string &username) const;
+    User *findUserByEmail(const string &email) const;
+    // null unless the user exists and has that role
+    Voter *findVoter(int userId) const;
+    Candidate *findCandidate(int userId) const;
+    Admin *findAdmin(int userId) const;
+    // fn(electionId) for each election the candidate is in, ascending, read in place under
+    // the index lock: fn must not call back into the system's lookups or edits
+    template <typename Fn>
+    void forEachCandidateElection(int candidateId, Fn fn) const
+    {
+        shared_lock<shared_mutex> guard(indexLock);
+        auto it = electionsByCandidate.find(candidateId);
+        if (it == electionsByCandidate.end())
+            return;
+        for (int electionId : it->second)
+            fn(electionId);
+    }
+    bool findVote(int voteId, Vote &out) const;
+
+    ChangeStatus addElection(int electionId, const string &title, const string &description); // REJECTED: id taken
+    // copies the user into its role's pool; null if the id, username or email is
+    // taken or the log could not be written, which status tells apart
+    Voter *addUser(const Voter &voter, ChangeStatus *status = nullptr);
+    Candidate *addUser(const Candidate &candidate, ChangeStatus *status = nullptr);
+    Admin *addUser(const Admin &admin, ChangeStatus *status = nullptr);
+    // iterations for passwords hashed from now on; stored hashes keep their own
+    void setHashCost(uint32_t iterations) { hashCost = max(iterations, 1u); }
+    uint32_t getHashCost() const { return hashCost; }
+    SessionTable &getSessions() { return sessions; }
+    const SessionTable &getSessions() const { return sessions; }
+    // sizes the indexes up front before a bulk load of this many more users / elections
+    void reserveUsers(size_t additional);
+    void reserveElections(size_t additional);
+
+    // Lock-free read of every election's details, as of the last finished edit.
+    CatalogView viewCatalog() const { return CatalogView(catalog); }
+    size_t getCatalogRetired() const { return catalog.retiredCount(); }
+
+    // live results: start the feed, then hand each observer its own subscription
+    TallyFeed &getTallyFeed() { return tallyFeed; }
+    TallySubscription subscribeTallies(vector<int> electionIds = {}) { return TallySubscription(tallyFeed, move(electionIds)); }
+    // fn(const Election &) for every election; elections added meanwhile wait
+    template <typename Fn>
+    void forEachElection(Fn fn) const
+    {
+        shared_lock<shared_mutex> guard(indexLock);
+        for (const Election &e : elections)
+            fn(e);
+    }
+    bool addVote(const Vote &vote); // already-accepted vote with its own id (seed data, replay)
+    bool addRankedVote(const Vote &vote, const vector<int> &ranking); // same, ranking[0] is the vote's candidate
+
+    ChangeStatus openElection(int electionId);  // CREATED -> OPENED
+    ChangeStatus closeElection(int electionId); // OPENED -> CLOSED
+    ChangeStatus updateElection(int electionId, const string &title, const string &description);
+    ChangeStatus addCandidateToElection(int electionId, int candidateId);
+    ChangeStatus removeCandidateFromElection(int electionId, int candidateId);
+
+    // Loads the snapshot (if any), replays the log written after it, then appends
+    // every later change to the log. Returns false on a fresh start.
+    bool openLog(const string &path, const string &snapshotFile = "");
+    WriteAheadLog *getLog() { return wal.get(); }
+
+    // Writes a snapshot and starts a new, empty log generation.
+    bool writeSnapshot();
+    // Snapshot in the background once the log grew by this many records (0 = never).
+    void setSnapshotInterval(uint64_t records);
+    const StartupStats &getStartupStats() const { return startupStats; }
+
+    // Thread-safe entry point for a new ballot; assigns the vote id.
+    VoteStatus castVote(int electionId, int voterId, int candidateId);
+    // The same for a ranked ballot, most preferred candidate first.
+    VoteStatus castRankedVote(int electionId, int voterId, const vector<int> &ranking);
+    // Spreads ballots over threadCount workers by voter id and casts them all.
+    IngestReport ingestVotes(const vector<Ballot> &ballots, int threadCount);
+    // Bulk path for paper ballots: validates and logs the whole batch with one lock
+    // per election and voter shard, then counts it once its single log commit is durable.
+    ImportReport importBallots(const vector<Ballot> &ballots);
+    // Adds every user of a roster file, committing the log once per batch of rows.
+    RosterReport importRoster(const string &path);
+    bool syncLog();   // waits for every record appended so far; false if the log failed
+
+    void fillDate()
+    {
+        /* ----------- Elections ----------- */
+        addElection(1, "Student Union Election", "Choose the student union president");
+        addElection(2, "Club Leader Election", "Choose the club leader");
+
+        /* ----------- Candidates ----------- */
+        addUser(Candidate(101, "cand1", "c1@mail.com", "123", "Profile 1", this));
+        addUser(Candidate(102, "cand2", "c2@mail.com", "123", "Profile 2", this));
+        addUser(Candidate(103, "cand3", "c3@mail.com", "123", "Profile 3", this));
+        addUser(Candidate(104, "cand4", "c4@mail.com", "123", "Profile 4", this));
+        addUser(Candidate(105, "cand5", "c5@mail.com", "123", "Profile 5", this));
+
+        // Election 1 → 2 candidates
+        addCandidateToElection(1, 101);
+        addCandidateToElection(1, 102);
+
+        // Election 2 → 3 candidates
+        addCandidateToElection(2, 103);
+        addCandidateToElection(2, 104);
+        addCandidateToElection(2, 105);
+
+        /* ----------- Voters (10) ----------- */
+        addUser(Voter(1, "voter1", "v1@mail.com", "123", this));
+        addUser(Voter(2, "voter2", "v2@mail.com", "123", this));
+        addUser(Voter(3, "voter3", "v3@mail.com", "123", this));
+        addUser(Voter(4, "voter4", "v4@mail.com", "123", this));
+        addUser(Voter(5, "voter5", "v5@mail.com", "123", this));
+        addUser(Voter(6, "voter6", "v6@mail.com", "123", this));
+        addUser(Voter(7, "voter7", "v7@mail.com", "123", this));
+        addUser(Voter(8, "voter8", "v8@mail.com", "123", this));
+        addUser(Voter(9, "voter9", "v9@mail.com", "123", this));
+        addUser(Voter(10, "voter10", "v10@mail.com", "123", this));
+
+        /* ----------- Admins (10) ----------- */
+        addUser(Admin(1001, "admin1", "admin1@mail.com", "123", this));
+        addUser(Admin(1002, "admin2", "admin2@mail.com", "123", this));
+        addUser(Admin(1003, "admin3", "admin3@mail.com", "123", this));
+        addUser(Admin(1004, "admin4", "admin4@mail.com", "123", this));
+        addUser(Admin(1005, "admin5", "admin5@mail.com", "123", this));
+        addUser(Admin(1006, "admin6", "admin6@mail.com", "123", this));
+        addUser(Admin(1007, "admin7", "admin7@mail.com", "123", this));
+        addUser(Admin(1008, "admin8", "admin8@mail.com", "123", this));
+        addUser(Admin(1009, "admin9", "admin9@mail.com", "123", this));
+        addUser(Admin(1010, "admin10", "admin10@mail.com", "123", this));
+
+        /* ----------- Votes (5) ----------- */
+        addVote(Vote(1, 1, 1, 101)); // voter1 → election1 → candidate101
+        addVote(Vote(2, 1, 2, 102));
+        addVote(Vote(3, 2, 3, 103));
+        addVote(Vote(4, 2, 4, 104));
+        addVote(Vote(5, 2, 5, 105));
+        syncLog(); // the votes above were only appended
+    }
+    int nextUserId() const; // one past the highest id in use
+
+    // console front-end over VotingService and the user classes
+    void run();
+
+    void guestMenu();
+    void voterMenu(Voter *voter);
+    void candidateMenu(Candidate *candidate);
+    void adminMenu(Admin *admin);
+};
+
+/* ---------- VotingService ---------- */
+// Headless front door to VotingSystem: plain arguments in, status codes and
+// result structs out, no console I/O. The menus and the user classes'
+// interactive methods only prompt, call this and print the outcome.
+enum class ServiceStatus
+{
+    OK,
+    ELECTION_NOT_FOUND,
+    USER_NOT_FOUND,  // no user with that id and role
+    ALREADY_EXISTS,  // id, username or email taken; candidate already in the election
+    NOT_IN_ELECTION, // candidate is not part of the election
+    INVALID_STATE,   // election is not in the state the action needs
+    INVALID_INPUT,   // empty field or bad id
+    BAD_CREDENTIALS,
+    NOT_DURABLE      // applied in memory, but the log could not be written
+};
+
+const char *serviceStatusName(ServiceStatus status);
+const char *electionStatusName(ElectionStatus status);
+
+struct ElectionInfo
+{
+    int electionId;
+    string title;
+    string description;
+    ElectionStatus status;
+    size_t candidateCount;
+};
+
+struct CandidateInfo
+{
+    int candidateId;
+    string username;
+    string email;
+    string profile;
+};
+
+struct AuditMismatch
+{
+    int candidateId;
+    long long tally;
+    long long recount;
+};
+
+class VotingService
+{
+private:
+    VotingSystem &system;
+
+public:
+    explicit VotingService(VotingSystem &sys) : system(sys) {}
+
+    /* accounts */
+    ServiceStatus login(const string &username, const string &password, User *&user) const;
+    // login that also issues a token; later calls present the token instead of the password
+    ServiceStatus startSession(const string &username, const string &password, User *&user, SessionToken &token);
+    User *resolveSession(const SessionToken &token) const; // null if unknown or expired
+    void endSession(const SessionToken &token);
+    ServiceStatus registerUser(UserRole role, int userId, const string &username, const string &email,
+                               const string &password, const string &profile = "");
+
+    /* reading */
+    vector<ElectionInfo> listElections() const;
+    ServiceStatus getElection(int electionId, ElectionInfo &out) const;
+    ServiceStatus listCandidates(int electionId, vector<CandidateInfo> &out) const;
+    ServiceStatus getVoteCount(int electionId, int candidateId, long long &votes) const;
+    ServiceStatus getResults(int electionId, ElectionResults &out) const;
+    ServiceStatus getRunoff(int electionId, RunoffResult &out) const; // instant-runoff count
+    // Condorcet, Copeland and Schulze counts; only once the election is closed
+    ServiceStatus getPairwise(int electionId, ThreadPool &pool, PairwiseResult &out) const;
+    ServiceStatus auditElection(int electionId, vector<AuditMismatch> &mismatches) const;
+    // VotingSystem::forEachCandidateElection; fn may read the catalog (getElection) but nothing else
+    template <typename Fn>
+    void forEachCandidateElection(int candidateId, Fn fn) const
+    {
+        system.forEachCandidateElection(candidateId, fn);
+    }
+
+    /* voting */
+    VoteStatus castVote(int voterId, int electionId, int candidateId);
+    VoteStatus castVote(const SessionToken &session, int electionId, int candidateId); // voter sessions only
+    VoteStatus castRankedVote(int voterId, int electionId, const vector<int> &ranking); // most preferred first
+    VoteStatus castRankedVote(const SessionToken &session, int electionId, const vector<int> &ranking);
+
+    /* administration */
+    ServiceStatus createElection(int electionId, const string &title, const string &description);
+    ServiceStatus updateElection(int electionId, const string &title, const string &description); // empty keeps
+    ServiceStatus openElection(int electionId);
+    ServiceStatus closeElection(int electionId);
+    ServiceStatus addCandidate(int electionId, int candidateId);
+    ServiceStatus removeCandidate(int electionId, int candidateId);
+};
+
+/* ---------- ElectionScheduler ---------- */
+// Opens and closes elections at set wall-clock times. Transitions wait in a min-heap
+// and one thread sleeps until the earliest is due, so thousands of scheduled elections
+// cost nothing between deadlines. Closing also takes the final results. Schedules
+// live in memory only; the transitions themselves are logged like manual ones.
+class ElectionScheduler
+{
+public:
+    using Clock = chrono::system_clock;
+
+private:
+    struct Transition
+    {
+        Clock::time_point due;
+        int electionId;
+        bool close;          // false: open
+        uint64_t generation; // stale once the election is rescheduled or cancelled
+    };
+    static bool later(const Transition &a, const Transition &b) { return a.due > b.due; }
+
+    VotingSystem &system;
+    mutex runLock; // one runDue at a time, so an election's open never passes its close
+    mutable mutex lock;
+    condition_variable wake;
+    vector<Transition> heap;                  // earliest on top
+    unordered_map<int, uint64_t> generations; // elections whose close is still to come
+    unordered_map<int, ElectionResults> finals;
+    function<void(const ElectionResults &)> onClose;
+    uint64_t lastGeneration = 0;
+    uint64_t wakeups = 0;
+    bool stopping = false;
+
+    thread runner;
+
+    void pushLocked(const Transition &transition);
+
+public:
+    explicit ElectionScheduler(VotingSystem &sys) : system(sys) {}
+    ~ElectionScheduler() { stop(); }
+    ElectionScheduler(const ElectionScheduler &) = delete;
+    ElectionScheduler &operator=(const ElectionScheduler &) = delete;
+
+    // Replaces any earlier window. An election already open only gets its close;
+    // times already past fire on the next run.
+    ServiceStatus schedule(int electionId, Clock::time_point openAt, Clock::time_point closeAt);
+    bool cancel(int electionId); // false if nothing was scheduled
+    // fn(results) on the scheduler's thread after each scheduled close; set before start()
+    void setOnClose(function<void(const ElectionResults &)> fn) { onClose = move(fn); }
+
+    void start(); // background thread
+    void stop();
+    // Fires every transition due by `now`, earliest first; returns how many took effect.
+    size_t runDue(Clock::time_point now);
+
+    bool getFinalResults(int electionId, ElectionResults &out) const;
+    size_t pending() const; // elections with a close still to come
+    uint64_t getWakeups() const; // background thread wake-ups, for checking it stays asleep
+};
+
+/* ---------- SyntheticData ---------- */
+// Seeded, skewed test data at profiling scale. The same config and seed give the same
+// users, elections and ballots whatever the thread count.
+struct SyntheticConfig
+{
+    uint64_t seed = 1;
+    int voters = 1000000;
+    int candidates = 0; // candidate users; 0 = enough for every election to get its own mix
+    int admins = 10;
+    int elections = 1000;
+    int candidatesPerElection = 6;
+    double ballotsPerVoter = 5; // mean; per voter it is geometric, so most vote little and a few a lot
+    double electionSkew = 1.0; // Zipf exponent of election popularity
+    double candidateSkew = 0.8; // Zipf exponent of candidate preference inside an election
+    double closedFraction = 0; // elections closed after the ballots are in
+    uint32_t hashCost = 1; // every synthetic user shares one hash of `password`
+    string password = "pw";
+    int firstUserId = 0; // 0 = after the highest id in the system
+    int firstElectionId = 0;
+};
+
+struct SyntheticReport
+{
+    long long users = 0;
+    long long elections = 0;
+    long long ballots = 0;
+    long long accepted = 0;
+    double userSeconds = 0;
+    double ballotSeconds = 0;
+    double importSeconds = 0;
+};
+
+class SyntheticGenerator
+{
+private:
+    SyntheticConfig config;
+    vector<double> electionCdf; // by popularity rank
+    vector<double> candidateCdf; // by preference rank
+    vector<int> electionByRank;
+
+public:
+    static constexpr int votersPerChunk = 16384; // unit of parallel work and of seeding
+
+    SyntheticGenerator(const SyntheticConfig &cfg, const VotingSystem &system);
+
+    int firstVoter() const { return config.firstUserId; }
+    int firstCandidate() const { return config.firstUserId + config.voters; }
+    int firstElection() const { return config.firstElectionId; }
+    // candidates of an election, most preferred first
+    void electionCandidates(int electionIndex, vector<int> &out) const;
+
+    // voters, candidates, admins and OPENED elections with their candidates
+    void addUsersAndElections(VotingSystem &system, ThreadPool &pool, SyntheticReport &report) const;
+    vector<Ballot> makeBallots(ThreadPool &pool) const;
+    // everything: users, elections, ballots imported, then closedFraction closed
+    SyntheticReport populate(VotingSystem &system, ThreadPool &pool) const;
+};
+
+/* ---------- VotingServer ---------- */
+// Line protocol over TCP, one request per line, replies in request order:
+//   LOGIN <username> <password>  -> OK <userId> <role> <session token>
+//   SESSION <token>              -> OK <userId> <role>, resumes a login on this connection
+//   LOGOUT
+//   ELECTIONS                    -> OK <n>, then n lines "<id> <status> <candidates> <title>"
+//   CANDIDATES <electionId>      -> OK <n>, then n lines "<id> <username>"
+//   VOTE <electionId> <candidateId> (in a voter session) -> OK
+//   RANK <electionId> <candidateId>... (in a voter session, most preferred first) -> OK
+//   METRICS (in an admin session) -> OK <n>, then n lines of latency stats
+//   QUIT
+// Failures answer "ERR <reason>". Clients may pipeline: every complete line in a read is
+// served before the replies go out in one write. LOGIN's password check runs on a login
+// worker; its connection pauses until the reply is posted back, so order still holds.
+#ifdef __linux__
+class VotingServer
+{
+private:
+    struct Connection
+    {
+        int fd;
+        uint64_t id; // fds get reused; a login result must find the same connection
+        string in;
+        string out;
+        size_t outSent = 0;
+        SessionToken session; // checked on every vote, so a logout or expiry applies at once
+        bool loginPending = false; // no more lines are served, or read, until it answers
+        bool peerClosed = false;
+        bool quitting = false;
+        uint32_t events = EPOLLIN | EPOLLRDHUP; // interest currently registered
+    };
+
+    struct LoginJob
+    {
+        int fd;
+        uint64_t connectionId;
+        string username;
+        string password;
+        ServiceStatus status = ServiceStatus::BAD_CREDENTIALS;
+        User *user = nullptr;
+        SessionToken token;
+    };
+
+    VotingService &service;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1; // stop() and finished logins
+    uint16_t boundPort = 0;
+    thread loop;
+    atomic<bool> running{false};
+    unordered_map<int, unique_ptr<Connection>> connections;
+    uint64_t nextConnectionId = 1;
+
+    // PBKDF2 takes milliseconds, so it stays off the event loop
+    vector<thread> loginWorkers;
+    mutex loginLock;
+    condition_variable loginWake;
+    deque<LoginJob> loginQueue;
+    vector<LoginJob> loginDone; // posted back to the loop through wakeFd
+    bool loginStopping = false;
+
+    void serve();
+    void acceptAll();
+    bool readRequests(Connection &c);
+    bool serveRequests(Connection &c); // the complete lines in c.in, then EOF, then flush
+    bool flush(Connection &c);
+    void handleRequest(Connection &c, string_view line);
+    void closeConnection(int fd);
+    void loginLoop();
+    void finishLogins();
+
+public:
+    static constexpr size_t maxLine = 4096;
+
+    explicit VotingServer(VotingService &svc) : service(svc) {}
+    ~VotingServer() { stop(); }
+    VotingServer(const VotingServer &) = delete;
+    VotingServer &operator=(const VotingServer &) = delete;
+
+    bool start(uint16_t port, bool loopbackOnly = true); // port 0 picks a free one
+    void stop();
+    uint16_t port() const { return boundPort; }
+};
+#endif
+
+/* ---------- RankingTrie implementation ---------- */
+void RankingTrie::add(const int *ranking, size_t length, long long count)
+{
+    uint32_t node = 0;
+    nodes[0].total += count;
+    for (size_t i = 0; i < length; i++)
+    {
+        uint32_t child = nodes[node].firstChild;
+        while (child && nodes[child].candidateId != ranking[i])
+            child = nodes[child].nextSibling;
+        if (!child)
+        {
+            child = (uint32_t)nodes.size();
+            nodes.push_back({ranking[i], 0, nodes[node].firstChild, 0, 0});
+            nodes[node].firstChild = child;
+        }
+        nodes[child].total += count;
+        node = child;
+    }
+    nodes[node].ending += count;
+}
+
+/* ---------- Election implementation ---------- */
+VoteStatus Election::recordVote(int voterId, int candidateId, bool requireOpen)
+{
+    if (requireOpen && !isOpen())
+        return VoteStatus::ELECTION_NOT_OPEN;
+
+    // shared: other voters go ahead in parallel, candidate edits wait
+    shared_lock<shared_mutex> guard(candidatesLock);
+    int slot = findCandidateLocked(candidateId);
+    if (slot < 0)
+        return VoteStatus::CANDIDATE_NOT_FOUND;
+    // marking the voter is the duplicate check, so a second ballot never gets in
+    if (!markVoter(voterId))
+        return VoteStatus::ALREADY_VOTED;
+
+    tallies[slot]->add(voterId);
+    return VoteStatus::ACCEPTED;
+}
+
+bool Election::markVoter(int voterId)
+{
+    VoterShard &shard = shardFor(voterId);
+    lock_guard<mutex> voterGuard(shard.lock);
+    return shard.voted.insert(shardKey(voterId));
+}
+
+bool Election::beginReservation()
+{
+    unsettled.fetch_add(1);
+    if (isOpen())
+        return true;
+    settle();
+    return false;
+}
+
+void Election::settle()
+{
+    if (unsettled.fetch_sub(1) == 1 && !isOpen())
+    {
+        lock_guard<mutex> guard(settleLock);
+        settledWake.notify_all();
+    }
+}
+
+void Election::waitSettled()
+{
+    unique_lock<mutex> guard(settleLock);
+    settledWake.wait(guard, [&] { return unsettled.load() == 0; });
+}
+
+VoteStatus Election::reserveVote(int voterId, int candidateId, const vector<int> *ranking,
+                                 const function<void()> &logged, uint64_t &tallyId)
+{
+    if (!beginReservation())
+        return VoteStatus::ELECTION_NOT_OPEN;
+
+    shared_lock<shared_mutex> guard(candidatesLock);
+    VoteStatus status = ranking ? checkRankingLocked(*ranking)
+                        : findCandidateLocked(candidateId) < 0 ? VoteStatus::CANDIDATE_NOT_FOUND
+                                                               : VoteStatus::ACCEPTED;
+    if (status == VoteStatus::ACCEPTED && !markVoter(voterId))
+        status = VoteStatus::ALREADY_VOTED;
+    if (status != VoteStatus::ACCEPTED)
+    {
+        settle();
+        return status;
+    }
+
+    tallyId = tallies[findCandidateLocked(ranking ? (*ranking)[0] : candidateId)]->getId();
+    logged();
+    return VoteStatus::ACCEPTED;
+}
+
+void Election::publishVote(int voterId, int candidateId, const vector<int> *ranking, uint64_t tallyId)
+{
+    shared_lock<shared_mutex> guard(candidatesLock);
+    int slot = findCandidateLocked(ranking ? (*ranking)[0] : candidateId);
+    CandidateTally *tally = slot >= 0 && tallies[slot]->getId() == tallyId ? tallies[slot].get() : nullptr;
+    if (ranking)
+    {
+        lock_guard<mutex> rankingGuard(rankingLock);
+        rankings.add(ranking->data(), ranking->size());
+        if (tally)
+            tally->add(voterId);
+    }
+    else if (tally)
+        tally->add(voterId);
+    settle();
+}
+
+void Election::withdrawVote(int voterId)
+{
+    {
+        VoterShard &shard = shardFor(voterId);
+        lock_guard<mutex> voterGuard(shard.lock);
+        shard.voted.erase(shardKey(voterId));
+    }
+    settle();
+}
+
+void Election::reserveBatch(const int *voterIds, const int *candidateIds, size_t n, VoteStatus *status,
+                            const function<void()> &logged, uint64_t *tallyIds)
+{
+    if (!beginReservation())
+    {
+        fill(status, status + n, VoteStatus::ELECTION_NOT_OPEN);
+        return;
+    }
+
+    shared_lock<shared_mutex> guard(candidatesLock);
+    vector<int> slots(n);
+
+    // bucket the ballots by voter shard so each shard lock is taken once
+    vector<uint32_t> byShard(n);
+    size_t shardStart[voterShardCount + 1] = {};
+    for (size_t i = 0; i < n; i++)
+    {
+        slots[i] = findCandidateLocked(candidateIds[i]);
+        status[i] = slots[i] < 0 ? VoteStatus::CANDIDATE_NOT_FOUND : VoteStatus::ACCEPTED;
+        shardStart[((unsigned)voterIds[i] & (voterShardCount - 1)) + 1]++;
+    }
+    for (int s = 0; s < voterShardCount; s++)
+        shardStart[s + 1] += shardStart[s];
+    {
+        size_t next[voterShardCount];
+        copy(shardStart, shardStart + voterShardCount, next);
+        for (size_t i = 0; i < n; i++)
+            byShard[next[(unsigned)voterIds[i] & (voterShardCount - 1)]++] = (uint32_t)i;
+    }
+
+    for (int s = 0; s < voterShardCount; s++)
+    {
+        if (shardStart[s] == shardStart[s + 1])
+            continue;
+        lock_guard<mutex> voterGuard(voterShards[s].lock);
+        for (size_t k = shardStart[s]; k < shardStart[s + 1]; k++)
+        {
+            size_t i = byShard[k];
+            if (status[i] != VoteStatus::ACCEPTED)
+                continue;
+            if (!voterShards[s].voted.insert(shardKey(voterIds[i])))
+                status[i] = VoteStatus::ALREADY_VOTED;
+            else
+                tallyIds[i] = tallies[slots[i]]->getId();
+        }
+    }
+    logged();
+    // the batch stays reserved while any of its ballots is accepted
+    if (find(status, status + n, VoteStatus::ACCEPTED) == status + n)
+        settle();
+}
+
+void Election::publishBatch(const int *candidateIds, size_t n, const VoteStatus *status, const uint64_t *tallyIds)
+{
+    shared_lock<shared_mutex> guard(candidatesLock);
+    vector<long long> counts(tallies.size(), 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (status[i] != VoteStatus::ACCEPTED)
+            continue;
+        int slot = findCandidateLocked(candidateIds[i]);
+        if (slot >= 0 && tallies[slot]->getId() == tallyIds[i])
+            counts[slot]++;
+    }
+    for (size_t slot = 0; slot < counts.size(); slot++)
+    {
+        if (counts[slot])
+            tallies[slot]->add(slot, counts[slot]);
+    }
+    if (find(status, status + n, VoteStatus::ACCEPTED) != status + n)
+        settle();
+}
+
+void Election::withdrawBatch(const int *voterIds, size_t n, const VoteStatus *status)
+{
+    bool reserved = false;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (status[i] != VoteStatus::ACCEPTED)
+            continue;
+        reserved = true;
+        VoterShard &shard = shardFor(voterIds[i]);
+        lock_guard<mutex> voterGuard(shard.lock);
+        shard.voted.erase(shardKey(voterIds[i]));
+    }
+    if (reserved)
+        settle();
+}
+
+long long Election::getTotalVotes() const
+{
+    shared_lock<shared_mutex> guard(candidatesLock);
+    long long total = 0;
+    for (const auto &t : tallies)
+        total += t->total();
+    return total;
+}
+
+size_t Election::getVoterCount() const
+{
+    size_t count = 0;
+    for (VoterShard &shard : voterShards)
+    {
+        lock_guard<mutex> guard(shard.lock);
+        count += shard.voted.size();
+    }
+    return count;
+}
+
+size_t Election::getVotedMemoryBytes() const
+{
+    size_t bytes = 0;
+    for (VoterShard &shard : voterShards)
+    {
+        lock_guard<mutex> guard(shard.lock);
+        bytes += shard.voted.memoryBytes();
+    }
+    return bytes;
+}
+
+vector<CandidateResult> Election::getResults() const
+{
+    vector<CandidateResult> results;
+    {
+        shared_lock<shared_mutex> guard(candidatesLock);
+        results.reserve(candidateIds.size());
+        for (size_t i = 0; i < candidateIds.size(); i++)
+            results.push_back({candidateIds[i], tallies[i]->total()});
+    }
+
+    sort(results.begin(), results.end(),
+         [](const CandidateResult &a, const CandidateResult &b)
+         {
+             if (a.votes != b.votes)
+                 return a.votes > b.votes;
+             return a.candidateId < b.candidateId; // stable order on ties
+         });
+    return results;
+}
+
+VoteStatus Election::recordRankedVote(int voterId, const vector<int> &ranking, bool requireOpen)
+{
+    if (requireOpen && !isOpen())
+        return VoteStatus::ELECTION_NOT_OPEN;
+
+    shared_lock<shared_mutex> guard(candidatesLock);
+    VoteStatus status = checkRankingLocked(ranking);
+    if (status != VoteStatus::ACCEPTED)
+        return status;
+    if (!markVoter(voterId))
+        return VoteStatus::ALREADY_VOTED;
+
+    // together, so a runoff never sees the first choice without the ranking
+    lock_guard<mutex> rankingGuard(rankingLock);
+    rankings.add(ranking.data(), ranking.size());
+    tallies[findCandidateLocked(ranking[0])]->add(voterId);
+    return VoteStatus::ACCEPTED;
+}
+
+VoteStatus Election::checkRankingLocked(const vector<int> &ranking) const
+{
+    if (ranking.empty() || ranking.size() > candidateIds.size())
+        return VoteStatus::INVALID_RANKING;
+    vector<char> ranked(candidateIds.size(), 0);
+    for (int candidateId : ranking)
+    {
+        int slot = findCandidateLocked(candidateId);
+        if (slot < 0)
+            return VoteStatus::CANDIDATE_NOT_FOUND;
+        if (ranked[slot]++)
+            return VoteStatus::INVALID_RANKING;
+    }
+    return VoteStatus::ACCEPTED;
+}
+
+vector<int> Election::trieSlotsLocked() const
+{
+    const vector<RankingTrie::Node> &nodes = rankings.getNodes();
+    vector<int> slotOf(nodes.size(), -1);
+    for (size_t n = 1; n < nodes.size(); n++)
+        slotOf[n] = findCandidateLocked(nodes[n].candidateId);
+    return slotOf;
+}
+
+vector<long long> Election::singleChoiceVotesLocked(const vector<int> &slotOf) const
+{
+    const vector<RankingTrie::Node> &nodes = rankings.getNodes();
+    vector<long long> singles(candidateIds.size());
+    for (size_t slot = 0; slot < candidateIds.size(); slot++)
+        singles[slot] = tallies[slot]->total();
+    for (uint32_t c = nodes[0].firstChild; c; c = nodes[c].nextSibling)
+    {
+        if (slotOf[c] >= 0)
+            singles[slotOf[c]] -= nodes[c].total;
+    }
+    for (long long &votes : singles)
+        votes = max(votes, 0LL); // a candidate removed and added again restarts its tally
+    return singles;
+}
+
+RunoffResult Election::runInstantRunoff() const
+{
+    RunoffResult result;
+    shared_lock<shared_mutex> guard(candidatesLock);
+    lock_guard<mutex> rankingGuard(rankingLock);
+    const vector<RankingTrie::Node> &nodes = rankings.getNodes();
+    size_t candidateCount = candidateIds.size();
+
+    vector<int> slotOf = trieSlotsLocked();
+    vector<long long> singles = singleChoiceVotesLocked(slotOf);
+    result.ballots = rankings.ballots();
+    for (long long votes : singles)
+        result.ballots += votes;
+
+    vector<char> continuing(candidateCount, 1);
+    vector<vector<long long>> history; // counts by slot, one entry per round
+    vector<uint32_t> pending;
+    for (size_t remaining = candidateCount; remaining > 0; remaining--)
+    {
+        vector<long long> counts(candidateCount, 0);
+        long long exhausted = 0, active = 0;
+        for (size_t slot = 0; slot < candidateCount; slot++)
+            (continuing[slot] ? counts[slot] : exhausted) += singles[slot];
+
+        // a continuing candidate takes its node's whole subtree; below an eliminated
+        // one the ballots move on to their next preference or run out
+        pending.assign(1, 0);
+        while (!pending.empty())
+        {
+            uint32_t node = pending.back();
+            pending.pop_back();
+            for (uint32_t c = nodes[node].firstChild; c; c = nodes[c].nextSibling)
+            {
+                int slot = slotOf[c];
+                if (slot >= 0 && continuing[slot])
+                    counts[slot] += nodes[c].total;
+                else
+                {
+                    exhausted += nodes[c].ending;
+                    pending.push_back(c);
+                }
+            }
+        }
+
+        RunoffRound round{{}, exhausted, -1};
+        for (size_t slot = 0; slot < candidateCount; slot++)
+        {
+            if (continuing[slot])
+            {
+                round.counts.push_back({candidateIds[slot], counts[slot]});
+                active += counts[slot];
+            }
+        }
+        sort(round.counts.begin(), round.counts.end(),
+             [](const CandidateResult &a, const CandidateResult &b)
+             { return a.votes != b.votes ? a.votes > b.votes : a.candidateId < b.candidateId; });
+        history.push_back(counts);
+
+        if (active == 0)
+        {
+            result.rounds.push_back(move(round));
+            break;
+        }
+        if (remaining == 1 || round.counts[0].votes * 2 > active)
+        {
+            result.winner = round.counts[0].candidateId;
+            result.rounds.push_back(move(round));
+            break;
+        }
+
+        // last place; a tie goes to whoever had fewer votes in the latest earlier
+        // round where the tied candidates differ, and failing that to the higher id
+        long long fewest = round.counts.back().votes;
+        vector<size_t> tied;
+        for (size_t slot = 0; slot < candidateCount; slot++)
+        {
+            if (continuing[slot] && counts[slot] == fewest)
+                tied.push_back(slot);
+        }
+        for (size_t r = history.size() - 1; r-- > 0 && tied.size() > 1;)
+        {
+            long long least = history[r][tied[0]];
+            for (size_t slot : tied)
+                least = min(least, history[r][slot]);
+            tied.erase(remove_if(tied.begin(), tied.end(), [&](size_t slot) { return history[r][slot] != least; }),
+                       tied.end());
+        }
+        continuing[tied.back()] = 0;
+        round.eliminated = candidateIds[tied.back()];
+        result.rounds.push_back(move(round));
+    }
+    return result;
+}
+
+/* ---------- Pairwise count implementation ---------- */
+PairwiseMatrix Election::countPairwise(ThreadPool &pool) const
+{
+    PairwiseMatrix matrix;
+    shared_lock<shared_mutex> guard(candidatesLock);
+    lock_guard<mutex> rankingGuard(rankingLock);
+    const vector<RankingTrie::Node> &nodes = rankings.getNodes();
+    size_t n = candidateIds.size();
+    matrix.candidateIds = candidateIds;
+    matrix.prefer.assign(n * n, 0);
+
+    vector<int> slotOf = trieSlotsLocked();
+    vector<long long> singles = singleChoiceVotesLocked(slotOf);
+    matrix.ballots = rankings.ballots();
+    for (long long votes : singles)
+        matrix.ballots += votes;
+    vector<uint32_t> parent(nodes.size(), 0);
+    for (size_t node = 0; node < nodes.size(); node++)
+    {
+        for (uint32_t c = nodes[node].firstChild; c; c = nodes[c].nextSibling)
+            parent[c] = (uint32_t)node;
+    }
+
+    // The ballots through a node put its candidate above everyone except the
+    // candidates on the path above it. So a node adds its total to its candidate's
+    // whole row once, and takes it back from the columns of its ancestors: work per
+    // distinct prefix is its depth, however many ballots share it.
+    struct Scratch
+    {
+        vector<long long> row;   // by slot: added to every column of that row
+        vector<long long> taken; // n x n: taken back again
+    };
+    vector<Scratch> scratch(pool.size());
+    const size_t nodesPerTask = 1024;
+    pool.parallelFor((nodes.size() + nodesPerTask - 1) / nodesPerTask, [&](size_t task, int worker)
+    {
+        Scratch &mine = scratch[worker];
+        if (mine.row.empty())
+        {
+            mine.row.assign(n, 0);
+            mine.taken.assign(n * n, 0);
+        }
+        size_t last = min(nodes.size(), (task + 1) * nodesPerTask);
+        for (size_t node = max<size_t>(task * nodesPerTask, 1); node < last; node++)
+        {
+            int slot = slotOf[node];
+            if (slot < 0)
+                continue; // removed: its ballots carry on to the candidates below it
+            long long ballots = nodes[node].total;
+            mine.row[slot] += ballots;
+            long long *taken = &mine.taken[(size_t)slot * n];
+            for (uint32_t a = parent[node]; a; a = parent[a])
+            {
+                if (slotOf[a] >= 0)
+                    taken[slotOf[a]] += ballots;
+            }
+        }
+    });
+
+    // merge a block of rows at a time, about 32 KB of each worker's matrix
+    const size_t rowsPerBlock = max<size_t>(1, 4096 / max<size_t>(n, 1));
+    pool.parallelFor((n + rowsPerBlock - 1) / rowsPerBlock, [&](size_t block, int)
+    {
+        size_t last = min(n, (block + 1) * rowsPerBlock);
+        for (size_t i = block * rowsPerBlock; i < last; i++)
+        {
+            long long *out = &matrix.prefer[i * n];
+            for (size_t j = 0; j < n; j++)
+                out[j] = singles[i]; // a single-choice vote beats every other candidate
+            for (const Scratch &s : scratch)
+            {
+                if (s.row.empty())
+                    continue;
+                const long long *taken = &s.taken[i * n];
+                for (size_t j = 0; j < n; j++)
+                    out[j] += s.row[i] - taken[j];
+            }
+            out[i] = 0;
+        }
+    });
+    return matrix;
+}
+
+static void sortLeaderboard(vector<CandidateResult> &results)
+{
+    sort(results.begin(), results.end(),
+         [](const CandidateResult &a, const CandidateResult &b)
+         { return a.votes != b.votes ? a.votes > b.votes : a.candidateId < b.candidateId; });
+}
+
+PairwiseResult tabulatePairwise(PairwiseMatrix matrix)
+{
+    PairwiseResult result;
+    size_t n = matrix.candidateIds.size();
+
+    // Copeland, and the Condorcet winner as the one who wins every pairing
+    for (size_t i = 0; i < n; i++)
+    {
+        long long points = 0;
+        size_t wins = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            if (j == i)
+                continue;
+            if (matrix.at(i, j) > matrix.at(j, i))
+            {
+                points += 2;
+                wins++;
+            }
+            else if (matrix.at(i, j) == matrix.at(j, i))
+                points += 1;
+        }
+        result.copeland.push_back({matrix.candidateIds[i], points});
+        if (n > 1 && wins == n - 1)
+            result.condorcetWinner = matrix.candidateIds[i];
+    }
+
+    // Schulze: widest paths over the winning links, Floyd-Warshall style
+    vector<long long> strength(n * n, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            if (i != j && matrix.at(i, j) > matrix.at(j, i))
+                strength[i * n + j] = matrix.at(i, j);
+        }
+    }
+    for (size_t k = 0; k < n; k++)
+    {
+        const long long *through = &strength[k * n];
+        for (size_t i = 0; i < n; i++)
+        {
+            long long toK = strength[i * n + k];
+            if (i == k || toK == 0)
+                continue;
+            long long *from = &strength[i * n];
+            for (size_t j = 0; j < n; j++)
+            {
+                if (j != i)
+                    from[j] = max(from[j], min(toK, through[j]));
+            }
+        }
+    }
+    size_t unbeaten = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        long long beaten = 0;
+        bool lost = false;
+        for (size_t j = 0; j < n; j++)
+        {
+            beaten += strength[i * n + j] > strength[j * n + i];
+            lost = lost || strength[j * n + i] > strength[i * n + j];
+        }
+        result.schulze.push_back({matrix.candidateIds[i], beaten});
+        if (!lost && unbeaten++ == 0)
+            result.schulzeWinner = matrix.candidateIds[i];
+    }
+    if (unbeaten != 1 || matrix.ballots == 0)
+        result.schulzeWinner = -1;
+
+    sortLeaderboard(result.copeland);
+    sortLeaderboard(result.schulze);
+    result.matrix = move(matrix);
+    return result;
+}
+
+/* ---------- VotingSystem index implementation ---------- */
+vector<Vote> VotingSystem::getVotes() const
+{
+    vector<Vote> all;
+    scanVotes([&](const VoteColumns &columns)
+    {
+        for (size_t i = 0; i < columns.size(); i++)
+            all.push_back(columns.row(i));
+    });
+    sort(all.begin(), all.end(),
+         [](const Vote &a, const Vote &b)
+         { return a.getVoteId() < b.getVoteId(); });
+    return all;
+}
+
+size_t VotingSystem::getVoteCount() const
+{
+    size_t count = 0;
+    scanVotes([&](const VoteColumns &columns)
+              { count += columns.size(); });
+    return count;
+}
+
+size_t VotingSystem::getVoteStoreBytes() const
+{
+    size_t bytes = 0;
+    scanVotes([&](const VoteColumns &columns)
+              { bytes += columns.memoryBytes(); });
+    return bytes;
+}
+
+PackedBallots VotingSystem::packElection(int electionId) const
+{
+    // only the three columns this needs are read
+    vector<pair<int, int>> ballots;
+    scanVotes([&](const VoteColumns &columns)
+    {
+        const vector<int> &electionIds = columns.getElectionIds();
+        const vector<int> &voterIds = columns.getVoterIds();
+        const vector<int> &candidateIds = columns.getCandidateIds();
+        for (size_t i = 0; i < electionIds.size(); i++)
+        {
+            if (electionIds[i] == electionId)
+                ballots.emplace_back(voterIds[i], candidateIds[i]);
+        }
+    });
+
+    PackedBallots packed;
+    packed.pack(move(ballots));
+    return packed;
+}
+
+Election *VotingSystem::findElection(int electionId)
+{
+    shared_lock<shared_mutex> guard(indexLock);
+    auto it = electionById.find(electionId);
+    return it == electionById.end() ? nullptr : it->second;
+}
+
+User *VotingSystem::findUser(int userId) const
+{
+    shared_lock<shared_mutex> guard(indexLock);
+    auto it = userById.find(userId);
+    return it == userById.end() ? nullptr : it->second;
+}
+
+Voter *VotingSystem::findVoter(int userId) const
+{
+    User *u = findUser(userId);
+    return u && u->getRole() == UserRole::VOTER ? static_cast<Voter *>(u) : nullptr;
+}
+
+Candidate *VotingSystem::findCandidate(int userId) const
+{
+    User *u = findUser(userId);
+    return u && u->getRole() == UserRole::CANDIDATE ? static_cast<Candidate *>(u) : nullptr;
+}
+
+Admin *VotingSystem::findAdmin(int userId) const
+{
+    User *u = findUser(userId);
+    return u && u->getRole() == UserRole::ADMIN ? static_cast<Admin *>(u) : nullptr;
+}
+
+void VotingSystem::linkCandidate(int electionId, int candidateId, bool linked)
+{
+    unique_lock<shared_mutex> guard(indexLock);
+    vector<int> &ids = electionsByCandidate[candidateId];
+    auto it = lower_bound(ids.begin(), ids.end(), electionId);
+    if (linked && (it == ids.end() || *it != electionId))
+        ids.insert(it, electionId);
+    else if (!linked && it != ids.end() && *it == electionId)
+        ids.erase(it);
+    if (ids.empty())
+        electionsByCandidate.erase(candidateId);
+}
+
+User *VotingSystem::findUserByUsername(const string &username) const
+{
+    shared_lock<shared_mutex> guard(indexLock);
+    auto it = userByUsername.find(username);
+    return it == userByUsername.end() ? nullptr : it->second;
+}
+
+User *VotingSystem::findUserByEmail(const string &email) const
+{
+    shared_lock<shared_mutex> guard(indexLock);
+    auto it = userByEmail.find(email);
+    return it == userByEmail.end() ? nullptr : it->second;
+}
+
+vector<CandidateResult> VotingSystem::recountElection(int electionId, RecountKernel kernel)
+{
+    const Election *e = findElection(electionId);
+    if (!e)
+        return {};
+
+    vector<int> candidates = e->copyCandidates();
+    vector<long long> counts(candidates.size(), 0);
+    scanVotes([&](const VoteColumns &columns)
+    {
+        recountColumns(kernel, columns.getElectionIds().data(), columns.getCandidateIds().data(),
+                       columns.size(), electionId, candidates, counts.data());
+    });
+
+    vector<CandidateResult> results;
+    for (size_t k = 0; k < candidates.size(); k++)
+        results.push_back({candidates[k], counts[k]});
+    sort(results.begin(), results.end(),
+         [](const CandidateResult &a, const CandidateResult &b)
+         {
+             if (a.votes != b.votes)
+                 return a.votes > b.votes;
+             return a.candidateId < b.candidateId;
+         });
+    return results;
+}
+
+/* ---------- Parallel results ---------- */
+vector<ElectionResults> VotingSystem::computeClosedResults(ThreadPool &pool)
+{
+    // one flat counter array: each closed election owns a run of candidate slots
+    struct Layout
+    {
+        int electionId;
+        int base;         // first slot in the counter array
+        int minCandidate; // slotOf is indexed by candidateId - minCandidate
+        vector<int> slotOf;
+        unordered_map<int, int> sparseSlots; // if the candidate ids are too spread out
+        vector<int> candidates;
+    };
+    vector<Layout> layouts;
+    int slotCount = 0;
+    int minElection = 0, maxElection = -1;
+    {
+        shared_lock<shared_mutex> guard(indexLock);
+        for (const Election &e : elections)
+        {
+            if (e.getStatus() != ElectionStatus::CLOSED)
+                continue;
+            Layout layout;
+            layout.electionId = e.getElectionId();
+            layout.base = slotCount;
+            layout.candidates = e.copyCandidates();
+            slotCount += (int)layout.candidates.size();
+
+            if (!layout.candidates.empty())
+            {
+                auto range = minmax_element(layout.candidates.begin(), layout.candidates.end());
+                layout.minCandidate = *range.first;
+                long long span = (long long)*range.second - *range.first + 1;
+                if (span <= 65536)
+                    layout.slotOf.assign(span, -1);
+                for (size_t k = 0; k < layout.candidates.size(); k++)
+                {
+                    if (layout.slotOf.empty())
+                        layout.sparseSlots[layout.candidates[k]] = (int)k;
+                    else
+                        layout.slotOf[layout.candidates[k] - layout.minCandidate] = (int)k;
+                }
+            }
+
+            if (layouts.empty() || layout.electionId < minElection)
+                minElection = layout.electionId;
+            if (layouts.empty() || layout.electionId > maxElection)
+                maxElection = layout.electionId;
+            layouts.push_back(move(layout));
+        }
+    }
+    if (layouts.empty())
+        return {};
+
+    // electionId -> layout, direct-indexed when the ids are compact
+    vector<int> layoutOf;
+    unordered_map<int, int> sparseLayoutOf;
+    if ((long long)maxElection - minElection < (1 << 22))
+    {
+        layoutOf.assign(maxElection - minElection + 1, -1);
+        for (size_t i = 0; i < layouts.size(); i++)
+            layoutOf[layouts[i].electionId - minElection] = (int)i;
+    }
+    else
+    {
+        for (size_t i = 0; i < layouts.size(); i++)
+            sparseLayoutOf[layouts[i].electionId] = (int)i;
+    }
+
+    // hold every shard so no column reallocates under the workers
+    vector<unique_lock<mutex>> shardGuards;
+    for (VoteShard &shard : voteShards)
+        shardGuards.emplace_back(shard.lock);
+
+    struct Chunk
+    {
+        const VoteColumns *columns;
+        size_t begin, end;
+    };
+    const size_t chunkRows = 1 << 16;
+    vector<Chunk> chunks;
+    for (const VoteShard &shard : voteShards)
+    {
+        for (size_t begin = 0; begin < shard.columns.size(); begin += chunkRows)
+            chunks.push_back({&shard.columns, begin, min(shard.columns.size(), begin + chunkRows)});
+    }
+
+    // thread-local histograms, padded apart so workers don't share cache lines
+    const size_t stride = (slotCount + 7) & ~size_t(7);
+    vector<long long> histograms(stride * pool.size(), 0);
+    pool.parallelFor(chunks.size(), [&](size_t task, int worker)
+    {
+        const Chunk &chunk = chunks[task];
+        const int *electionIds = chunk.columns->getElectionIds().data();
+        const int *candidateIds = chunk.columns->getCandidateIds().data();
+        long long *counts = histograms.data() + stride * worker;
+        for (size_t i = chunk.begin; i < chunk.end; i++)
+        {
+            int layoutIndex;
+            if (!layoutOf.empty())
+            {
+                unsigned offset = (unsigned)(electionIds[i] - minElection);
+                layoutIndex = offset < layoutOf.size() ? layoutOf[offset] : -1;
+            }
+            else
+            {
+                auto it = sparseLayoutOf.find(electionIds[i]);
+                layoutIndex = it == sparseLayoutOf.end() ? -1 : it->second;
+            }
+            if (layoutIndex < 0)
+                continue;
+
+            const Layout &layout = layouts[layoutIndex];
+            int slot = -1;
+            if (!layout.slotOf.empty())
+            {
+                unsigned offset = (unsigned)(candidateIds[i] - layout.minCandidate);
+                slot = offset < layout.slotOf.size() ? layout.slotOf[offset] : -1;
+            }
+            else
+            {
+                auto it = layout.sparseSlots.find(candidateIds[i]);
+                slot = it == layout.sparseSlots.end() ? -1 : it->second;
+            }
+            if (slot >= 0)
+                counts[layout.base + slot]++;
+        }
+    });
+    shardGuards.clear();
+
+    vector<ElectionResults> all;
+    all.reserve(layouts.size());
+    for (const Layout &layout : layouts)
+    {
+        ElectionResults er{layout.electionId, 0, {}};
+        for (size_t k = 0; k < layout.candidates.size(); k++)
+        {
+            long long votes = 0;
+            for (int w = 0; w < pool.size(); w++)
+                votes += histograms[stride * w + layout.base + k];
+            er.results.push_back({layout.candidates[k], votes});
+            er.totalVotes += votes;
+        }
+        sort(er.results.begin(), er.results.end(),
+             [](const CandidateResult &a, const CandidateResult &b)
+             {
+                 if (a.votes != b.votes)
+                     return a.votes > b.votes;
+                 return a.candidateId < b.candidateId;
+             });
+        all.push_back(move(er));
+    }
+    return all;
+}
+
+bool VotingSystem::findVote(int voteId, Vote &out) const
+{
+    const VoteShard &shard = shardFor(voteId);
+    lock_guard<mutex> guard(shard.lock);
+    long row = shard.columns.find(voteId);
+    if (row < 0)
+        return false;
+    out = shard.columns.row(row);
+    return true;
+}
+
+ChangeStatus VotingSystem::addElection(int electionId, const string &title, const string &description)
+{
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    Election *created;
+    {
+        unique_lock<shared_mutex> guard(indexLock);
+        if (electionById.count(electionId))
+            return ChangeStatus::REJECTED; // id already taken
+
+        elections.emplace_back(electionId, title, description);
+        created = &elections.back();
+        electionById[electionId] = created;
+    }
+    publishElection(*created);
+
+    LogRecord record(LogRecordType::ELECTION_CREATE);
+    record.putInt(electionId);
+    record.putString(title);
+    record.putString(description);
+    return commitChange(record) ? ChangeStatus::APPLIED : ChangeStatus::NOT_DURABLE;
+}
+
+// Log and snapshot rows carry the encoded hash; rows from before hashing
+// still hold the plain text, which storeUser then hashes.
+template <class T>
+static T withStoredCredential(T user)
+{
+    PasswordHash stored;
+    if (PasswordHash::decode(user.getPassword(), stored))
+        user.setCredential(stored);
+    return user;
+}
+
+template <class T>
+T *VotingSystem::storeUser(UserPool<T> &pool, const T &user, const string &profile, uint64_t *pendingLsn,
+                           ChangeStatus *status)
+{
+    // hashing is the slow part, so it happens before any lock is taken
+    PasswordHash credential = user.getCredential();
+    if (!credential.isSet())
+        credential = PasswordHash::create(user.getPassword(), hashCost);
+
+    shared_lock<shared_mutex> checkpoint(checkpointLock, defer_lock);
+    if (!pendingLsn)
+        checkpoint.lock();
+    T *stored;
+    {
+        unique_lock<shared_mutex> guard(indexLock);
+        // id, username and email must all be unique before anything is inserted
+        if (userById.count(user.getUserId()) ||
+            userByUsername.count(user.getUsername()) ||
+            userByEmail.count(user.getEmail()))
+        {
+            if (status)
+                *status = ChangeStatus::REJECTED;
+            return nullptr;
+        }
+
+        stored = pool.emplace(user);
+        stored->setCredential(credential);
+        users.push_back(stored);
+        userById[stored->getUserId()] = stored;
+        userByUsername[stored->getUsername()] = stored;
+        userByEmail[stored->getEmail()] = stored;
+    }
+
+    if (wal)
+    {
+        LogRecord record(LogRecordType::USER_ADD);
+        record.putString(roleName(user.getRole()));
+        record.putInt(user.getUserId());
+        record.putString(user.getUsername());
+        record.putString(user.getEmail());
+        record.putString(stored->getCredential().encode()); // never the plain text
+        record.putString(profile);
+        if (pendingLsn)
+            *pendingLsn = wal->append(record);
+        else if (!commitChange(record))
+        {
+            if (status)
+                *status = ChangeStatus::NOT_DURABLE;
+            return nullptr;
+        }
+    }
+    if (status)
+        *status = ChangeStatus::APPLIED;
+    return stored;
+}
+
+Voter *VotingSystem::addUser(const Voter &voter, ChangeStatus *status)
+{
+    return storeUser(voterPool, voter, "", nullptr, status);
+}
+
+Candidate *VotingSystem::addUser(const Candidate &candidate, ChangeStatus *status)
+{
+    return storeUser(candidatePool, candidate, candidate.getProfileInfo(), nullptr, status);
+}
+
+Admin *VotingSystem::addUser(const Admin &admin, ChangeStatus *status)
+{
+    return storeUser(adminPool, admin, "", nullptr, status);
+}
+
+size_t VotingSystem::getUserStoreBytes() const
+{
+    shared_lock<shared_mutex> guard(indexLock);
+    return voterPool.memoryBytes() + candidatePool.memoryBytes() + adminPool.memoryBytes() +
+           users.capacity() * sizeof(User *);
+}
+
+// The log record of an accepted vote; ranking is null for a single-choice one.
+static LogRecord voteRecord(int voteId, int electionId, int voterId, int candidateId, const vector<int> *ranking)
+{
+    LogRecord record(ranking ? LogRecordType::RANKED_VOTE : LogRecordType::VOTE);
+    record.putInt(voteId);
+    record.putInt(electionId);
+    record.putInt(voterId);
+    record.putInt(candidateId);
+    if (ranking)
+    {
+        record.putInt((int)ranking->size());
+        for (int candidate : *ranking)
+            record.putInt(candidate);
+    }
+    return record;
+}
+
+bool VotingSystem::addVote(const Vote &vote)
+{
+    return addAcceptedVote(vote, nullptr);
+}
+
+bool VotingSystem::addRankedVote(const Vote &vote, const vector<int> &ranking)
+{
+    return !ranking.empty() && ranking[0] == vote.getCandidateId() && addAcceptedVote(vote, &ranking);
+}
+
+bool VotingSystem::addAcceptedVote(const Vote &vote, const vector<int> *ranking)
+{
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    VoteShard &shard = shardFor(vote.getVoteId());
+    lock_guard<mutex> guard(shard.lock);
+    if (shard.columns.find(vote.getVoteId()) >= 0)
+        return false;
+
+    Election *e = findElection(vote.getElectionId());
+    VoteStatus status = !e ? VoteStatus::ELECTION_NOT_FOUND
+                        : ranking ? e->recordRankedVote(vote.getVoterId(), *ranking, false)
+                                  : e->recordVote(vote.getVoterId(), vote.getCandidateId(), false);
+    if (status != VoteStatus::ACCEPTED)
+        return false;
+
+    shard.columns.append(vote.getVoteId(), vote.getElectionId(), vote.getVoterId(), vote.getCandidateId());
+
+    // new ids must come after anything loaded this way
+    int next = nextVoteId.load();
+    while (next <= vote.getVoteId() &&
+           !nextVoteId.compare_exchange_weak(next, vote.getVoteId() + 1))
+    {
+    }
+
+    if (wal) // seed data: fillDate syncs the log once at the end
+        wal->append(voteRecord(vote.getVoteId(), vote.getElectionId(), vote.getVoterId(), vote.getCandidateId(), ranking));
+    return true;
+}
+
+void VotingSystem::publishElection(const Election &e)
+{
+    catalog.publish(e.getElectionId(), [&](CatalogEntry &entry)
+    {
+        entry.title = e.getTitle();
+        entry.description = e.getDescription();
+        entry.status = e.getStatus();
+        entry.candidates = e.copyCandidates();
+    });
+}
+
+ChangeStatus VotingSystem::openElection(int electionId)
+{
+    VS_METRIC_TIMER(timer, Metric::OPEN_ELECTION);
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    Election *e = findElection(electionId);
+    if (!e || !e->open())
+        return ChangeStatus::REJECTED;
+    publishElection(*e);
+
+    LogRecord record(LogRecordType::ELECTION_OPEN);
+    record.putInt(electionId);
+    bool durable = commitChange(record);
+    VS_METRIC_OK(timer, durable);
+    return durable ? ChangeStatus::APPLIED : ChangeStatus::NOT_DURABLE;
+}
+
+ChangeStatus VotingSystem::closeElection(int electionId)
+{
+    VS_METRIC_TIMER(timer, Metric::CLOSE_ELECTION);
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    Election *e = findElection(electionId);
+    if (!e || !e->close())
+        return ChangeStatus::REJECTED;
+    e->waitSettled(); // votes accepted before the close are counted, and logged, before it
+    publishElection(*e);
+
+    LogRecord record(LogRecordType::ELECTION_CLOSE);
+    record.putInt(electionId);
+    bool durable = commitChange(record);
+    VS_METRIC_OK(timer, durable);
+    return durable ? ChangeStatus::APPLIED : ChangeStatus::NOT_DURABLE;
+}
+
+ChangeStatus VotingSystem::updateElection(int electionId, const string &title, const string &description)
+{
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    Election *e = findElection(electionId);
+    if (!e)
+        return ChangeStatus::REJECTED;
+    e->setTitle(title);
+    e->setDescription(description);
+    publishElection(*e);
+
+    LogRecord record(LogRecordType::ELECTION_UPDATE);
+    record.putInt(electionId);
+    record.putString(title);
+    record.putString(description);
+    return commitChange(record) ? ChangeStatus::APPLIED : ChangeStatus::NOT_DURABLE;
+}
+
+ChangeStatus VotingSystem::addCandidateToElection(int electionId, int candidateId)
+{
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    Election *e = findElection(electionId);
+    LogRecord record(LogRecordType::CANDIDATE_ADD);
+    record.putInt(electionId);
+    record.putInt(candidateId);
+    uint64_t lsn = 0;
+    // logged under the candidate lock, so votes cast around it keep their place in the log
+    if (!e || !e->addCandidate(candidateId, [&] { lsn = logChange(record); }))
+        return ChangeStatus::REJECTED;
+    linkCandidate(electionId, candidateId, true);
+    publishElection(*e);
+    return awaitChange(lsn) ? ChangeStatus::APPLIED : ChangeStatus::NOT_DURABLE;
+}
+
+ChangeStatus VotingSystem::removeCandidateFromElection(int electionId, int candidateId)
+{
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    Election *e = findElection(electionId);
+    LogRecord record(LogRecordType::CANDIDATE_REMOVE);
+    record.putInt(electionId);
+    record.putInt(candidateId);
+    uint64_t lsn = 0;
+    // replay must drop exactly the votes logged before this record
+    if (!e || !e->removeCandidate(candidateId, [&] { lsn = logChange(record); }))
+        return ChangeStatus::REJECTED;
+    linkCandidate(electionId, candidateId, false);
+    publishElection(*e);
+    return awaitChange(lsn) ? ChangeStatus::APPLIED : ChangeStatus::NOT_DURABLE;
+}
+
+/* ---------- Concurrent vote ingestion ---------- */
+VoteStatus VotingSystem::castVote(int electionId, int voterId, int candidateId)
+{
+    VS_METRIC_TIMER(timer, Metric::VOTE);
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    Election *e = findElection(electionId);
+    if (!e)
+        return VoteStatus::ELECTION_NOT_FOUND;
+
+    const Voter *voter = findVoter(voterId);
+    if (!voter || voter->getBanStatus())
+        return VoteStatus::VOTER_NOT_ALLOWED;
+
+    // logged in the order it was applied; counted and stored only once on disk
+    int voteId = 0;
+    uint64_t lsn = 0, tallyId = 0;
+    VoteStatus status = e->reserveVote(voterId, candidateId, nullptr, [&]
+    {
+        voteId = nextVoteId.fetch_add(1);
+        lsn = logChange(voteRecord(voteId, electionId, voterId, candidateId, nullptr));
+    }, tallyId);
+    if (status != VoteStatus::ACCEPTED)
+        return status;
+    if (!awaitChange(lsn))
+    {
+        e->withdrawVote(voterId);
+        VS_METRIC_OK(timer, false);
+        return VoteStatus::NOT_DURABLE;
+    }
+
+    e->publishVote(voterId, candidateId, nullptr, tallyId);
+    {
+        VoteShard &shard = shardFor(voteId);
+        lock_guard<mutex> guard(shard.lock);
+        shard.columns.append(voteId, electionId, voterId, candidateId);
+    }
+    VS_METRIC_OK(timer, true);
+    return VoteStatus::ACCEPTED;
+}
+
+VoteStatus VotingSystem::castRankedVote(int electionId, int voterId, const vector<int> &ranking)
+{
+    VS_METRIC_TIMER(timer, Metric::VOTE);
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    Election *e = findElection(electionId);
+    if (!e)
+        return VoteStatus::ELECTION_NOT_FOUND;
+
+    const Voter *voter = findVoter(voterId);
+    if (!voter || voter->getBanStatus())
+        return VoteStatus::VOTER_NOT_ALLOWED;
+
+    int voteId = 0;
+    uint64_t lsn = 0, tallyId = 0;
+    VoteStatus status = e->reserveVote(voterId, 0, &ranking, [&]
+    {
+        voteId = nextVoteId.fetch_add(1);
+        lsn = logChange(voteRecord(voteId, electionId, voterId, ranking[0], &ranking));
+    }, tallyId);
+    if (status != VoteStatus::ACCEPTED)
+        return status;
+    if (!awaitChange(lsn))
+    {
+        e->withdrawVote(voterId);
+        VS_METRIC_OK(timer, false);
+        return VoteStatus::NOT_DURABLE;
+    }
+
+    // the vote store keeps the first choice, which is what the tallies count
+    e->publishVote(voterId, 0, &ranking, tallyId);
+    {
+        VoteShard &shard = shardFor(voteId);
+        lock_guard<mutex> guard(shard.lock);
+        shard.columns.append(voteId, electionId, voterId, ranking[0]);
+    }
+    VS_METRIC_OK(timer, true);
+    return VoteStatus::ACCEPTED;
+}
+
+IngestReport VotingSystem::ingestVotes(const vector<Ballot> &ballots, int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = max(1u, thread::hardware_concurrency());
+
+    // same voter always lands on the same worker, so workers never race on a voter
+    vector<vector<const Ballot *>> work(threadCount);
+    for (auto &w : work)
+        w.reserve(ballots.size() / threadCount + 1);
+    for (const Ballot &b : ballots)
+        work[(unsigned)b.voterId % threadCount].push_back(&b);
+
+    vector<IngestReport> reports(threadCount);
+    vector<thread> workers;
+    for (int t = 0; t < threadCount; t++)
+    {
+        workers.emplace_back([this, &work, &reports, t]()
+        {
+            IngestReport local;
+            for (const Ballot *b : work[t])
+            {
+                VoteStatus status = castVote(b->electionId, b->voterId, b->candidateId);
+                if (status == VoteStatus::ACCEPTED)
+                    local.accepted++;
+                else if (status == VoteStatus::ALREADY_VOTED)
+                    local.alreadyVoted++;
+                else
+                    local.rejected++;
+            }
+            reports[t] = local;
+        });
+    }
+    for (thread &w : workers)
+        w.join();
+
+    IngestReport total;
+    for (const IngestReport &r : reports)
+    {
+        total.accepted += r.accepted;
+        total.alreadyVoted += r.alreadyVoted;
+        total.rejected += r.rejected;
+    }
+    return total;
+}
+
+/* ---------- VotingService implementation ---------- */
+const char *serviceStatusName(ServiceStatus status)
+{
+    switch (status)
+    {
+    case ServiceStatus::OK:
+        return "ok";
+    case ServiceStatus::ELECTION_NOT_FOUND:
+        return "election not found";
+    case ServiceStatus::USER_NOT_FOUND:
+        return "user not found";
+    case ServiceStatus::ALREADY_EXISTS:
+        return "already exists";
+    case ServiceStatus::NOT_IN_ELECTION:
+        return "candidate not in election";
+    case ServiceStatus::INVALID_STATE:
+        return "invalid election state";
+    case ServiceStatus::INVALID_INPUT:
+        return "invalid input";
+    case ServiceStatus::NOT_DURABLE:
+        return "not durable";
+    default:
+        return "bad credentials";
+    }
+}
+
+const char *electionStatusName(ElectionStatus status)
+{
+    if (status == ElectionStatus::CREATED)
+        return "Created";
+    if (status == ElectionStatus::OPENED)
+        return "Opened";
+    return "Closed";
+}
+
+// a rejected edit reports the one reason the caller has not ruled out already
+static ServiceStatus serviceStatusFor(ChangeStatus status, ServiceStatus rejected)
+{
+    if (status == ChangeStatus::APPLIED)
+        return ServiceStatus::OK;
+    return status == ChangeStatus::NOT_DURABLE ? ServiceStatus::NOT_DURABLE : rejected;
+}
+
+static ElectionInfo describeElection(const CatalogEntry &e)
+{
+    return {e.electionId, e.title, e.description, e.status, e.candidates.size()};
+}
+
+void VotingSystem::reserveUsers(size_t additional)
+{
+    unique_lock<shared_mutex> guard(indexLock);
+    users.reserve(users.size() + additional);
+    userById.reserve(userById.size() + additional);
+    userByUsername.reserve(userByUsername.size() + additional);
+    userByEmail.reserve(userByEmail.size() + additional);
+}
+
+void VotingSystem::reserveElections(size_t additional)
+{
+    unique_lock<shared_mutex> guard(indexLock);
+    electionById.reserve(electionById.size() + additional);
+}
+
+int VotingSystem::nextUserId() const
+{
+    shared_lock<shared_mutex> guard(indexLock);
+    int highest = 0;
+    for (const auto &entry : userById)
+        highest = max(highest, entry.first);
+    return highest + 1;
+}
+
+ServiceStatus VotingService::login(const string &username, const string &password, User *&user) const
+{
+    VS_METRIC_TIMER(timer, Metric::LOGIN);
+    user = system.findUserByUsername(username);
+    if (!user || !user->checkPassword(password))
+    {
+        user = nullptr;
+        return ServiceStatus::BAD_CREDENTIALS;
+    }
+    VS_METRIC_OK(timer, true);
+    return ServiceStatus::OK;
+}
+
+ServiceStatus VotingService::registerUser(UserRole role, int userId, const string &username, const string &email,
+                                          const string &password, const string &profile)
+{
+    if (userId <= 0 || username.empty() || email.empty() || password.empty())
+        return ServiceStatus::INVALID_INPUT;
+    ChangeStatus status;
+    if (role == UserRole::CANDIDATE)
+        system.addUser(Candidate(userId, username, email, password, profile, &system), &status);
+    else if (role == UserRole::ADMIN)
+        system.addUser(Admin(userId, username, email, password, &system), &status);
+    else
+        system.addUser(Voter(userId, username, email, password, &system), &status);
+    return serviceStatusFor(status, ServiceStatus::ALREADY_EXISTS);
+}
+
+vector<ElectionInfo> VotingService::listElections() const
+{
+    CatalogView catalog = system.viewCatalog();
+    vector<const CatalogEntry *> entries;
+    entries.reserve(catalog->size);
+    catalog->forEach([&](const CatalogEntry &e) { entries.push_back(&e); });
+    sort(entries.begin(), entries.end(),
+         [](const CatalogEntry *a, const CatalogEntry *b) { return a->sequence < b->sequence; });
+
+    vector<ElectionInfo> out;
+    out.reserve(entries.size());
+    for (const CatalogEntry *e : entries) // in creation order
+        out.push_back(describeElection(*e));
+    return out;
+}
+
+ServiceStatus VotingService::getElection(int electionId, ElectionInfo &out) const
+{
+    CatalogView catalog = system.viewCatalog();
+    const CatalogEntry *e = catalog->find(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    out = describeElection(*e);
+    return ServiceStatus::OK;
+}
+
+ServiceStatus VotingService::listCandidates(int electionId, vector<CandidateInfo> &out) const
+{
+    CatalogView catalog = system.viewCatalog();
+    const CatalogEntry *e = catalog->find(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    out.clear();
+    for (int candidateId : e->candidates)
+    {
+        if (const Candidate *c = system.findCandidate(candidateId))
+            out.push_back({candidateId, c->getUsername(), c->getEmail(), c->getProfileInfo()});
+    }
+    return ServiceStatus::OK;
+}
+
+ServiceStatus VotingService::getVoteCount(int electionId, int candidateId, long long &votes) const
+{
+    VS_METRIC_TIMER(timer, Metric::VOTE_COUNT);
+    const Election *e = system.findElection(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    votes = e->getVoteCount(candidateId);
+    bool member = e->findCandidate(candidateId) >= 0;
+    VS_METRIC_OK(timer, member);
+    return member ? ServiceStatus::OK : ServiceStatus::NOT_IN_ELECTION;
+}
+
+ServiceStatus VotingService::getResults(int electionId, ElectionResults &out) const
+{
+    VS_METRIC_TIMER(timer, Metric::RESULTS);
+    const Election *e = system.findElection(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    out.electionId = electionId;
+    out.results = e->getResults();
+    out.totalVotes = e->getTotalVotes();
+    VS_METRIC_OK(timer, true);
+    return ServiceStatus::OK;
+}
+
+ServiceStatus VotingService::getRunoff(int electionId, RunoffResult &out) const
+{
+    VS_METRIC_TIMER(timer, Metric::RESULTS);
+    const Election *e = system.findElection(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    out = e->runInstantRunoff();
+    VS_METRIC_OK(timer, true);
+    return ServiceStatus::OK;
+}
+
+ServiceStatus VotingService::getPairwise(int electionId, ThreadPool &pool, PairwiseResult &out) const
+{
+    VS_METRIC_TIMER(timer, Metric::RESULTS);
+    const Election *e = system.findElection(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    if (e->getStatus() != ElectionStatus::CLOSED)
+        return ServiceStatus::INVALID_STATE;
+    out = tabulatePairwise(e->countPairwise(pool));
+    VS_METRIC_OK(timer, true);
+    return ServiceStatus::OK;
+}
+
+ServiceStatus VotingService::auditElection(int electionId, vector<AuditMismatch> &mismatches) const
+{
+    const Election *e = system.findElection(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    mismatches.clear();
+    for (const CandidateResult &r : system.recountElection(electionId))
+    {
+        long long live = e->getVoteCount(r.candidateId);
+        if (live != r.votes)
+            mismatches.push_back({r.candidateId, live, r.votes});
+    }
+    return ServiceStatus::OK;
+}
+
+VoteStatus VotingService::castVote(int voterId, int electionId, int candidateId)
+{
+    return system.castVote(electionId, voterId, candidateId);
+}
+
+ServiceStatus VotingService::startSession(const string &username, const string &password, User *&user,
+                                          SessionToken &token)
+{
+    ServiceStatus status = login(username, password, user);
+    token = status == ServiceStatus::OK ? system.getSessions().issue(user) : SessionToken();
+    return status;
+}
+
+User *VotingService::resolveSession(const SessionToken &token) const
+{
+    return system.getSessions().resolve(token);
+}
+
+void VotingService::endSession(const SessionToken &token)
+{
+    system.getSessions().revoke(token);
+}
+
+VoteStatus VotingService::castVote(const SessionToken &session, int electionId, int candidateId)
+{
+    User *user = system.getSessions().resolve(session);
+    if (!user || user->getRole() != UserRole::VOTER)
+        return VoteStatus::VOTER_NOT_ALLOWED;
+    return system.castVote(electionId, user->getUserId(), candidateId);
+}
+
+VoteStatus VotingService::castRankedVote(int voterId, int electionId, const vector<int> &ranking)
+{
+    return system.castRankedVote(electionId, voterId, ranking);
+}
+
+VoteStatus VotingService::castRankedVote(const SessionToken &session, int electionId, const vector<int> &ranking)
+{
+    User *user = system.getSessions().resolve(session);
+    if (!user || user->getRole() != UserRole::VOTER)
+        return VoteStatus::VOTER_NOT_ALLOWED;
+    return system.castRankedVote(electionId, user->getUserId(), ranking);
+}
+
+ServiceStatus VotingService::createElection(int electionId, const string &title, const string &description)
+{
+    if (title.empty())
+        return ServiceStatus::INVALID_INPUT;
+    return serviceStatusFor(system.addElection(electionId, title, description), ServiceStatus::ALREADY_EXISTS);
+}
+
+ServiceStatus VotingService::updateElection(int electionId, const string &title, const string &description)
+{
+    const Election *e = system.findElection(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    return serviceStatusFor(system.updateElection(electionId, title.empty() ? e->getTitle() : title,
+                                                  description.empty() ? e->getDescription() : description),
+                            ServiceStatus::ELECTION_NOT_FOUND);
+}
+
+ServiceStatus VotingService::openElection(int electionId)
+{
+    if (!system.findElection(electionId))
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    return serviceStatusFor(system.openElection(electionId), ServiceStatus::INVALID_STATE);
+}
+
+ServiceStatus VotingService::closeElection(int electionId)
+{
+    if (!system.findElection(electionId))
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    return serviceStatusFor(system.closeElection(electionId), ServiceStatus::INVALID_STATE);
+}
+
+ServiceStatus VotingService::addCandidate(int electionId, int candidateId)
+{
+    if (!system.findElection(electionId))
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    if (!system.findCandidate(candidateId))
+        return ServiceStatus::USER_NOT_FOUND;
+    return serviceStatusFor(system.addCandidateToElection(electionId, candidateId), ServiceStatus::ALREADY_EXISTS);
+}
+
+ServiceStatus VotingService::removeCandidate(int electionId, int candidateId)
+{
+    if (!system.findElection(electionId))
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    if (!system.findCandidate(candidateId))
+        return ServiceStatus::USER_NOT_FOUND;
+    return serviceStatusFor(system.removeCandidateFromElection(electionId, candidateId), ServiceStatus::NOT_IN_ELECTION);
+}
+
+/* ---------- VotingServer implementation ---------- */
+#ifdef __linux__
+bool VotingServer::start(uint16_t port, bool loopbackOnly)
+{
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+        return false;
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    socklen_t len = sizeof(addr);
+    if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, SOMAXCONN) < 0 ||
+        getsockname(listenFd, (sockaddr *)&addr, &len) < 0)
+    {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    boundPort = ntohs(addr.sin_port);
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    running = true;
+    loginStopping = false;
+    for (unsigned i = 0; i < max(1u, thread::hardware_concurrency()); i++)
+        loginWorkers.emplace_back(&VotingServer::loginLoop, this);
+    loop = thread(&VotingServer::serve, this);
+    return true;
+}
+
+void VotingServer::stop()
+{
+    if (!running.exchange(false))
+        return;
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {} // the loop also sees running == false on its next wake
+    loop.join();
+    {
+        lock_guard<mutex> guard(loginLock);
+        loginStopping = true;
+    }
+    loginWake.notify_all();
+    for (thread &worker : loginWorkers)
+        worker.join();
+    loginWorkers.clear();
+    loginQueue.clear();
+    for (LoginJob &job : loginDone) // nobody will be told about these sessions
+    {
+        if (job.status == ServiceStatus::OK)
+            service.endSession(job.token);
+    }
+    loginDone.clear();
+    for (auto &entry : connections)
+        close(entry.first);
+    connections.clear();
+    close(listenFd);
+    close(wakeFd);
+    close(epollFd);
+    listenFd = wakeFd = epollFd = -1;
+}
+
+void VotingServer::serve()
+{
+    epoll_event events[256];
+    while (running)
+    {
+        int ready = epoll_wait(epollFd, events, 256, -1);
+        for (int i = 0; i < ready && running; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listenFd)
+            {
+                acceptAll();
+                continue;
+            }
+            if (fd == wakeFd)
+            {
+                finishLogins();
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end())
+                continue;
+            Connection &c = *it->second;
+            bool alive = !(events[i].events & (EPOLLERR | EPOLLHUP)) || (events[i].events & EPOLLIN);
+            if (alive && (events[i].events & EPOLLIN))
+                alive = readRequests(c);
+            if (alive && (events[i].events & EPOLLOUT))
+                alive = flush(c);
+            if (!alive || (c.quitting && c.outSent == c.out.size()))
+                closeConnection(fd);
+        }
+    }
+}
+
+void VotingServer::acceptAll()
+{
+    while (true)
+    {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return; // EAGAIN: backlog drained
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        auto conn = make_unique<Connection>();
+        conn->fd = fd;
+        conn->id = nextConnectionId++;
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        connections[fd] = move(conn);
+    }
+}
+
+void VotingServer::closeConnection(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
+
+void VotingServer::loginLoop()
+{
+    unique_lock<mutex> guard(loginLock);
+    while (true)
+    {
+        loginWake.wait(guard, [this] { return loginStopping || !loginQueue.empty(); });
+        if (loginStopping)
+            return;
+        LoginJob job = move(loginQueue.front());
+        loginQueue.pop_front();
+        guard.unlock();
+
+        job.status = service.startSession(job.username, job.password, job.user, job.token);
+
+        guard.lock();
+        loginDone.push_back(move(job));
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {} // eventfd: never full in practice
+    }
+}
+
+void VotingServer::finishLogins()
+{
+    uint64_t posted;
+    if (read(wakeFd, &posted, sizeof(posted)) < 0) {} // resets the eventfd; EAGAIN if already drained
+    vector<LoginJob> done;
+    {
+        lock_guard<mutex> guard(loginLock);
+        done.swap(loginDone);
+    }
+    for (LoginJob &job : done)
+    {
+        auto it = connections.find(job.fd);
+        if (it == connections.end() || it->second->id != job.connectionId)
+        {
+            if (job.status == ServiceStatus::OK) // the client left before its answer
+                service.endSession(job.token);
+            continue;
+        }
+        Connection &c = *it->second;
+        c.loginPending = false;
+        c.session = job.token;
+        if (job.status != ServiceStatus::OK)
+            c.out += "ERR bad credentials\n";
+        else
+        {
+            c.out.append("OK ").append(to_string(job.user->getUserId())).append(" ")
+                .append(roleName(job.user->getRole())).append(" ").append(c.session.toString()).append("\n");
+        }
+        if (!serveRequests(c) || (c.quitting && c.outSent == c.out.size()))
+            closeConnection(job.fd);
+    }
+}
+
+// Drains the socket, serves every complete line, then answers them all with one write.
+bool VotingServer::readRequests(Connection &c)
+{
+    char buffer[16384];
+    while (true)
+    {
+        ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            c.in.append(buffer, n);
+            if ((size_t)n < sizeof(buffer))
+                break;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n < 0 && errno == EINTR)
+            continue;
+        c.peerClosed = true; // peer closed or error: still answer what already arrived
+        break;
+    }
+    return serveRequests(c);
+}
+
+bool VotingServer::serveRequests(Connection &c)
+{
+    size_t start = 0;
+    while (!c.quitting && !c.loginPending)
+    {
+        size_t end = c.in.find('\n', start);
+        if (end == string::npos)
+            break;
+        string_view line(c.in.data() + start, end - start);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        handleRequest(c, line);
+        start = end + 1;
+    }
+    c.in.erase(0, start);
+    if (c.loginPending)
+        return flush(c); // the rest waits for the login's answer
+    if (c.in.size() > maxLine && !c.quitting)
+    {
+        c.out += "ERR line too long\n";
+        c.quitting = true;
+    }
+    if (c.peerClosed)
+        c.quitting = true; // only now, so the loop above answered the complete lines
+    return flush(c) && (!c.peerClosed || c.outSent < c.out.size());
+}
+
+bool VotingServer::flush(Connection &c)
+{
+    while (c.outSent < c.out.size())
+    {
+        ssize_t n = send(c.fd, c.out.data() + c.outSent, c.out.size() - c.outSent, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            c.outSent += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        return false;
+    }
+    bool pending = c.outSent < c.out.size();
+    if (!pending)
+    {
+        c.out.clear();
+        c.outSent = 0;
+    }
+    // only touch epoll when a slow reader starts or stops lagging, or input is done
+    // a pending login stops reading too, so a pipelining client waits in its socket buffer
+    bool reading = !c.quitting && !c.loginPending;
+    uint32_t wanted = (reading ? (uint32_t)(EPOLLIN | EPOLLRDHUP) : 0) | (pending ? (uint32_t)EPOLLOUT : 0);
+    if (wanted != c.events)
+    {
+        epoll_event ev{};
+        ev.events = wanted;
+        ev.data.fd = c.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+        c.events = wanted;
+    }
+    return true;
+}
+
+static string_view nextToken(string_view &line)
+{
+    size_t begin = line.find_first_not_of(' ');
+    if (begin == string_view::npos)
+    {
+        line = {};
+        return {};
+    }
+    line.remove_prefix(begin);
+    size_t end = min(line.find(' '), line.size());
+    string_view token = line.substr(0, end);
+    line.remove_prefix(end);
+    return token;
+}
+
+static bool parseToken(string_view token, int &out)
+{
+    auto result = from_chars(token.data(), token.data() + token.size(), out);
+    return result.ec == errc() && result.ptr == token.data() + token.size() && !token.empty();
+}
+
+void VotingServer::handleRequest(Connection &c, string_view line)
+{
+    string &out = c.out;
+    string_view command = nextToken(line);
+    if (command == "VOTE")
+    {
+        int electionId, candidateId;
+        if (!parseToken(nextToken(line), electionId) || !parseToken(nextToken(line), candidateId))
+            out += "ERR usage: VOTE <electionId> <candidateId>\n";
+        else if (c.session.empty())
+            out += "ERR login as a voter first\n";
+        else
+        {
+            VoteStatus status = service.castVote(c.session, electionId, candidateId);
+            if (status == VoteStatus::ACCEPTED)
+                out += "OK\n";
+            else
+                out.append("ERR ").append(voteStatusName(status)).append("\n");
+        }
+    }
+    else if (command == "RANK")
+    {
+        int electionId, candidateId;
+        vector<int> ranking;
+        bool valid = parseToken(nextToken(line), electionId);
+        for (string_view token = nextToken(line); valid && !token.empty(); token = nextToken(line))
+        {
+            valid = parseToken(token, candidateId);
+            ranking.push_back(candidateId);
+        }
+        if (!valid || ranking.empty())
+            out += "ERR usage: RANK <electionId> <candidateId>...\n";
+        else if (c.session.empty())
+            out += "ERR login as a voter first\n";
+        else
+        {
+            VoteStatus status = service.castRankedVote(c.session, electionId, ranking);
+            if (status == VoteStatus::ACCEPTED)
+                out += "OK\n";
+            else
+                out.append("ERR ").append(voteStatusName(status)).append("\n");
+        }
+    }
+    else if (command == "LOGIN")
+    {
+        // answered by finishLogins once a login worker has checked the password;
+        // the session it replaces ends now, whatever the outcome
+        service.endSession(c.session);
+        c.session = SessionToken();
+        LoginJob job;
+        job.fd = c.fd;
+        job.connectionId = c.id;
+        job.username = string(nextToken(line));
+        job.password = string(nextToken(line));
+        {
+            lock_guard<mutex> guard(loginLock);
+            loginQueue.push_back(move(job));
+        }
+        loginWake.notify_one();
+        c.loginPending = true;
+    }
+    else if (command == "SESSION")
+    {
+        SessionToken token;
+        User *user = SessionToken::parse(nextToken(line), token) ? service.resolveSession(token) : nullptr;
+        if (!user)
+            out += "ERR unknown or expired session\n";
+        else
+        {
+            c.session = token;
+            out.append("OK ").append(to_string(user->getUserId())).append(" ")
+               .append(roleName(user->getRole())).append("\n");
+        }
+    }
+    else if (command == "LOGOUT")
+    {
+        service.endSession(c.session);
+        c.session = SessionToken();
+        out += "OK\n";
+    }
+    else if (command == "ELECTIONS")
+    {
+        vector<ElectionInfo> elections = service.listElections();
+        out.append("OK ").append(to_string(elections.size())).append("\n");
+        for (const ElectionInfo &e : elections)
+            out.append(to_string(e.electionId)).append(" ").append(electionStatusName(e.status)).append(" ")
+               .append(to_string(e.candidateCount)).append(" ").append(e.title).append("\n");
+    }
+    else if (command == "CANDIDATES")
+    {
+        int electionId;
+        vector<CandidateInfo> candidates;
+        ServiceStatus status = parseToken(nextToken(line), electionId)
+                                   ? service.listCandidates(electionId, candidates)
+                                   : ServiceStatus::INVALID_INPUT;
+        if (status != ServiceStatus::OK)
+            out.append("ERR ").append(serviceStatusName(status)).append("\n");
+        else
+        {
+            out.append("OK ").append(to_string(candidates.size())).append("\n");
+            for (const CandidateInfo &ci : candidates)
+                out.append(to_string(ci.candidateId)).append(" ").append(ci.username).append("\n");
+        }
+    }
+    else if (command == "METRICS")
+    {
+        User *user = c.session.empty() ? nullptr : service.resolveSession(c.session);
+        if (!user || user->getRole() != UserRole::ADMIN)
+            out += "ERR login as an admin first\n";
+        else
+        {
+            ostringstream report;
+            writeMetrics(report);
+            string text = report.str();
+            out.append("OK ").append(to_string(count(text.begin(), text.end(), '\n'))).append("\n").append(text);
+        }
+    }
+    else if (command == "QUIT")
+    {
+        out += "OK bye\n";
+        c.quitting = true;
+    }
+    else if (!command.empty())
+        out += "ERR unknown command\n";
+}
+#endif
+
+/* ---------- TallyFeed implementation ---------- */
+void TallyFeed::start(chrono::milliseconds interval)
+{
+    stop();
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = false;
+    }
+    publisher = thread([this, interval]
+    {
+        unique_lock<mutex> guard(lock);
+        while (!newBatch.wait_for(guard, interval, [this] { return stopping; }))
+        {
+            guard.unlock();
+            publishNow();
+            guard.lock();
+        }
+    });
+}
+
+void TallyFeed::stop()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    newBatch.notify_all(); // also releases readers blocked in waitAfter
+    if (publisher.joinable())
+        publisher.join();
+}
+
+uint64_t TallyFeed::publishNow()
+{
+    lock_guard<mutex> tick(tickLock);
+    auto batch = make_shared<TallyBatch>();
+    batch->resync = false;
+    system.forEachElection([&](const Election &e)
+    {
+        ElectionStatus status = e.getStatus();
+        if (status == ElectionStatus::CREATED)
+            return; // no votes yet
+        auto found = published.find(e.getElectionId());
+        if (found != published.end() && found->second.closed)
+            return; // final totals already out
+        if (found == published.end())
+            found = published.emplace(e.getElectionId(), Published()).first;
+        Published &last = found->second;
+
+        // merge the current tallies against the last published ones, both sorted by candidate
+        vector<int> candidates;
+        vector<long long> totals;
+        size_t old = 0;
+        e.forEachTally([&](int candidateId, long long votes)
+        {
+            for (; old < last.candidates.size() && last.candidates[old] < candidateId; old++)
+                batch->changes.push_back({e.getElectionId(), last.candidates[old], -last.totals[old], 0});
+            long long before = 0;
+            if (old < last.candidates.size() && last.candidates[old] == candidateId)
+                before = last.totals[old++];
+            if (votes != before)
+                batch->changes.push_back({e.getElectionId(), candidateId, votes - before, votes});
+            candidates.push_back(candidateId);
+            totals.push_back(votes);
+        });
+        for (; old < last.candidates.size(); old++) // removed after the last tick
+            batch->changes.push_back({e.getElectionId(), last.candidates[old], -last.totals[old], 0});
+        last.candidates = move(candidates);
+        last.totals = move(totals);
+        if (status == ElectionStatus::CLOSED)
+        {
+            last.closed = true;
+            batch->closedElections.push_back(e.getElectionId());
+        }
+    });
+    if (batch->changes.empty() && batch->closedElections.empty())
+        return 0; // idle ticks publish nothing
+
+    lock_guard<mutex> guard(lock);
+    batch->sequence = ++lastSequence;
+    batch->publishedAt = chrono::steady_clock::now();
+    recent.push_back(move(batch));
+    if (recent.size() > history)
+        recent.pop_front();
+    newBatch.notify_all();
+    return lastSequence;
+}
+
+shared_ptr<const TallyBatch> TallyFeed::buildResync()
+{
+    lock_guard<mutex> tick(tickLock); // no tick half way through `published`
+    auto batch = make_shared<TallyBatch>();
+    batch->resync = true;
+    for (const auto &entry : published)
+    {
+        for (size_t i = 0; i < entry.second.candidates.size(); i++)
+            batch->changes.push_back({entry.first, entry.second.candidates[i], entry.second.totals[i],
+                                      entry.second.totals[i]});
+        if (entry.second.closed)
+            batch->closedElections.push_back(entry.first);
+    }
+    lock_guard<mutex> guard(lock);
+    batch->sequence = lastSequence;
+    batch->publishedAt = chrono::steady_clock::now();
+    return batch;
+}
+
+vector<shared_ptr<const TallyBatch>> TallyFeed::waitAfter(uint64_t &cursor, chrono::milliseconds timeout)
+{
+    vector<shared_ptr<const TallyBatch>> out;
+    unique_lock<mutex> guard(lock);
+    newBatch.wait_for(guard, timeout, [&] { return lastSequence > cursor || stopping; });
+    if (lastSequence <= cursor)
+        return out;
+    if (recent.front()->sequence > cursor + 1) // the batches this reader needs are gone
+    {
+        guard.unlock();
+        out.push_back(buildResync());
+        cursor = out.back()->sequence;
+        return out;
+    }
+    for (auto it = recent.end() - (lastSequence - cursor); it != recent.end(); ++it)
+        out.push_back(*it);
+    cursor = lastSequence;
+    return out;
+}
+
+/* ---------- ElectionCatalog implementation ---------- */
+// Epoch-based reclamation. Every thread that reads has a slot; inside a view it holds
+// the epoch the view started in. Each edit advances the epoch after its swap, and
+// what it replaced can go once every occupied slot holds a later epoch.
+struct alignas(64) EpochSlot
+{
+    atomic<uint64_t> pinned{0}; // 0 = not inside a view
+    int depth = 0;              // nested views on the owning thread
+};
+
+struct EpochRegistry
+{
+    mutex lock;
+    vector<EpochSlot *> live;
+    atomic<uint64_t> epoch{1};
+};
+
+static EpochRegistry &epochRegistry()
+{
+    static EpochRegistry registry;
+    return registry;
+}
+
+static thread_local EpochSlot *threadEpoch = nullptr;
+
+struct EpochThreadSlot
+{
+    unique_ptr<EpochSlot> slot = make_unique<EpochSlot>();
+
+    EpochThreadSlot()
+    {
+        EpochRegistry &registry = epochRegistry();
+        lock_guard<mutex> guard(registry.lock);
+        registry.live.push_back(slot.get());
+    }
+
+    ~EpochThreadSlot()
+    {
+        EpochRegistry &registry = epochRegistry();
+        lock_guard<mutex> guard(registry.lock);
+        registry.live.erase(find(registry.live.begin(), registry.live.end(), slot.get()));
+        threadEpoch = nullptr;
+    }
+};
+
+static EpochSlot *registerEpochThread()
+{
+    static thread_local EpochThreadSlot slot;
+    return slot.slot.get();
+}
+
+CatalogView::CatalogView(const ElectionCatalog &catalog)
+{
+    if (!threadEpoch)
+        threadEpoch = registerEpochThread();
+    // announce before loading: an edit that misses the announcement has already swapped
+    if (threadEpoch->depth++ == 0)
+        threadEpoch->pinned.store(epochRegistry().epoch.load());
+    version = catalog.current.load();
+}
+
+CatalogView::~CatalogView()
+{
+    if (--threadEpoch->depth == 0)
+        threadEpoch->pinned.store(0, memory_order_release);
+}
+
+const CatalogEntry *ElectionCatalog::Version::find(int electionId) const
+{
+    uint32_t key = (uint32_t)electionId;
+    if (levels < maxLevels && (key >> (bits * levels)) != 0)
+        return nullptr;
+    const Node *node = root;
+    for (int level = levels - 1; node && level > 0; level--)
+        node = node->children[(key >> (bits * level)) & (fanout - 1)];
+    return node ? node->entries[key & (fanout - 1)] : nullptr;
+}
+
+const ElectionCatalog::Node *ElectionCatalog::copyPath(const Node *node, int level, uint32_t key,
+                                                       const CatalogEntry *entry, Garbage &garbage,
+                                                       const CatalogEntry *&replaced)
+{
+    Node *copy = node ? new Node(*node) : new Node();
+    if (node)
+        garbage.nodes.push_back(node);
+    int index = (key >> (bits * level)) & (fanout - 1);
+    if (level == 0)
+    {
+        replaced = copy->entries[index];
+        copy->entries[index] = entry;
+    }
+    else
+        copy->children[index] = copyPath(copy->children[index], level - 1, key, entry, garbage, replaced);
+    return copy;
+}
+
+void ElectionCatalog::publishLocked(const Version *old, const CatalogEntry *entry, bool added)
+{
+    uint32_t key = (uint32_t)entry->electionId;
+    Version *next = new Version(*old);
+    next->number++;
+    next->size += added;
+    // a taller trie for a larger id: the old root becomes the new root's first child
+    while (next->levels < maxLevels && (key >> (bits * next->levels)) != 0)
+    {
+        if (next->root)
+        {
+            Node *up = new Node();
+            up->children[0] = next->root;
+            next->root = up;
+        }
+        next->levels++;
+    }
+
+    Garbage garbage;
+    garbage.version = old;
+    next->root = copyPath(next->root, next->levels - 1, key, entry, garbage, garbage.entry);
+    // nodes added by the growth above were never published; they go with the rest
+    current.store(next);
+    retireLocked(move(garbage));
+}
+
+void ElectionCatalog::retireLocked(Garbage garbage)
+{
+    EpochRegistry &registry = epochRegistry();
+    garbage.epoch = registry.epoch.fetch_add(1); // after the swap
+    retired.push_back(move(garbage));
+
+    uint64_t oldest = UINT64_MAX; // earliest epoch a current reader started in
+    {
+        lock_guard<mutex> guard(registry.lock);
+        for (const EpochSlot *slot : registry.live)
+        {
+            uint64_t pinned = slot->pinned.load();
+            if (pinned)
+                oldest = min(oldest, pinned);
+        }
+    }
+    while (!retired.empty() && retired.front().epoch < oldest)
+    {
+        Garbage &g = retired.front();
+        delete g.version;
+        for (const Node *node : g.nodes)
+            delete node;
+        delete g.entry;
+        retired.pop_front();
+    }
+}
+
+void ElectionCatalog::freeTree(const Node *node, int level)
+{
+    if (!node)
+        return;
+    for (int i = 0; i < fanout; i++)
+    {
+        if (level > 0)
+            freeTree(node->children[i], level - 1);
+        else
+            delete node->entries[i];
+    }
+    delete node;
+}
+
+ElectionCatalog::~ElectionCatalog()
+{
+    const Version *last = current.load();
+    freeTree(last->root, last->levels - 1);
+    delete last;
+    for (Garbage &g : retired)
+    {
+        delete g.version;
+        for (const Node *node : g.nodes)
+            delete node;
+        delete g.entry;
+    }
+}
+
+size_t ElectionCatalog::retiredCount() const
+{
+    lock_guard<mutex> guard(writeLock);
+    return retired.size();
+}
+
+/* ---------- ElectionScheduler implementation ---------- */
+void ElectionScheduler::pushLocked(const Transition &transition)
+{
+    heap.push_back(transition);
+    push_heap(heap.begin(), heap.end(), later);
+}
+
+ServiceStatus ElectionScheduler::schedule(int electionId, Clock::time_point openAt, Clock::time_point closeAt)
+{
+    const Election *e = system.findElection(electionId);
+    if (!e)
+        return ServiceStatus::ELECTION_NOT_FOUND;
+    if (closeAt <= openAt)
+        return ServiceStatus::INVALID_INPUT;
+    ElectionStatus status = e->getStatus();
+    if (status == ElectionStatus::CLOSED)
+        return ServiceStatus::INVALID_STATE;
+
+    {
+        lock_guard<mutex> guard(lock);
+        uint64_t generation = ++lastGeneration;
+        generations[electionId] = generation;
+        if (status == ElectionStatus::CREATED)
+            pushLocked({openAt, electionId, false, generation});
+        pushLocked({closeAt, electionId, true, generation});
+
+        // rescheduling leaves stale entries behind; drop them before they pile up
+        if (heap.size() > 4 * generations.size() + 64)
+        {
+            heap.erase(remove_if(heap.begin(), heap.end(),
+                                 [&](const Transition &t)
+                                 {
+                                     auto found = generations.find(t.electionId);
+                                     return found == generations.end() || found->second != t.generation;
+                                 }),
+                       heap.end());
+            make_heap(heap.begin(), heap.end(), later);
+        }
+    }
+    wake.notify_all(); // it may be the new earliest deadline
+    return ServiceStatus::OK;
+}
+
+bool ElectionScheduler::cancel(int electionId)
+{
+    lock_guard<mutex> guard(lock);
+    return generations.erase(electionId) > 0; // its heap entries turn stale
+}
+
+void ElectionScheduler::start()
+{
+    stop();
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = false;
+    }
+    runner = thread([this]
+    {
+        unique_lock<mutex> guard(lock);
+        while (!stopping)
+        {
+            if (heap.empty())
+                wake.wait(guard);
+            else
+                wake.wait_until(guard, heap.front().due);
+            wakeups++;
+            if (stopping)
+                break;
+            guard.unlock();
+            runDue(Clock::now());
+            guard.lock();
+        }
+    });
+}
+
+void ElectionScheduler::stop()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (runner.joinable())
+        runner.join();
+}
+
+size_t ElectionScheduler::runDue(Clock::time_point now)
+{
+    lock_guard<mutex> run(runLock);
+    VotingService service(system);
+    size_t fired = 0;
+    while (true)
+    {
+        Transition next;
+        {
+            lock_guard<mutex> guard(lock);
+            if (heap.empty() || heap.front().due > now)
+                break;
+            pop_heap(heap.begin(), heap.end(), later);
+            next = heap.back();
+            heap.pop_back();
+            auto found = generations.find(next.electionId);
+            if (found == generations.end() || found->second != next.generation)
+                continue; // rescheduled or cancelled since
+            if (next.close)
+                generations.erase(found);
+        }
+
+        if (!next.close)
+        {
+            fired += service.openElection(next.electionId) == ServiceStatus::OK;
+            continue;
+        }
+        if (service.closeElection(next.electionId) != ServiceStatus::OK)
+            continue; // closed by hand, or never opened
+        fired++;
+        ElectionResults results;
+        service.getResults(next.electionId, results);
+        if (onClose)
+            onClose(results);
+        lock_guard<mutex> guard(lock);
+        finals[next.electionId] = move(results);
+    }
+    return fired;
+}
+
+bool ElectionScheduler::getFinalResults(int electionId, ElectionResults &out) const
+{
+    lock_guard<mutex> guard(lock);
+    auto found = finals.find(electionId);
+    if (found == finals.end())
+        return false;
+    out = found->second;
+    return true;
+}
+
+size_t ElectionScheduler::pending() const
+{
+    lock_guard<mutex> guard(lock);
+    return generations.size();
+}
+
+uint64_t ElectionScheduler::getWakeups() const
+{
+    lock_guard<mutex> guard(lock);
+    return wakeups;
+}
+
+/* ---------- SyntheticData implementation ---------- */
+struct SplitMix64
+{
+    uint64_t state;
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); } // [0, 1)
+};
+
+static vector<double> zipfCdf(int n, double exponent)
+{
+    vector<double> cdf(n);
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+        cdf[i] = sum += 1.0 / pow(i + 1.0, exponent);
+    for (double &c : cdf)
+        c /= sum;
+    return cdf;
+}
+
+static int sampleCdf(const vector<double> &cdf, double u)
+{
+    return min((int)(upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin()), (int)cdf.size() - 1);
+}
+
+SyntheticGenerator::SyntheticGenerator(const SyntheticConfig &cfg, const VotingSystem &system) : config(cfg)
+{
+    config.voters = max(config.voters, 0);
+    config.elections = max(config.elections, 1);
+    config.candidatesPerElection = max(config.candidatesPerElection, 1);
+    if (config.candidates <= 0)
+        config.candidates = max(config.candidatesPerElection, config.elections * config.candidatesPerElection / 4);
+    config.candidatesPerElection = min(config.candidatesPerElection, config.candidates);
+    if (config.firstUserId <= 0)
+        config.firstUserId = system.nextUserId();
+    if (config.firstElectionId <= 0)
+    {
+        int highest = 0;
+        system.forEachElection([&](const Election &e) { highest = max(highest, e.getElectionId()); });
+        config.firstElectionId = highest + 1;
+    }
+
+    electionCdf = zipfCdf(config.elections, config.electionSkew);
+    candidateCdf = zipfCdf(config.candidatesPerElection, config.candidateSkew);
+    // popularity is not tied to election id order
+    electionByRank.resize(config.elections);
+    iota(electionByRank.begin(), electionByRank.end(), 0);
+    SplitMix64 random(config.seed);
+    for (int i = config.elections - 1; i > 0; i--)
+        swap(electionByRank[i], electionByRank[random.next() % (i + 1)]);
+}
+
+void SyntheticGenerator::electionCandidates(int electionIndex, vector<int> &out) const
+{
+    // a window of the candidate pool, rotated so each election has its own favourite
+    SplitMix64 random(config.seed ^ (0x5bd1e995ull * (electionIndex + 1)));
+    int start = (int)(random.next() % config.candidates);
+    out.clear();
+    for (int i = 0; i < config.candidatesPerElection; i++)
+        out.push_back(firstCandidate() + (start + i) % config.candidates);
+}
+
+void SyntheticGenerator::addUsersAndElections(VotingSystem &system, ThreadPool &pool, SyntheticReport &report) const
+{
+    auto start = chrono::steady_clock::now();
+    PasswordHash shared = PasswordHash::create(config.password, config.hashCost); // hashing once, not per user
+    int userCount = config.voters + config.candidates + config.admins;
+    system.reserveUsers(userCount);
+
+    // objects and their strings are built in parallel, the indexes are filled in order
+    size_t chunks = ((size_t)userCount + votersPerChunk - 1) / votersPerChunk;
+    vector<vector<Voter>> voters(chunks);
+    pool.parallelFor(chunks, [&](size_t chunk, int)
+    {
+        int first = (int)chunk * votersPerChunk, last = min(config.voters, first + votersPerChunk);
+        if (first >= last)
+            return;
+        voters[chunk].reserve(last - first);
+        for (int i = first; i < last; i++)
+        {
+            string name = "voter" + to_string(firstVoter() + i);
+            voters[chunk].emplace_back(firstVoter() + i, name, name + "@synthetic.test", "", &system);
+            voters[chunk].back().setCredential(shared);
+        }
+    });
+    for (vector<Voter> &chunk : voters)
+    {
+        for (const Voter &v : chunk)
+            report.users += system.addUser(v) != nullptr;
+        vector<Voter>().swap(chunk);
+    }
+    for (int i = 0; i < config.candidates; i++)
+    {
+        string name = "candidate" + to_string(firstCandidate() + i);
+        Candidate c(firstCandidate() + i, name, name + "@synthetic.test", "", "Synthetic candidate " + to_string(i),
+                    &system);
+        c.setCredential(shared);
+        report.users += system.addUser(c) != nullptr;
+    }
+    for (int i = 0; i < config.admins; i++)
+    {
+        int id = firstCandidate() + config.candidates + i;
+        string name = "admin" + to_string(id);
+        Admin a(id, name, name + "@synthetic.test", "", &system);
+        a.setCredential(shared);
+        report.users += system.addUser(a) != nullptr;
+    }
+
+    system.reserveElections(config.elections);
+    vector<int> candidates;
+    for (int i = 0; i < config.elections; i++)
+    {
+        int id = firstElection() + i;
+        if (system.addElection(id, "Synthetic election " + to_string(i + 1), "Generated, seed " + to_string(config.seed)) ==
+            ChangeStatus::REJECTED)
+            continue;
+        electionCandidates(i, candidates);
+        for (int c : candidates)
+            system.addCandidateToElection(id, c);
+        system.openElection(id);
+        report.elections++;
+    }
+    report.userSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+vector<Ballot> SyntheticGenerator::makeBallots(ThreadPool &pool) const
+{
+    size_t chunks = ((size_t)config.voters + votersPerChunk - 1) / votersPerChunk;
+    vector<vector<Ballot>> parts(chunks);
+    double stop = 1.0 / (config.ballotsPerVoter + 1); // geometric with the configured mean
+    pool.parallelFor(chunks, [&](size_t chunk, int)
+    {
+        SplitMix64 random(config.seed * 0x9e3779b97f4a7c15ull + chunk + 1); // per chunk, not per thread
+        int first = (int)chunk * votersPerChunk, last = min(config.voters, first + votersPerChunk);
+        vector<Ballot> &out = parts[chunk];
+        out.reserve((size_t)((last - first) * config.ballotsPerVoter * 1.1) + 16);
+        vector<int> chosen, candidates;
+        for (int v = first; v < last; v++)
+        {
+            int wanted = 0;
+            while (wanted < config.elections && random.uniform() >= stop)
+                wanted++;
+            chosen.clear();
+            for (int attempt = 0; (int)chosen.size() < wanted && attempt < wanted * 8; attempt++)
+            {
+                int e = electionByRank[sampleCdf(electionCdf, random.uniform())];
+                if (find(chosen.begin(), chosen.end(), e) == chosen.end())
+                    chosen.push_back(e); // one ballot per election
+            }
+            for (int e : chosen)
+            {
+                electionCandidates(e, candidates);
+                out.push_back({firstElection() + e, firstVoter() + v,
+                               candidates[sampleCdf(candidateCdf, random.uniform())]});
+            }
+        }
+    });
+
+    size_t total = 0;
+    for (const vector<Ballot> &part : parts)
+        total += part.size();
+    vector<Ballot> ballots;
+    ballots.reserve(total);
+    for (vector<Ballot> &part : parts)
+    {
+        ballots.insert(ballots.end(), part.begin(), part.end());
+        vector<Ballot>().swap(part);
+    }
+    return ballots;
+}
+
+SyntheticReport SyntheticGenerator::populate(VotingSystem &system, ThreadPool &pool) const
+{
+    SyntheticReport report;
+    addUsersAndElections(system, pool, report);
+
+    auto start = chrono::steady_clock::now();
+    vector<Ballot> ballots = makeBallots(pool);
+    report.ballots = (long long)ballots.size();
+    report.ballotSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    const size_t block = 1 << 20; // bounds importBallots' scratch space
+    for (size_t at = 0; at < ballots.size(); at += block)
+    {
+        vector<Ballot> part(ballots.begin() + at, ballots.begin() + min(ballots.size(), at + block));
+        report.accepted += system.importBallots(part).accepted;
+    }
+    int toClose = (int)(config.elections * config.closedFraction);
+    for (int i = 0; i < toClose; i++)
+        system.closeElection(firstElection() + electionByRank[config.elections - 1 - i]); // least popular first
+    report.importSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+/* ---------- Batch ballot import ---------- */
+ImportReport VotingSystem::importBallots(const vector<Ballot> &ballots)
+{
+    auto start = chrono::steady_clock::now();
+    ImportReport report;
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+
+    // group rows by election, keeping file order inside each group
+    vector<uint32_t> order(ballots.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                { return ballots[a].electionId < ballots[b].electionId; });
+
+    vector<VoteStatus> status(ballots.size(), VoteStatus::ACCEPTED);
+    vector<pair<Election *, size_t>> groups; // election, first position in order
+    {
+        // elections and voters resolved under a single index lock
+        shared_lock<shared_mutex> guard(indexLock);
+        Election *e = nullptr;
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            const Ballot &b = ballots[order[k]];
+            if (k == 0 || b.electionId != ballots[order[k - 1]].electionId)
+            {
+                auto it = electionById.find(b.electionId);
+                e = it == electionById.end() ? nullptr : it->second;
+                groups.push_back({e, k});
+            }
+            if (!e)
+            {
+                status[order[k]] = VoteStatus::ELECTION_NOT_FOUND;
+                continue;
+            }
+            auto user = userById.find(b.voterId);
+            if (user == userById.end() || user->second->getRole() != UserRole::VOTER ||
+                user->second->getBanStatus())
+                status[order[k]] = VoteStatus::VOTER_NOT_ALLOWED;
+        }
+    }
+
+    // Rows still in play, laid out group by group. Each group is reserved and logged
+    // under its election's candidate lock, so the log keeps the order candidate edits
+    // see; nothing is counted or stored until the whole import is durable.
+    vector<int> voterIds, candidateIds, voteIds;
+    vector<uint32_t> rows;
+    vector<size_t> groupStart;
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        groupStart.push_back(rows.size());
+        if (!groups[g].first)
+            continue;
+        size_t end = g + 1 < groups.size() ? groups[g + 1].second : order.size();
+        for (size_t k = groups[g].second; k < end; k++)
+        {
+            if (status[order[k]] != VoteStatus::ACCEPTED)
+                continue;
+            rows.push_back(order[k]);
+            voterIds.push_back(ballots[order[k]].voterId);
+            candidateIds.push_back(ballots[order[k]].candidateId);
+        }
+    }
+    groupStart.push_back(rows.size());
+
+    vector<VoteStatus> outcome(rows.size());
+    vector<uint64_t> tallyIds(rows.size());
+    voteIds.resize(rows.size());
+    vector<pair<int, size_t>> idBlocks; // first vote id, first position in accepted
+    vector<uint32_t> accepted;          // positions in rows, in vote id order
+    uint64_t last = 0;
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        size_t from = groupStart[g], n = groupStart[g + 1] - from;
+        if (!n)
+            continue;
+        groups[g].first->reserveBatch(voterIds.data() + from, candidateIds.data() + from, n,
+                                      outcome.data() + from, [&]
+        {
+            // one block of vote ids per group
+            size_t first = accepted.size();
+            for (size_t j = from; j < from + n; j++)
+            {
+                if (outcome[j] == VoteStatus::ACCEPTED)
+                    accepted.push_back((uint32_t)j);
+            }
+            if (accepted.size() == first)
+                return;
+            int firstId = nextVoteId.fetch_add((int)(accepted.size() - first));
+            idBlocks.push_back({firstId, first});
+            for (size_t a = first; a < accepted.size(); a++)
+            {
+                uint32_t j = accepted[a];
+                voteIds[j] = firstId + (int)(a - first);
+                const Ballot &b = ballots[rows[j]];
+                last = logChange(voteRecord(voteIds[j], b.electionId, b.voterId, b.candidateId, nullptr));
+            }
+        }, tallyIds.data() + from);
+    }
+    report.durable = accepted.empty() || awaitChange(last); // one commit for the whole import
+
+    if (!report.durable)
+    {
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            size_t from = groupStart[g], n = groupStart[g + 1] - from;
+            if (n)
+                groups[g].first->withdrawBatch(voterIds.data() + from, n, outcome.data() + from);
+        }
+        for (VoteStatus &o : outcome)
+        {
+            if (o == VoteStatus::ACCEPTED)
+                o = VoteStatus::NOT_DURABLE;
+        }
+        accepted.clear();
+    }
+    for (size_t j = 0; j < rows.size(); j++)
+        status[rows[j]] = outcome[j];
+    for (size_t row = 0; row < ballots.size(); row++)
+    {
+        if (status[row] != VoteStatus::ACCEPTED)
+            report.rejections.push_back({row, status[row]});
+    }
+
+    for (size_t g = 0; g < groups.size() && !accepted.empty(); g++)
+    {
+        size_t from = groupStart[g], n = groupStart[g + 1] - from;
+        if (n)
+            groups[g].first->publishBatch(candidateIds.data() + from, n, outcome.data() + from, tallyIds.data() + from);
+    }
+    // each id block written shard by shard
+    for (int s = 0; s < voteShardCount && !accepted.empty(); s++)
+    {
+        VoteShard &shard = voteShards[s];
+        lock_guard<mutex> guard(shard.lock);
+        shard.columns.reserve(shard.columns.size() + accepted.size() / voteShardCount + 1);
+        for (size_t blk = 0; blk < idBlocks.size(); blk++)
+        {
+            int firstId = idBlocks[blk].first;
+            size_t end = blk + 1 < idBlocks.size() ? idBlocks[blk + 1].second : accepted.size();
+            for (size_t a = idBlocks[blk].second + ((unsigned)(s - firstId) & (voteShardCount - 1)); a < end;
+                 a += voteShardCount)
+            {
+                const Ballot &b = ballots[rows[accepted[a]]];
+                shard.columns.append(voteIds[accepted[a]], b.electionId, b.voterId, b.candidateId);
+            }
+        }
+    }
+
+    report.accepted = (long long)accepted.size();
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+RosterReport VotingSystem::importRoster(const string &path)
+{
+    // A snapshot waits for at most one batch: the checkpoint is held per batch, and each
+    // batch is made durable before letting go, since a snapshot starts a new log.
+    const size_t batchRows = 4096;
+    const auto batchTime = chrono::milliseconds(50);
+
+    auto start = chrono::steady_clock::now();
+    RosterReport report;
+    shared_lock<shared_mutex> checkpoint(checkpointLock, defer_lock);
+    chrono::steady_clock::time_point batchStart;
+    size_t batchCount = 0;
+    uint64_t lastLsn = 0;
+    auto endBatch = [&]()
+    {
+        if (wal && lastLsn)
+            report.durable = wal->waitDurable(lastLsn) && report.durable;
+        lastLsn = 0;
+        batchCount = 0;
+        checkpoint.unlock();
+    };
+
+    report.readable = streamRosterFile(path, [&](const RosterRow &row)
+    {
+        if (!checkpoint.owns_lock())
+        {
+            checkpoint.lock();
+            batchStart = chrono::steady_clock::now();
+        }
+        bool added;
+        if (row.role == UserRole::CANDIDATE)
+            added = storeUser(candidatePool, Candidate(row.userId, string(row.username), string(row.email),
+                                                       string(row.password), string(row.profile), this),
+                              string(row.profile), &lastLsn);
+        else if (row.role == UserRole::ADMIN)
+            added = storeUser(adminPool, Admin(row.userId, string(row.username), string(row.email),
+                                               string(row.password), this),
+                              "", &lastLsn);
+        else
+            added = storeUser(voterPool, Voter(row.userId, string(row.username), string(row.email),
+                                               string(row.password), this),
+                              "", &lastLsn);
+        if (added)
+            report.added++;
+        else
+            report.duplicates.push_back(row.line);
+        if (++batchCount == batchRows || chrono::steady_clock::now() - batchStart >= batchTime)
+            endBatch();
+    }, report.malformed);
+
+    if (checkpoint.owns_lock())
+        endBatch();
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+/* ---------- Ballot files implementation ---------- */
+// Integer field of a CSV line, surrounding blanks allowed; advances p past it.
+static bool parseIntField(const char *&p, const char *end, int &out)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+'))
+        p++;
+    const char *digits = p;
+    int64_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && p - digits < 11)
+        value = value * 10 + (*p++ - '0');
+    if (p == digits || (p < end && *p >= '0' && *p <= '9'))
+        return false;
+    value = negative ? -value : value;
+    if (value < INT32_MIN || value > INT32_MAX)
+        return false;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    out = (int)value;
+    return true;
+}
+
+// Text field up to the next comma (or the end), blanks trimmed.
+static string_view parseTextField(const char *&p, const char *end)
+{
+    const char *stop = (const char *)memchr(p, ',', end - p);
+    if (!stop)
+        stop = end;
+    const char *first = p, *last = stop;
+    while (first < last && (*first == ' ' || *first == '\t'))
+        first++;
+    while (last > first && (last[-1] == ' ' || last[-1] == '\t'))
+        last--;
+    p = stop;
+    return string_view(first, last - first);
+}
+
+static bool isBlankLine(const char *p, const char *end)
+{
+    for (; p < end; p++)
+    {
+        if (*p != ' ' && *p != '\t')
+            return false;
+    }
+    return true;
+}
+
+// Calls onLine(begin, end, lineNo) for every line (no line break, no '\r'),
+// then onWindow() once the lines of each mapped window are done.
+template <class LineFn, class WindowFn>
+static bool forEachMappedLine(MappedStream &stream, LineFn onLine, WindowFn onWindow)
+{
+    uint64_t offset = 0;
+    size_t lineNo = 1;
+    while (offset < stream.size())
+    {
+        const char *data;
+        size_t length;
+        if (!stream.view(offset, data, length))
+            return false;
+        bool last = offset + length == stream.size();
+        const char *p = data, *end = data + length;
+        while (p < end)
+        {
+            const char *newline = (const char *)memchr(p, '\n', end - p);
+            if (!newline && !last)
+                break; // the line continues in the next window
+            const char *lineEnd = newline ? newline : end;
+            const char *textEnd = lineEnd > p && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+            onLine(p, textEnd, lineNo++);
+            p = newline ? newline + 1 : end;
+        }
+        if (p == data && !last)
+            return false; // one line longer than a whole window
+        offset += p - data;
+        onWindow();
+    }
+    return true;
+}
+
+bool streamBallotFile(const string &path,
+                      const function<void(const Ballot *, const size_t *, size_t)> &onBatch,
+                      vector<size_t> &malformed, size_t windowBytes)
+{
+    MappedStream stream(windowBytes);
+    if (!stream.open(path))
+        return false;
+
+    vector<Ballot> ballots;
+    vector<size_t> sources;
+    auto flush = [&]()
+    {
+        if (!ballots.empty())
+            onBatch(ballots.data(), sources.data(), ballots.size());
+        ballots.clear();
+        sources.clear();
+    };
+
+    const char *data;
+    size_t length;
+    bool binary = stream.size() >= sizeof(ballotFileMagic) && stream.view(0, data, length) &&
+                  memcmp(data, ballotFileMagic, sizeof(ballotFileMagic)) == 0;
+    if (binary)
+    {
+        const size_t recordBytes = 3 * sizeof(int32_t);
+        uint64_t offset = sizeof(ballotFileMagic);
+        size_t record = 1;
+        while (offset < stream.size())
+        {
+            if (!stream.view(offset, data, length))
+                return false;
+            size_t count = length / recordBytes;
+            if (count == 0)
+            {
+                malformed.push_back(record); // truncated tail
+                break;
+            }
+            for (size_t i = 0; i < count; i++, record++)
+            {
+                int32_t fields[3];
+                memcpy(fields, data + i * recordBytes, recordBytes);
+                ballots.push_back({fields[0], fields[1], fields[2]});
+                sources.push_back(record);
+            }
+            offset += count * recordBytes;
+            flush();
+        }
+        return true;
+    }
+
+    bool ok = forEachMappedLine(stream, [&](const char *p, const char *end, size_t lineNo)
+    {
+        if (isBlankLine(p, end))
+            return;
+        Ballot b;
+        if (parseIntField(p, end, b.electionId) && p < end && *p++ == ',' &&
+            parseIntField(p, end, b.voterId) && p < end && *p++ == ',' &&
+            parseIntField(p, end, b.candidateId) && p == end)
+        {
+            ballots.push_back(b);
+            sources.push_back(lineNo);
+        }
+        else if (lineNo != 1) // the first line may be a header
+            malformed.push_back(lineNo);
+    }, flush);
+    flush();
+    return ok;
+}
+
+bool readBallotFile(const string &path, BallotFile &out)
+{
+    return streamBallotFile(path, [&](const Ballot *ballots, const size_t *sources, size_t n)
+    {
+        out.ballots.insert(out.ballots.end(), ballots, ballots + n);
+        out.sources.insert(out.sources.end(), sources, sources + n);
+    }, out.malformed);
+}
+
+bool streamRosterFile(const string &path, const function<void(const RosterRow &)> &onRow,
+                      vector<size_t> &malformed, size_t windowBytes)
+{
+    MappedStream stream(windowBytes);
+    if (!stream.open(path))
+        return false;
+    return forEachMappedLine(stream, [&](const char *p, const char *end, size_t lineNo)
+    {
+        if (isBlankLine(p, end))
+            return;
+        RosterRow row;
+        row.line = lineNo;
+        string_view role = parseTextField(p, end);
+        bool ok = true;
+        if (role == "Voter")
+            row.role = UserRole::VOTER;
+        else if (role == "Candidate")
+            row.role = UserRole::CANDIDATE;
+        else if (role == "Admin")
+            row.role = UserRole::ADMIN;
+        else
+            ok = false;
+        ok = ok && p < end && *p++ == ',' && parseIntField(p, end, row.userId) && p < end && *p++ == ',';
+        if (ok)
+        {
+            row.username = parseTextField(p, end);
+            ok = p < end && *p++ == ',';
+        }
+        if (ok)
+        {
+            row.email = parseTextField(p, end);
+            ok = p < end && *p++ == ',';
+        }
+        if (ok)
+        {
+            row.password = parseTextField(p, end);
+            row.profile = p < end && *p++ == ',' ? parseTextField(p, end) : string_view();
+            ok = p == end && !row.username.empty() && !row.email.empty() && !row.password.empty();
+        }
+        if (ok)
+            onRow(row);
+        else if (lineNo != 1) // the first line may be a header
+            malformed.push_back(lineNo);
+    }, []() {});
+}
+
+bool writeBallotFile(const string &path, const vector<Ballot> &ballots, bool binary)
+{
+    ofstream outFile(path, ios::binary | ios::trunc);
+    if (!outFile)
+        return false;
+    if (binary)
+    {
+        outFile.write(ballotFileMagic, sizeof(ballotFileMagic));
+        for (const Ballot &b : ballots)
+        {
+            int32_t fields[3] = {b.electionId, b.voterId, b.candidateId};
+            outFile.write((const char *)fields, sizeof(fields));
+        }
+    }
+    else
+    {
+        outFile << "electionId,voterId,candidateId\n";
+        for (const Ballot &b : ballots)
+            outFile << b.electionId << ',' << b.voterId << ',' << b.candidateId << '\n';
+    }
+    return (bool)outFile;
+}
+
+/* ---------- ThreadPool implementation ---------- */
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = max(1u, thread::hardware_concurrency());
+    for (int w = 0; w < threadCount; w++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, w);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread &w : workers)
+        w.join();
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+    uint64_t seen = 0;
+    unique_lock<mutex> guard(lock);
+    while (true)
+    {
+        wake.wait(guard, [&]()
+                  { return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+        const function<void(size_t, int)> *fn = job;
+        size_t tasks = taskCount;
+        guard.unlock();
+
+        for (size_t task = nextTask.fetch_add(1); task < tasks; task = nextTask.fetch_add(1))
+            (*fn)(task, worker);
+
+        guard.lock();
+        if (--busy == 0)
+            done.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(size_t tasks, const function<void(size_t, int)> &fn)
+{
+    if (tasks == 0)
+        return;
+    lock_guard<mutex> call(callLock);
+    unique_lock<mutex> guard(lock);
+    job = &fn;
+    taskCount = tasks;
+    nextTask = 0;
+    busy = (int)workers.size();
+    generation++;
+    wake.notify_all();
+    done.wait(guard, [&]()
+              { return busy == 0; });
+    job = nullptr;
+}
+
+/* ---------- Metrics implementation ---------- */
+const char *metricName(Metric metric)
+{
+    switch (metric)
+    {
+    case Metric::VOTE:
+        return "vote";
+    case Metric::LOGIN:
+        return "login";
+    case Metric::OPEN_ELECTION:
+        return "open_election";
+    case Metric::CLOSE_ELECTION:
+        return "close_election";
+    case Metric::RESULTS:
+        return "results";
+    default:
+        return "vote_count";
+    }
+}
+
+int LatencyHistogram::bucketOf(uint64_t nanos)
+{
+    if (nanos < (uint64_t)subBuckets)
+        return (int)nanos;
+    if (nanos >> 40)
+        return bucketCount - 1;
+    int exponent = 63 - __builtin_clzll(nanos);
+    return (exponent - 3) * subBuckets + (int)((nanos >> (exponent - 4)) & (subBuckets - 1));
+}
+
+uint64_t LatencyHistogram::bucketValue(int bucket)
+{
+    if (bucket < subBuckets)
+        return (uint64_t)bucket;
+    int shift = bucket / subBuckets - 1;
+    uint64_t low = (uint64_t)(subBuckets + bucket % subBuckets) << shift;
+    return low + ((uint64_t)1 << shift) / 2;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (int b = 0; b < bucketCount; b++)
+        buckets[b] += other.buckets[b];
+    count += other.count;
+    failed += other.failed;
+    totalNanos += other.totalNanos;
+    maxNanos = max(maxNanos, other.maxNanos);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    if (count == 0)
+        return 0;
+    uint64_t rank = max<uint64_t>(1, (uint64_t)ceil(fraction * count)), seen = 0;
+    for (int b = 0; b < bucketCount; b++)
+    {
+        seen += buckets[b];
+        if (seen >= rank)
+            return min(bucketValue(b), maxNanos);
+    }
+    return maxNanos;
+}
+
+#if VS_METRICS
+// One thread's counters. Only the owning thread writes them, so a plain load and
+// store is enough; the atomics are there for the readers merging concurrently.
+struct MetricsBlock
+{
+    struct Cells
+    {
+        atomic<uint64_t> buckets[LatencyHistogram::bucketCount];
+        atomic<uint64_t> failed;
+        atomic<uint64_t> totalNanos;
+        atomic<uint64_t> maxNanos;
+    };
+    Cells cells[(int)Metric::COUNT];
+
+    MetricsBlock() { clear(); }
+
+    void clear()
+    {
+        for (Cells &c : cells)
+        {
+            for (auto &bucket : c.buckets)
+                bucket.store(0, memory_order_relaxed);
+            c.failed.store(0, memory_order_relaxed);
+            c.totalNanos.store(0, memory_order_relaxed);
+            c.maxNanos.store(0, memory_order_relaxed);
+        }
+    }
+
+    void addTo(vector<LatencyHistogram> &out) const
+    {
+        for (int m = 0; m < (int)Metric::COUNT; m++)
+        {
+            const Cells &c = cells[m];
+            LatencyHistogram &h = out[m];
+            for (int b = 0; b < LatencyHistogram::bucketCount; b++)
+            {
+                uint64_t n = c.buckets[b].load(memory_order_relaxed);
+                h.buckets[b] += n;
+                h.count += n;
+            }
+            h.failed += c.failed.load(memory_order_relaxed);
+            h.totalNanos += c.totalNanos.load(memory_order_relaxed);
+            h.maxNanos = max(h.maxNanos, c.maxNanos.load(memory_order_relaxed));
+        }
+    }
+};
+
+struct MetricsRegistry
+{
+    mutex lock;
+    vector<MetricsBlock *> live;
+    vector<LatencyHistogram> retired = vector<LatencyHistogram>((size_t)Metric::COUNT); // exited threads
+};
+
+static MetricsRegistry &metricsRegistry()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+static thread_local MetricsBlock *threadMetrics = nullptr;
+
+// Hands the block back when its thread exits: the counts move to the registry's retired totals.
+struct MetricsThreadSlot
+{
+    unique_ptr<MetricsBlock> block = make_unique<MetricsBlock>();
+
+    MetricsThreadSlot()
+    {
+        MetricsRegistry &registry = metricsRegistry();
+        lock_guard<mutex> guard(registry.lock);
+        registry.live.push_back(block.get());
+    }
+
+    ~MetricsThreadSlot()
+    {
+        MetricsRegistry &registry = metricsRegistry();
+        lock_guard<mutex> guard(registry.lock);
+        block->addTo(registry.retired);
+        registry.live.erase(find(registry.live.begin(), registry.live.end(), block.get()));
+        threadMetrics = nullptr;
+    }
+};
+
+static MetricsBlock *registerMetricsThread()
+{
+    static thread_local MetricsThreadSlot slot;
+    return slot.block.get();
+}
+
+static inline void bump(atomic<uint64_t> &cell, uint64_t by)
+{
+    cell.store(cell.load(memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+void recordMetric(Metric metric, uint64_t nanos, bool ok)
+{
+    if (!threadMetrics)
+        threadMetrics = registerMetricsThread();
+    MetricsBlock::Cells &c = threadMetrics->cells[(int)metric];
+    bump(c.buckets[LatencyHistogram::bucketOf(nanos)], 1);
+    bump(c.totalNanos, nanos);
+    if (!ok)
+        bump(c.failed, 1);
+    if (nanos > c.maxNanos.load(memory_order_relaxed))
+        c.maxNanos.store(nanos, memory_order_relaxed);
+}
+
+vector<LatencyHistogram> collectMetrics()
+{
+    MetricsRegistry &registry = metricsRegistry();
+    lock_guard<mutex> guard(registry.lock);
+    vector<LatencyHistogram> out = registry.retired;
+    for (const MetricsBlock *block : registry.live)
+        block->addTo(out);
+    return out;
+}
+
+void resetMetrics()
+{
+    MetricsRegistry &registry = metricsRegistry();
+    lock_guard<mutex> guard(registry.lock);
+    registry.retired.assign((size_t)Metric::COUNT, LatencyHistogram());
+    for (MetricsBlock *block : registry.live)
+        block->clear();
+}
+#else
+void recordMetric(Metric, uint64_t, bool) {}
+
+vector<LatencyHistogram> collectMetrics()
+{
+    return vector<LatencyHistogram>((size_t)Metric::COUNT);
+}
+
+void resetMetrics() {}
+#endif
+
+void writeMetrics(ostream &out)
+{
+    if (!VS_METRICS)
+    {
+        out << "metrics are compiled out of this build (VS_METRICS=0)\n";
+        return;
+    }
+    vector<LatencyHistogram> metrics = collectMetrics();
+    for (int m = 0; m < (int)Metric::COUNT; m++)
+    {
+        const LatencyHistogram &h = metrics[m];
+        if (h.count == 0)
+            continue;
+        out << metricName((Metric)m) << ": " << h.count << " calls, " << h.failed << " failed, mean "
+            << h.totalNanos / 1000.0 / h.count << " us, p50 " << h.percentile(0.5) / 1000.0 << " us, p90 "
+            << h.percentile(0.9) / 1000.0 << " us, p99 " << h.percentile(0.99) / 1000.0 << " us, p99.9 "
+            << h.percentile(0.999) / 1000.0 << " us, max " << h.maxNanos / 1000.0 << " us\n";
+    }
+}
+
+bool exportMetrics(const string &path)
+{
+    ofstream out(path);
+    if (!out)
+        return false;
+    vector<LatencyHistogram> metrics = collectMetrics();
+    for (int m = 0; m < (int)Metric::COUNT; m++)
+    {
+        const LatencyHistogram &h = metrics[m];
+        out << "{\"metric\":\"" << metricName((Metric)m) << "\",\"count\":" << h.count << ",\"failed\":" << h.failed
+            << ",\"mean_us\":" << (h.count ? h.totalNanos / 1000.0 / h.count : 0) << ",\"p50_us\":"
+            << h.percentile(0.5) / 1000.0 << ",\"p90_us\":" << h.percentile(0.9) / 1000.0 << ",\"p99_us\":"
+            << h.percentile(0.99) / 1000.0 << ",\"p999_us\":" << h.percentile(0.999) / 1000.0
+            << ",\"max_us\":" << h.maxNanos / 1000.0 << ",\"enabled\":" << (VS_METRICS ? "true" : "false") << "}\n";
+    }
+    return (bool)out;
+}
+
+/* ---------- Recount kernels implementation ---------- */
+static void recountScalar(const int *electionIds, const int *candidateIds, size_t count,
+                          int electionId, const vector<int> &candidates, long long *counts)
+{
+    // few candidates: a short linear probe beats hashing
+    const int candidateCount = (int)candidates.size();
+    unordered_map<int, int> slotOf;
+    if (candidateCount > 16)
+    {
+        for (int k = 0; k < candidateCount; k++)
+            slotOf[candidates[k]] = k;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (electionIds[i] != electionId)
+            continue;
+        if (candidateCount > 16)
+        {
+            auto it = slotOf.find(candidateIds[i]);
+            if (it != slotOf.end())
+                counts[it->second]++;
+            continue;
+        }
+        for (int k = 0; k < candidateCount; k++)
+        {
+            if (candidates[k] == candidateIds[i])
+            {
+                counts[k]++;
+                break;
+            }
+        }
+    }
+}
+
+#ifdef VS_X86_SIMD
+static const int maxSimdCandidates = 32;
+static const size_t simdBlock = size_t(1) << 28; // flush 32-bit lane counters well before overflow
+
+__attribute__((target("sse2"))) static void recountSse2(const int *electionIds, const int *candidateIds, size_t count,
+                                                        int electionId, const vector<int> &candidates, long long *counts)
+{
+    const int candidateCount = (int)candidates.size();
+    const __m128i election = _mm_set1_epi32(electionId);
+    __m128i want[maxSimdCandidates];
+    for (int k = 0; k < candidateCount; k++)
+        want[k] = _mm_set1_epi32(candidates[k]);
+
+    size_t i = 0;
+    while (i + 4 <= count)
+    {
+        size_t blockEnd = min(count, i + simdBlock);
+        __m128i acc[maxSimdCandidates];
+        for (int k = 0; k < candidateCount; k++)
+            acc[k] = _mm_setzero_si128();
+
+        for (; i + 4 <= blockEnd; i += 4)
+        {
+            __m128i inElection = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(electionIds + i)), election);
+            __m128i candidate = _mm_loadu_si128((const __m128i *)(candidateIds + i));
+            // a match is all ones (-1), so subtracting it counts up
+            for (int k = 0; k < candidateCount; k++)
+                acc[k] = _mm_sub_epi32(acc[k], _mm_and_si128(_mm_cmpeq_epi32(candidate, want[k]), inElection));
+        }
+
+        for (int k = 0; k < candidateCount; k++)
+        {
+            alignas(16) uint32_t lanes[4];
+            _mm_store_si128((__m128i *)lanes, acc[k]);
+            counts[k] += (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+    }
+    recountScalar(electionIds + i, candidateIds + i, count - i, electionId, candidates, counts);
+}
+
+__attribute__((target("avx2"))) static void recountAvx2(const int *electionIds, const int *candidateIds, size_t count,
+                                                        int electionId, const vector<int> &candidates, long long *counts)
+{
+    const int candidateCount = (int)candidates.size();
+    const __m256i election = _mm256_set1_epi32(electionId);
+    __m256i want[maxSimdCandidates];
+    for (int k = 0; k < candidateCount; k++)
+        want[k] = _mm256_set1_epi32(candidates[k]);
+
+    size_t i = 0;
+    while (i + 8 <= count)
+    {
+        size_t blockEnd = min(count, i + simdBlock);
+        __m256i acc[maxSimdCandidates];
+        for (int k = 0; k < candidateCount; k++)
+            acc[k] = _mm256_setzero_si256();
+
+        for (; i + 8 <= blockEnd; i += 8)
+        {
+            __m256i inElection = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(electionIds + i)), election);
+            // skip the candidate compares when none of the 8 ballots is in this election
+            if (_mm256_testz_si256(inElection, inElection))
+                continue;
+            __m256i candidate = _mm256_loadu_si256((const __m256i *)(candidateIds + i));
+            for (int k = 0; k < candidateCount; k++)
+                acc[k] = _mm256_sub_epi32(acc[k], _mm256_and_si256(_mm256_cmpeq_epi32(candidate, want[k]), inElection));
+        }
+
+        for (int k = 0; k < candidateCount; k++)
+        {
+            alignas(32) uint32_t lanes[8];
+            _mm256_store_si256((__m256i *)lanes, acc[k]);
+            long long sum = 0;
+            for (uint32_t lane : lanes)
+                sum += lane;
+            counts[k] += sum;
+        }
+    }
+    recountScalar(electionIds + i, candidateIds + i, count - i, electionId, candidates, counts);
+}
+#endif
+
+RecountKernel bestRecountKernel()
+{
+#ifdef VS_X86_SIMD
+    static const RecountKernel best = []()
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return RecountKernel::AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return RecountKernel::SSE2;
+        return RecountKernel::SCALAR;
+    }();
+    return best;
+#else
+    return RecountKernel::SCALAR;
+#endif
+}
+
+const char *recountKernelName(RecountKernel kernel)
+{
+    switch (kernel)
+    {
+    case RecountKernel::SSE2:
+        return "sse2";
+    case RecountKernel::AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+void recountColumns(RecountKernel kernel, const int *electionIds, const int *candidateIds,
+                    size_t count, int electionId, const vector<int> &candidates,
+                    long long *counts)
+{
+#ifdef VS_X86_SIMD
+    if ((int)candidates.size() <= maxSimdCandidates)
+    {
+        if (kernel == RecountKernel::AVX2)
+            return recountAvx2(electionIds, candidateIds, count, electionId, candidates, counts);
+        if (kernel == RecountKernel::SSE2)
+            return recountSse2(electionIds, candidateIds, count, electionId, candidates, counts);
+    }
+#else
+    (void)kernel;
+#endif
+    recountScalar(electionIds, candidateIds, count, electionId, candidates, counts);
+}
+
+/* ---------- Credentials implementation ---------- */
+struct Sha256
+{
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    uint8_t block[64];
+    size_t used = 0;
+    uint64_t length = 0; // bytes hashed so far
+
+    void compress(const uint8_t *chunk);
+    void update(const void *data, size_t size);
+    void finish(uint8_t digest[32]);
+};
+
+static const uint32_t sha256Rounds[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+void Sha256::compress(const uint8_t *chunk)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)chunk[4 * i] << 24 | (uint32_t)chunk[4 * i + 1] << 16 |
+               (uint32_t)chunk[4 * i + 2] << 8 | chunk[4 * i + 3];
+    for (int i = 16; i < 64; i++)
+        w[i] = w[i - 16] + (rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 7] +
+               (rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10));
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256Rounds[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void Sha256::update(const void *data, size_t size)
+{
+    const uint8_t *in = (const uint8_t *)data;
+    length += size;
+    while (size > 0)
+    {
+        if (used == 0 && size >= 64)
+        {
+            compress(in);
+            in += 64;
+            size -= 64;
+            continue;
+        }
+        size_t n = min(size, 64 - used);
+        memcpy(block + used, in, n);
+        used += n;
+        in += n;
+        size -= n;
+        if (used == 64)
+        {
+            compress(block);
+            used = 0;
+        }
+    }
+}
+
+void Sha256::finish(uint8_t digest[32])
+{
+    uint64_t bits = length * 8;
+    uint8_t pad[72] = {0x80};
+    size_t padSize = (used < 56 ? 56 : 120) - used;
+    for (int i = 0; i < 8; i++)
+        pad[padSize + i] = (uint8_t)(bits >> (56 - 8 * i));
+    update(pad, padSize + 8);
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 4; j++)
+            digest[4 * i + j] = (uint8_t)(state[i] >> (24 - 8 * j));
+}
+
+// One 32-byte PBKDF2 block. The keyed inner and outer HMAC states are
+// computed once, so each iteration costs exactly two compressions.
+static void pbkdf2Sha256(string_view password, const uint8_t *salt, size_t saltSize, uint32_t iterations,
+                         uint8_t out[32])
+{
+    uint8_t key[64] = {};
+    if (password.size() > 64)
+    {
+        Sha256 keyHash;
+        keyHash.update(password.data(), password.size());
+        keyHash.finish(key);
+    }
+    else
+        memcpy(key, password.data(), password.size());
+
+    uint8_t pad[64];
+    Sha256 inner, outer;
+    for (int i = 0; i < 64; i++)
+        pad[i] = key[i] ^ 0x36;
+    inner.update(pad, 64);
+    for (int i = 0; i < 64; i++)
+        pad[i] = key[i] ^ 0x5c;
+    outer.update(pad, 64);
+
+    auto hmac = [&](const uint8_t *message, size_t size, const uint8_t *suffix, size_t suffixSize,
+                    uint8_t result[32])
+    {
+        Sha256 h = inner;
+        h.update(message, size);
+        h.update(suffix, suffixSize);
+        h.finish(result);
+        h = outer;
+        h.update(result, 32);
+        h.finish(result);
+    };
+
+    static const uint8_t blockIndex[4] = {0, 0, 0, 1};
+    uint8_t u[32];
+    hmac(salt, saltSize, blockIndex, 4, u);
+    memcpy(out, u, 32);
+    for (uint32_t i = 1; i < iterations; i++)
+    {
+        hmac(u, 32, nullptr, 0, u);
+        for (int j = 0; j < 32; j++)
+            out[j] ^= u[j];
+    }
+}
+
+// SHA-256 over a per-thread random seed and a counter: cheap, and as hard
+// to predict as the seed, which comes from the OS.
+static void secureRandomBytes(uint8_t *out, size_t size)
+{
+    struct Generator
+    {
+        uint8_t seed[32];
+        uint64_t counter = 0;
+        Generator()
+        {
+            random_device device;
+            for (int i = 0; i < 32; i += 4)
+            {
+                uint32_t word = device();
+                memcpy(seed + i, &word, 4);
+            }
+        }
+    };
+    thread_local Generator generator;
+    while (size > 0)
+    {
+        uint8_t block[32];
+        Sha256 h;
+        h.update(generator.seed, sizeof(generator.seed));
+        h.update(&generator.counter, sizeof(generator.counter));
+        generator.counter++;
+        h.finish(block);
+        size_t n = min(size, sizeof(block));
+        memcpy(out, block, n);
+        out += n;
+        size -= n;
+    }
+}
+
+static void appendHex(string &out, const uint8_t *bytes, size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; i++)
+    {
+        out += digits[bytes[i] >> 4];
+        out += digits[bytes[i] & 15];
+    }
+}
+
+static bool parseHex(string_view text, uint8_t *bytes, size_t size)
+{
+    if (text.size() != size * 2)
+        return false;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        char c = text[i];
+        int nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (nibble < 0)
+            return false;
+        if (i % 2 == 0)
+            bytes[i / 2] = (uint8_t)(nibble << 4);
+        else
+            bytes[i / 2] |= (uint8_t)nibble;
+    }
+    return true;
+}
+
+PasswordHash PasswordHash::create(string_view password, uint32_t cost)
+{
+    PasswordHash hash;
+    hash.cost = max(cost, 1u);
+    secureRandomBytes(hash.salt, sizeof(hash.salt));
+    pbkdf2Sha256(password, hash.salt, sizeof(hash.salt), hash.cost, hash.digest);
+    return hash;
+}
+
+bool PasswordHash::matches(string_view password) const
+{
+    uint8_t attempt[32];
+    pbkdf2Sha256(password, salt, sizeof(salt), cost, attempt);
+    uint8_t difference = 0;
+    for (int i = 0; i < 32; i++)
+        difference |= attempt[i] ^ digest[i];
+    return difference == 0;
+}
+
+string PasswordHash::encode() const
+{
+    if (!isSet())
+        return "";
+    string out = "pbkdf2-sha256$" + to_string(cost) + "$";
+    appendHex(out, salt, sizeof(salt));
+    out += '$';
+    appendHex(out, digest, sizeof(digest));
+    return out;
+}
+
+bool PasswordHash::decode(string_view text, PasswordHash &out)
+{
+    static const string_view prefix = "pbkdf2-sha256$";
+    if (text.substr(0, prefix.size()) != prefix)
+        return false;
+    text.remove_prefix(prefix.size());
+    size_t costEnd = text.find('$');
+    if (costEnd == string_view::npos)
+        return false;
+    uint32_t cost = 0;
+    auto parsed = from_chars(text.data(), text.data() + costEnd, cost);
+    if (parsed.ec != errc() || parsed.ptr != text.data() + costEnd || cost == 0)
+        return false;
+    text.remove_prefix(costEnd + 1);
+    size_t saltEnd = text.find('$');
+    PasswordHash hash;
+    hash.cost = cost;
+    if (saltEnd == string_view::npos || !parseHex(text.substr(0, saltEnd), hash.salt, sizeof(hash.salt)) ||
+        !parseHex(text.substr(saltEnd + 1), hash.digest, sizeof(hash.digest)))
+        return false;
+    out = hash;
+    return true;
+}
+
+string SessionToken::toString() const
+{
+    uint8_t bytes[16];
+    for (int i = 0; i < 8; i++)
+    {
+        bytes[i] = (uint8_t)(high >> (56 - 8 * i));
+        bytes[8 + i] = (uint8_t)(low >> (56 - 8 * i));
+    }
+    string out;
+    appendHex(out, bytes, sizeof(bytes));
+    return out;
+}
+
+bool SessionToken::parse(string_view text, SessionToken &out)
+{
+    uint8_t bytes[16];
+    if (!parseHex(text, bytes, sizeof(bytes)))
+        return false;
+    out = SessionToken();
+    for (int i = 0; i < 8; i++)
+    {
+        out.high = out.high << 8 | bytes[i];
+        out.low = out.low << 8 | bytes[8 + i];
+    }
+    return true;
+}
+
+/* ---------- SessionTable implementation ---------- */
+SessionToken SessionTable::issue(User *user)
+{
+    SessionToken token;
+    do
+        secureRandomBytes((uint8_t *)&token, sizeof(token));
+    while (token.empty());
+
+    auto now = chrono::steady_clock::now();
+    Shard &shard = shardFor(token);
+    unique_lock<shared_mutex> guard(shard.lock);
+    if (++shard.issued % sweepEvery == 0)
+    {
+        for (auto it = shard.sessions.begin(); it != shard.sessions.end();)
+            it = it->second.expires <= now ? shard.sessions.erase(it) : next(it);
+    }
+    shard.sessions[token] = {user, now + chrono::milliseconds(lifetimeMs.load())};
+    return token;
+}
+
+User *SessionTable::resolve(const SessionToken &token) const
+{
+    const Shard &shard = shardFor(token);
+    shared_lock<shared_mutex> guard(shard.lock);
+    auto it = shard.sessions.find(token);
+    if (it == shard.sessions.end() || it->second.expires <= chrono::steady_clock::now())
+        return nullptr;
+    return it->second.user;
+}
+
+bool SessionTable::revoke(const SessionToken &token)
+{
+    Shard &shard = shardFor(token);
+    unique_lock<shared_mutex> guard(shard.lock);
+    return shard.sessions.erase(token) > 0;
+}
+
+size_t SessionTable::size() const
+{
+    size_t total = 0;
+    for (const Shard &shard : shards)
+    {
+        shared_lock<shared_mutex> guard(shard.lock);
+        total += shard.sessions.size();
+    }
+    return total;
+}
+
+/* ---------- WriteAheadLog implementation ---------- */
+static uint32_t crc32(const char *data, size_t size)
+{
+    static const vector<uint32_t> table = []()
+    {
+        vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void putUint32(string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out += (char)((value >> (8 * i)) & 0xFF);
+}
+
+static uint32_t getUint32(const unsigned char *in)
+{
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+long long WriteAheadLog::replay(const string &path, const function<void(LogRecord &)> &apply)
+{
+    FILE *in = fopen(path.c_str(), "rb");
+    if (!in)
+        return 0;
+
+    long long count = 0;
+    long long goodBytes = 0;
+    string body;
+    unsigned char header[8];
+    while (fread(header, 1, 8, in) == 8)
+    {
+        uint32_t size = getUint32(header);
+        uint32_t crc = getUint32(header + 4);
+        if (size == 0 || size > (64u << 20))
+            break;
+        body.resize(size);
+        if (fread(&body[0], 1, size, in) != size || crc32(body.data(), size) != crc)
+            break; // torn write from a crash
+
+        LogRecord record((LogRecordType)(uint8_t)body[0]);
+        record.payload = body.substr(1);
+        apply(record);
+        count++;
+        goodBytes += 8 + size;
+    }
+    fclose(in);
+
+    // drop the broken tail so new records don't end up behind garbage
+    error_code ec;
+    if ((long long)filesystem::file_size(path, ec) > goodBytes && !ec)
+        filesystem::resize_file(path, goodBytes, ec);
+    return count;
+}
+
+bool WriteAheadLog::open(const string &path, int generation)
+{
+    close();
+    file = fopen(path.c_str(), "ab");
+    if (!file)
+        return false;
+
+    error_code ec;
+    if (filesystem::file_size(path, ec) == 0 && !ec)
+    {
+        LogRecord header(LogRecordType::LOG_HEADER);
+        header.putInt(generation);
+        return waitDurable(append(header));
+    }
+    return true;
+}
+
+bool WriteAheadLog::reset(const string &path, int generation)
+{
+    close();
+    // a crash right here leaves an empty or headerless log, which the
+    // snapshot already covers, so nothing is lost
+    FILE *fresh = fopen(path.c_str(), "wb");
+    if (!fresh)
+        return false;
+    fclose(fresh);
+    return open(path, generation);
+}
+
+void WriteAheadLog::close()
+{
+    if (!file)
+        return;
+    waitDurable(getRecordCount());
+    fclose(file);
+    file = nullptr;
+}
+
+uint64_t WriteAheadLog::append(const LogRecord &record)
+{
+    string body;
+    body.reserve(1 + record.payload.size());
+    body += (char)record.type;
+    body += record.payload;
+
+    lock_guard<mutex> guard(lock);
+    putUint32(pending, (uint32_t)body.size());
+    putUint32(pending, crc32(body.data(), body.size()));
+    pending += body;
+    return ++appendedLsn;
+}
+
+bool WriteAheadLog::waitDurable(uint64_t lsn)
+{
+    unique_lock<mutex> guard(lock);
+    while (durableLsn < lsn && !failed)
+    {
+        if (flushing)
+        {
+            // someone else is syncing; our record rides along with the next batch
+            flushed.wait(guard);
+            continue;
+        }
+
+        // become the leader: take everything buffered and sync it in one go
+        flushing = true;
+        string batch;
+        batch.swap(pending);
+        uint64_t batchLsn = appendedLsn;
+        guard.unlock();
+
+        bool ok = fwrite(batch.data(), 1, batch.size(), file) == batch.size() &&
+                  fflush(file) == 0 &&
+                  fsync(fileno(file)) == 0;
+
+        guard.lock();
+        flushing = false;
+        fsyncCount++;
+        if (ok)
+            durableLsn = batchLsn;
+        else
+            failed = true;
+        flushed.notify_all();
+    }
+    return durableLsn >= lsn;
+}
+
+bool VotingSystem::commitChange(const LogRecord &record)
+{
+    return awaitChange(logChange(record));
+}
+
+uint64_t VotingSystem::logChange(const LogRecord &record)
+{
+    return wal ? wal->append(record) : 0;
+}
+
+bool VotingSystem::awaitChange(uint64_t lsn)
+{
+    return !wal || wal->waitDurable(lsn);
+}
+
+bool VotingSystem::syncLog()
+{
+    shared_lock<shared_mutex> checkpoint(checkpointLock);
+    return !wal || wal->waitDurable(wal->getRecordCount());
+}
+
+void VotingSystem::applyLogRecord(LogRecord &record)
+{
+    int a = 0, b = 0, c = 0, d = 0;
+    string role, name, mail, pass, profile;
+    switch (record.type)
+    {
+    case LogRecordType::LOG_HEADER:
+        break; // read by openLog
+    case LogRecordType::USER_ADD:
+        if (record.getString(role) && record.getInt(a) && record.getString(name) &&
+            record.getString(mail) && record.getString(pass) && record.getString(profile))
+        {
+            if (role == "Candidate")
+                addUser(withStoredCredential(Candidate(a, name, mail, pass, profile, this)));
+            else if (role == "Admin")
+                addUser(withStoredCredential(Admin(a, name, mail, pass, this)));
+            else
+                addUser(withStoredCredential(Voter(a, name, mail, pass, this)));
+        }
+        break;
+    case LogRecordType::ELECTION_CREATE:
+        if (record.getInt(a) && record.getString(name) && record.getString(profile))
+            addElection(a, name, profile);
+        break;
+    case LogRecordType::ELECTION_UPDATE:
+        if (record.getInt(a) && record.getString(name) && record.getString(profile))
+            updateElection(a, name, profile);
+        break;
+    case LogRecordType::ELECTION_OPEN:
+        if (record.getInt(a))
+            openElection(a);
+        break;
+    case LogRecordType::ELECTION_CLOSE:
+        if (record.getInt(a))
+            closeElection(a);
+        break;
+    case LogRecordType::CANDIDATE_ADD:
+        if (record.getInt(a) && record.getInt(b))
+            addCandidateToElection(a, b);
+        break;
+    case LogRecordType::CANDIDATE_REMOVE:
+        if (record.getInt(a) && record.getInt(b))
+            removeCandidateFromElection(a, b);
+        break;
+    case LogRecordType::VOTE:
+        if (record.getInt(a) && record.getInt(b) && record.getInt(c) && record.getInt(d))
+            addVote(Vote(a, b, c, d));
+        break;
+    case LogRecordType::RANKED_VOTE:
+    {
+        int length = 0;
+        if (!record.getInt(a) || !record.getInt(b) || !record.getInt(c) || !record.getInt(d) ||
+            !record.getInt(length) || length <= 0 || (size_t)length > record.payload.size() / 4)
+            break;
+        vector<int> ranking(length);
+        bool complete = true;
+        for (int &candidate : ranking)
+            complete = complete && record.getInt(candidate);
+        if (complete)
+            addRankedVote(Vote(a, b, c, d), ranking);
+        break;
+    }
+    }
+}
+
+bool VotingSystem::openLog(const string &path, const string &snapshotFile)
+{
+    {
+        // the snapshotter reads wal under the checkpoint lock
+        unique_lock<shared_mutex> checkpoint(checkpointLock);
+        wal.reset(); // nothing gets logged while replaying
+    }
+    logPath = path;
+    snapshotPath = snapshotFile;
+    startupStats = StartupStats();
+
+    auto t0 = chrono::steady_clock::now();
+    int snapshotGeneration = -1;
+    bool haveSnapshot = !snapshotPath.empty() && loadSnapshot(snapshotPath, snapshotGeneration);
+    auto t1 = chrono::steady_clock::now();
+
+    // logs from before snapshots existed have no header and count as generation 0
+    int fileGeneration = 0;
+    long long replayed = WriteAheadLog::replay(path, [&](LogRecord &r)
+    {
+        if (r.type == LogRecordType::LOG_HEADER)
+            r.getInt(fileGeneration);
+        else if (!haveSnapshot || fileGeneration > snapshotGeneration)
+        {
+            applyLogRecord(r);
+            startupStats.replayedRecords++;
+        }
+    });
+    auto t2 = chrono::steady_clock::now();
+    startupStats.snapshotMs = chrono::duration<double, milli>(t1 - t0).count();
+    startupStats.replayMs = chrono::duration<double, milli>(t2 - t1).count();
+
+    unique_ptr<WriteAheadLog> log(new WriteAheadLog());
+    bool opened;
+    if (haveSnapshot && fileGeneration <= snapshotGeneration)
+    {
+        // the crash came after the snapshot but before the log was swapped
+        logGeneration = snapshotGeneration + 1;
+        opened = log->reset(path, logGeneration);
+    }
+    else
+    {
+        logGeneration = fileGeneration;
+        opened = log->open(path, logGeneration);
+    }
+    if (!opened)
+    {
+        cout << "Could not open vote log " << path << ".\n";
+        log.reset();
+    }
+
+    unique_lock<shared_mutex> checkpoint(checkpointLock);
+    wal = move(log);
+    recordsAtSnapshot = wal ? wal->getRecordCount() : 0;
+    return haveSnapshot || replayed > 0;
+}
+
+/* ---------- Snapshot implementation ---------- */
+bool MappedFile::open(const string &path)
+{
+    close();
+#ifdef _WIN32
+    FILE *in = fopen(path.c_str(), "rb");
+    if (!in)
+        return false;
+    fseek(in, 0, SEEK_END);
+    buffer.resize(ftell(in));
+    fseek(in, 0, SEEK_SET);
+    bool ok = buffer.empty() || fread(&buffer[0], 1, buffer.size(), in) == buffer.size();
+    fclose(in);
+    data = buffer.data();
+    size = buffer.size();
+    return ok;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (mapped == MAP_FAILED)
+        return false;
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+    data = (const char *)mapped;
+    size = st.st_size;
+    return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    buffer.clear();
+#else
+    if (data)
+        munmap((void *)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool MappedStream::open(const string &path)
+{
+    close();
+#ifdef _WIN32
+    file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    _fseeki64(file, 0, SEEK_END);
+    fileSize = _ftelli64(file);
+    return true;
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close();
+        return false;
+    }
+    fileSize = st.st_size;
+    return true;
+#endif
+}
+
+void MappedStream::unmap()
+{
+#ifndef _WIN32
+    if (window)
+        munmap((void *)window, windowLength);
+#endif
+    window = nullptr;
+    windowLength = 0;
+}
+
+void MappedStream::close()
+{
+    unmap();
+#ifdef _WIN32
+    if (file)
+        fclose(file);
+    file = nullptr;
+    buffer.clear();
+#else
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+#endif
+    fileSize = 0;
+}
+
+bool MappedStream::view(uint64_t offset, const char *&data, size_t &length)
+{
+    unmap();
+    if (offset >= fileSize)
+        return false;
+    length = (size_t)min<uint64_t>(windowBytes, fileSize - offset);
+#ifdef _WIN32
+    buffer.resize(length);
+    if (_fseeki64(file, offset, SEEK_SET) != 0 || fread(&buffer[0], 1, length, file) != length)
+        return false;
+    data = buffer.data();
+    return true;
+#else
+    // mappings start on a page boundary; hide the bytes before offset
+    static const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t start = offset & ~(page - 1);
+    windowLength = length + (size_t)(offset - start);
+    void *mapped = mmap(nullptr, windowLength, PROT_READ, MAP_PRIVATE, fd, (off_t)start);
+    if (mapped == MAP_FAILED)
+    {
+        windowLength = 0;
+        return false;
+    }
+    madvise(mapped, windowLength, MADV_SEQUENTIAL);
+    window = (const char *)mapped;
+    data = window + (offset - start);
+    return true;
+#endif
+}
+
+static SnapshotString addSnapshotString(string &blob, const string &value)
+{
+    SnapshotString ref{(uint32_t)blob.size(), (uint32_t)value.size()};
+    blob += value;
+    return ref;
+}
+
+static uint64_t alignTo8(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+template <typename T>
+static bool writeTable(FILE *out, uint64_t offset, const vector<T> &rows)
+{
+    return fseek(out, (long)offset, SEEK_SET) == 0 &&
+           (rows.empty() || fwrite(rows.data(), sizeof(T), rows.size(), out) == rows.size());
+}
+
+bool VotingSystem::writeSnapshot()
+{
+    if (snapshotPath.empty())
+        return false;
+
+    // no mutation can run until the new log generation is in place
+    unique_lock<shared_mutex> checkpoint(checkpointLock);
+
+    string blob;
+    vector<SnapshotUser> userRows;
+    vector<SnapshotElection> electionRows;
+    vector<SnapshotCandidate> candidateRows;
+    vector<int32_t> voterRows;
+    vector<SnapshotVote> voteRows;
+    vector<SnapshotRanking> rankingRows;
+    vector<int32_t> preferenceRows;
+
+    {
+        shared_lock<shared_mutex> guard(indexLock);
+        userRows.reserve(users.size());
+        for (const User *u : users)
+        {
+            const Candidate *candidate =
+                u->getRole() == UserRole::CANDIDATE ? static_cast<const Candidate *>(u) : nullptr;
+            userRows.push_back({u->getUserId(), (int32_t)u->getRole(),
+                                addSnapshotString(blob, u->getUsername()),
+                                addSnapshotString(blob, u->getEmail()),
+                                addSnapshotString(blob, u->getCredential().encode()),
+                                addSnapshotString(blob, candidate ? candidate->getProfileInfo() : "")});
+        }
+
+        for (const Election &e : elections)
+        {
+            SnapshotElection row{e.getElectionId(), (int32_t)e.getStatus(),
+                                 addSnapshotString(blob, e.getTitle()),
+                                 addSnapshotString(blob, e.getDescription()),
+                                 candidateRows.size(), 0, voterRows.size(), 0};
+            for (int candidateId : e.copyCandidates())
+                candidateRows.push_back({candidateId, 0, e.getVoteCount(candidateId)});
+            e.forEachVoter([&](int voterId)
+                           { voterRows.push_back(voterId); });
+            e.forEachRanking([&](const vector<int> &ranking, long long ballots)
+            {
+                rankingRows.push_back({e.getElectionId(), (uint32_t)ranking.size(), preferenceRows.size(), ballots});
+                preferenceRows.insert(preferenceRows.end(), ranking.begin(), ranking.end());
+            });
+            row.candidateCount = candidateRows.size() - row.firstCandidate;
+            row.voterCount = voterRows.size() - row.firstVoter;
+            electionRows.push_back(row);
+        }
+    }
+
+    scanVotes([&](const VoteColumns &columns)
+    {
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            Vote v = columns.row(i);
+            voteRows.push_back({v.getVoteId(), v.getElectionId(), v.getVoterId(), v.getCandidateId()});
+        }
+    });
+
+    SnapshotHeader header;
+    memcpy(header.magic, "VSSNAP02", 8);
+    header.logGeneration = logGeneration;
+    header.nextVoteId = nextVoteId.load();
+    header.userCount = userRows.size();
+    header.userOffset = alignTo8(sizeof(SnapshotHeader));
+    header.electionCount = electionRows.size();
+    header.electionOffset = alignTo8(header.userOffset + userRows.size() * sizeof(SnapshotUser));
+    header.candidateCount = candidateRows.size();
+    header.candidateOffset = alignTo8(header.electionOffset + electionRows.size() * sizeof(SnapshotElection));
+    header.voterCount = voterRows.size();
+    header.voterOffset = alignTo8(header.candidateOffset + candidateRows.size() * sizeof(SnapshotCandidate));
+    header.voteCount = voteRows.size();
+    header.voteOffset = alignTo8(header.voterOffset + voterRows.size() * sizeof(int32_t));
+    header.rankingCount = rankingRows.size();
+    header.rankingOffset = alignTo8(header.voteOffset + voteRows.size() * sizeof(SnapshotVote));
+    header.preferenceCount = preferenceRows.size();
+    header.preferenceOffset = alignTo8(header.rankingOffset + rankingRows.size() * sizeof(SnapshotRanking));
+    header.stringBytes = blob.size();
+    header.stringOffset = alignTo8(header.preferenceOffset + preferenceRows.size() * sizeof(int32_t));
+
+    // write next to the old snapshot and swap, so a crash never leaves half a file
+    string tmpPath = snapshotPath + ".tmp";
+    FILE *out = fopen(tmpPath.c_str(), "wb");
+    if (!out)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              writeTable(out, header.userOffset, userRows) &&
+              writeTable(out, header.electionOffset, electionRows) &&
+              writeTable(out, header.candidateOffset, candidateRows) &&
+              writeTable(out, header.voterOffset, voterRows) &&
+              writeTable(out, header.voteOffset, voteRows) &&
+              writeTable(out, header.rankingOffset, rankingRows) &&
+              writeTable(out, header.preferenceOffset, preferenceRows) &&
+              fseek(out, (long)header.stringOffset, SEEK_SET) == 0 &&
+              fwrite(blob.data(), 1, blob.size(), out) == blob.size() &&
+              fflush(out) == 0 && fsync(fileno(out)) == 0;
+    fclose(out);
+
+    error_code ec;
+    if (ok)
+        filesystem::rename(tmpPath, snapshotPath, ec);
+    if (!ok || ec)
+    {
+        filesystem::remove(tmpPath, ec);
+        return false;
+    }
+
+    // everything so far is in the snapshot: compact the log down to nothing
+    logGeneration++;
+    if (wal && !wal->reset(logPath, logGeneration))
+    {
+        cout << "Could not reset vote log " << logPath << ".\n";
+        wal.reset();
+    }
+    recordsAtSnapshot = wal ? wal->getRecordCount() : 0;
+    return true;
+}
+
+bool VotingSystem::loadSnapshot(const string &path, int &generation)
+{
+    // version 1 headers stop short of the ranking fields, which then stay zero
+    const size_t version1Bytes = offsetof(SnapshotHeader, rankingCount);
+    MappedFile file;
+    if (!file.open(path) || file.length() < version1Bytes)
+        return false;
+
+    const char *base = file.begin();
+    SnapshotHeader fields{};
+    bool version1 = memcmp(base, "VSSNAP01", 8) == 0;
+    if (!version1 && (memcmp(base, "VSSNAP02", 8) != 0 || file.length() < sizeof(SnapshotHeader)))
+        return false;
+    memcpy(&fields, base, version1 ? version1Bytes : sizeof(SnapshotHeader));
+    const SnapshotHeader *header = &fields;
+
+    auto fits = [&](uint64_t offset, uint64_t count, size_t rowSize)
+    { return offset <= file.length() && count <= (file.length() - offset) / rowSize; };
+    if (!fits(header->userOffset, header->userCount, sizeof(SnapshotUser)) ||
+        !fits(header->electionOffset, header->electionCount, sizeof(SnapshotElection)) ||
+        !fits(header->candidateOffset, header->candidateCount, sizeof(SnapshotCandidate)) ||
+        !fits(header->voterOffset, header->voterCount, sizeof(int32_t)) ||
+        !fits(header->voteOffset, header->voteCount, sizeof(SnapshotVote)) ||
+        !fits(header->rankingOffset, header->rankingCount, sizeof(SnapshotRanking)) ||
+        !fits(header->preferenceOffset, header->preferenceCount, sizeof(int32_t)) ||
+        !fits(header->stringOffset, header->stringBytes, 1))
+        return false;
+
+    // a status no election can have means a corrupt file; checked before anything is loaded
+    const SnapshotElection *electionRows = (const SnapshotElection *)(base + header->electionOffset);
+    for (uint64_t i = 0; i < header->electionCount; i++)
+    {
+        if (electionRows[i].status < (int32_t)ElectionStatus::CREATED ||
+            electionRows[i].status > (int32_t)ElectionStatus::CLOSED)
+            return false;
+    }
+
+    const char *blob = base + header->stringOffset;
+    auto text = [&](const SnapshotString &ref)
+    {
+        if ((uint64_t)ref.offset + ref.length > header->stringBytes)
+            return string();
+        return string(blob + ref.offset, ref.length);
+    };
+
+    const SnapshotUser *userRows = (const SnapshotUser *)(base + header->userOffset);
+    for (uint64_t i = 0; i < header->userCount; i++)
+    {
+        const SnapshotUser &row = userRows[i];
+        if (row.role == (int32_t)UserRole::CANDIDATE)
+            addUser(withStoredCredential(Candidate(row.userId, text(row.username), text(row.email),
+                                                   text(row.credential), text(row.profile), this)));
+        else if (row.role == (int32_t)UserRole::ADMIN)
+            addUser(withStoredCredential(Admin(row.userId, text(row.username), text(row.email),
+                                               text(row.credential), this)));
+        else
+            addUser(withStoredCredential(Voter(row.userId, text(row.username), text(row.email),
+                                               text(row.credential), this)));
+    }
+
+    const SnapshotCandidate *candidateRows = (const SnapshotCandidate *)(base + header->candidateOffset);
+    const int32_t *voterRows = (const int32_t *)(base + header->voterOffset);
+    for (uint64_t i = 0; i < header->electionCount; i++)
+    {
+        const SnapshotElection &row = electionRows[i];
+        Election *e = addElection(row.electionId, text(row.title), text(row.description)) == ChangeStatus::REJECTED
+                          ? nullptr
+                          : findElection(row.electionId);
+        if (!e || row.firstCandidate + row.candidateCount > header->candidateCount ||
+            row.firstVoter + row.voterCount > header->voterCount)
+            continue;
+        e->restoreStatus((ElectionStatus)row.status);
+        for (uint64_t c = row.firstCandidate; c < row.firstCandidate + row.candidateCount; c++)
+        {
+            if (e->addCandidate(candidateRows[c].candidateId))
+                linkCandidate(row.electionId, candidateRows[c].candidateId, true);
+            e->restoreTally(candidateRows[c].candidateId, candidateRows[c].votes);
+        }
+        for (uint64_t v = row.firstVoter; v < row.firstVoter + row.voterCount; v++)
+            e->restoreVoter(voterRows[v]);
+        publishElection(*e);
+    }
+
+    const SnapshotRanking *rankingRows = (const SnapshotRanking *)(base + header->rankingOffset);
+    const int32_t *preferenceRows = (const int32_t *)(base + header->preferenceOffset);
+    for (uint64_t i = 0; i < header->rankingCount; i++)
+    {
+        const SnapshotRanking &row = rankingRows[i];
+        Election *e = findElection(row.electionId);
+        if (e && row.length > 0 && row.firstPreference + row.length <= header->preferenceCount)
+            e->restoreRanking(preferenceRows + row.firstPreference, row.length, row.ballots);
+    }
+
+    const SnapshotVote *voteRows = (const SnapshotVote *)(base + header->voteOffset);
+    for (uint64_t i = 0; i < header->voteCount; i++)
+        restoreVote(Vote(voteRows[i].voteId, voteRows[i].electionId,
+                         voteRows[i].voterId, voteRows[i].candidateId));
+    nextVoteId = header->nextVoteId;
+
+    generation = header->logGeneration;
+    startupStats.snapshotUsers = header->userCount;
+    startupStats.snapshotVotes = header->voteCount;
+    return true;
+}
+
+void VotingSystem::restoreVote(const Vote &vote)
+{
+    VoteShard &shard = shardFor(vote.getVoteId());
+    lock_guard<mutex> guard(shard.lock);
+    shard.columns.append(vote.getVoteId(), vote.getElectionId(), vote.getVoterId(), vote.getCandidateId());
+}
+
+void VotingSystem::setSnapshotInterval(uint64_t records)
+{
+    snapshotEvery = records;
+    if (records == 0 || snapshotter.joinable())
+        return;
+
+    snapshotter = thread([this]()
+    {
+        unique_lock<mutex> guard(snapshotterLock);
+        while (!stopping)
+        {
+            snapshotterWake.wait_for(guard, chrono::milliseconds(200));
+            uint64_t every = snapshotEvery.load();
+            if (stopping || every == 0)
+                continue;
+            bool due;
+            {
+                // writeSnapshot swaps wal and recordsAtSnapshot under the exclusive lock
+                shared_lock<shared_mutex> checkpoint(checkpointLock);
+                due = wal && wal->getRecordCount() - recordsAtSnapshot >= every;
+            }
+            if (due)
+            {
+                guard.unlock();
+                writeSnapshot();
+                guard.lock();
+            }
+        }
+    });
+}
+
+VotingSystem::~VotingSystem()
+{
+    {
+        lock_guard<mutex> guard(snapshotterLock);
+        stopping = true;
+    }
+    snapshotterWake.notify_all();
+    if (snapshotter.joinable())
+        snapshotter.join();
+}
+
+//////////////////////////////
+
+/* ---------- Test Cases ---------- */
+void TestCandidate(VotingSystem &system);
+
+/* ---------- User method implementation ---------- */
+void User::viewElections()
+{
+    for (const ElectionInfo &e : VotingService(*system).listElections())
+    {
+        cout << "Id: " << e.electionId << endl;
+        cout << "Status: " << (e.status == ElectionStatus::OPENED) << endl;
+    }
+}
+
+void User::login()
+{
+    VotingService service(*system);
+    string inputUsername, inputPassword;
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        cout << "Enter username: ";
+        cin >> inputUsername;
+
+        cout << "Enter password: ";
+        cin >> inputPassword;
+        if (!cin)
+            return; // input closed
+
+        User *user;
+        if (service.login(inputUsername, inputPassword, user) == ServiceStatus::OK)
+        {
+            username = inputUsername;
+            credential = user->getCredential();
+            cout << "Login successful!" << endl;
+            return;
+        }
+        cout << "Invalid username or password. Please try again." << endl;
+    }
+    cout << "Too many failed attempts." << endl;
+}
+
+void User::registerUser()
+{
+    promptCredentials();
+    if (!addToSystem()) // the system stores its own copy of this user
+    {
+        cout << "User ID " << userId << " already exists." << endl;
+        return;
+    }
+    cout << "Registration successful!" << endl;
+}
+
+void User::promptCredentials()
+{
+    string inputUsername, inputEmail, inputPassword;
+
+    do
+    {
+        cout << "Enter username: ";
+        cin >> inputUsername;
+
+        if (inputUsername.empty())
+        {
+            cout << "Username cannot be empty." << endl;
+            continue;
+        }
+        if (system->findUserByUsername(inputUsername))
+        {
+            cout << "Username already exists." << endl;
+            continue;
+        }
+
+        cout << "Enter email: ";
+        cin >> inputEmail;
+
+        if (inputEmail.empty())
+        {
+            cout << "Email cannot be empty." << endl;
+            continue;
+        }
+        if (system->findUserByEmail(inputEmail))
+        {
+            cout << "Email already registered." << endl;
+            continue;
+        }
+
+        cout << "Enter password: ";
+        cin >> inputPassword;
+        if (inputPassword.empty())
+        {
+            cout << "Password cannot be empty." << endl;
             continue;
         }
-        for (User *user : system->getUsers())
+
+        // navigation to menu will be added later
+
+        break; // exit loop on successful registration
+
+    } while (true);
+
+    // Registration logic (e.g., saving to database) will be added later
+    username = inputUsername;
+    email = inputEmail;
+    password = inputPassword;
+}
+
+void User::logout()
+{
+    cout << "Logged out successfully." << endl;
+    // Navigation to main menu will be added later
+}
+
+///////////////////////////////
+/*Admin methods implementation */
+bool Admin::addToSystem() const
+{
+    return system->addUser(*this) != nullptr;
+}
+
+void Admin::addCandidate(int electionId, int candidateId)
+{
+    switch (VotingService(*system).addCandidate(electionId, candidateId))
+    {
+    case ServiceStatus::OK:
+        cout << "Candidate " << candidateId
+             << " added to Election " << electionId << " successfully.\n";
+        break;
+    case ServiceStatus::ELECTION_NOT_FOUND:
+        cout << "Election with ID " << electionId << " not found.\n";
+        break;
+    case ServiceStatus::USER_NOT_FOUND:
+        cout << "User is not a valid candidate or does not exist.\n";
+        break;
+    case ServiceStatus::NOT_DURABLE:
+        cout << "Change applied, but it could not be saved to the log.\n";
+        break;
+    default:
+        cout << "Candidate already added to this election.\n";
+        break;
+    }
+}
+
+void Admin::removeCandidate(int electionId, int candidateId)
+{
+    switch (VotingService(*system).removeCandidate(electionId, candidateId))
+    {
+    case ServiceStatus::OK:
+        cout << "Candidate " << candidateId
+             << " deleted  from Election " << electionId << " successfully.\n";
+        break;
+    case ServiceStatus::ELECTION_NOT_FOUND:
+        cout << "Election with ID " << electionId << " not found.\n";
+        break;
+    case ServiceStatus::USER_NOT_FOUND:
+        cout << "User is not a valid candidate or does not exist.\n";
+        break;
+    case ServiceStatus::NOT_DURABLE:
+        cout << "Change applied, but it could not be saved to the log.\n";
+        break;
+    default:
+        cout << "Candidate " << candidateId << " is not part of Election " << electionId << ".\n";
+        break;
+    }
+}
+
+int Admin::createElection()
+{
+    VotingService service(*system);
+    int id;
+    cout << "Enter Election ID: ";
+    cin >> id;
+
+    cin.ignore(numeric_limits<streamsize>::max(), '\n'); // to ignore leftover newline or any extra input
+
+    ElectionInfo existing;
+    if (service.getElection(id, existing) == ServiceStatus::OK)
+    {
+        cout << "Election ID already exists.\n";
+        return -1;
+    }
+    string title, description;
+
+    cout << "Enter Election Title: ";
+    getline(cin, title);
+
+    cout << "Enter Election Description: ";
+    getline(cin, description);
+
+    ServiceStatus status = service.createElection(id, title, description);
+    if (status != ServiceStatus::OK)
+    {
+        cout << "Election not created: " << serviceStatusName(status) << ".\n";
+        return -1;
+    }
+    cout << "Election has been created successfully.\n";
+    return id;
+} // completed
+
+void Admin::updateElection(int electionId)
+{
+    VotingService service(*system);
+    ElectionInfo current;
+    if (service.getElection(electionId, current) != ServiceStatus::OK)
+    {
+        cout << "Election with ID " << electionId << " not found." << endl;
+        return;
+    }
+
+    string newTitle, newDescription;
+    cout << "Current title: " << current.title << endl;
+    cout << "Enter new title (or press Enter to keep current): ";
+    getline(cin, newTitle);
+
+    cout << "Current description: " << current.description << endl;
+    cout << "Enter new description (or press Enter to keep current): ";
+    getline(cin, newDescription);
+
+    // empty keeps the current text
+    switch (service.updateElection(electionId, newTitle, newDescription))
+    {
+    case ServiceStatus::OK:
+        cout << "Election has been updated successfully." << endl;
+        break;
+    case ServiceStatus::NOT_DURABLE:
+        cout << "Election updated, but the change could not be saved to the log." << endl;
+        break;
+    default:
+        cout << "Election with ID " << electionId << " not found." << endl;
+        break;
+    }
+}
+
+
+void Admin::openElection(int electionId)
+{
+    VotingService service(*system);
+    ElectionInfo info;
+    switch (service.openElection(electionId))
+    {
+    case ServiceStatus::OK:
+        cout << "Election " << electionId << " is now open for voting." << endl;
+        break;
+    case ServiceStatus::ELECTION_NOT_FOUND:
+        cout << "Election with ID " << electionId << " not found." << endl;
+        break;
+    case ServiceStatus::NOT_DURABLE:
+        cout << "Change applied, but it could not be saved to the log." << endl;
+        break;
+    default:
+        service.getElection(electionId, info);
+        cout << "Election " << electionId << " is already " << (info.status == ElectionStatus::OPENED ? "open" : "closed") << "." << endl;
+        break;
+    }
+}
+
+void Admin::closeElection(int electionId)
+{
+    VotingService service(*system);
+    ElectionInfo info;
+    switch (service.closeElection(electionId))
+    {
+    case ServiceStatus::OK:
+        cout << "Election " << electionId << " has been closed successfully." << endl;
+        break;
+    case ServiceStatus::ELECTION_NOT_FOUND:
+        cout << "Election with ID " << electionId << " not found." << endl;
+        break;
+    case ServiceStatus::NOT_DURABLE:
+        cout << "Change applied, but it could not be saved to the log." << endl;
+        break;
+    default:
+        service.getElection(electionId, info);
+        cout << "Election " << electionId << " is already " << (info.status == ElectionStatus::CLOSED ? "closed" : "not yet open") << "." << endl;
+        break;
+    }
+}
+void Admin::viewResults(int electionId)
+{
+    VotingService service(*system);
+    ElectionInfo info;
+    ElectionResults results;
+    if (service.getElection(electionId, info) != ServiceStatus::OK ||
+        service.getResults(electionId, results) != ServiceStatus::OK)
+    {
+        cout << "Election with ID " << electionId << " not found." << endl;
+        return;
+    }
+
+    cout << "===== Results: " << info.title << " =====\n";
+    int rank = 1;
+    for (const CandidateResult &r : results.results)
+    {
+        User *u = system->findUser(r.candidateId);
+        cout << rank++ << ". " << (u ? u->getUsername() : "unknown")
+             << " (ID " << r.candidateId << "): " << r.votes << " votes\n";
+    }
+    cout << "Total votes: " << results.totalVotes
+         << " | Voted set: " << system->findElection(electionId)->getVotedMemoryBytes() << " bytes" << endl;
+}
+void Admin::viewRunoff(int electionId)
+{
+    RunoffResult runoff;
+    if (VotingService(*system).getRunoff(electionId, runoff) != ServiceStatus::OK)
+    {
+        cout << "Election with ID " << electionId << " not found." << endl;
+        return;
+    }
+
+    cout << "===== Instant runoff: " << runoff.ballots << " ballots =====\n";
+    for (size_t r = 0; r < runoff.rounds.size(); r++)
+    {
+        const RunoffRound &round = runoff.rounds[r];
+        cout << "Round " << r + 1 << ":";
+        for (const CandidateResult &c : round.counts)
+            cout << " " << c.candidateId << "=" << c.votes;
+        cout << " (exhausted " << round.exhausted << ")";
+        if (round.eliminated >= 0)
+            cout << ", eliminated " << round.eliminated;
+        cout << "\n";
+    }
+    if (runoff.winner < 0)
+        cout << "No winner: no ballots counted." << endl;
+    else
+    {
+        User *u = system->findUser(runoff.winner);
+        cout << "Winner: " << (u ? u->getUsername() : "unknown") << " (ID " << runoff.winner << ")" << endl;
+    }
+}
+void Admin::viewPairwise(int electionId)
+{
+    ThreadPool pool;
+    PairwiseResult pairwise;
+    ServiceStatus status = VotingService(*system).getPairwise(electionId, pool, pairwise);
+    if (status == ServiceStatus::INVALID_STATE)
+    {
+        cout << "Close election " << electionId << " first." << endl;
+        return;
+    }
+    if (status != ServiceStatus::OK)
+    {
+        cout << "Election with ID " << electionId << " not found." << endl;
+        return;
+    }
+
+    const PairwiseMatrix &m = pairwise.matrix;
+    cout << "===== Pairwise: " << m.ballots << " ballots =====\n";
+    if (m.candidateIds.size() <= 12)
+    {
+        cout << "row beats column:";
+        for (int id : m.candidateIds)
+            cout << "\t" << id;
+        cout << "\n";
+        for (size_t i = 0; i < m.candidateIds.size(); i++)
+        {
+            cout << m.candidateIds[i];
+            for (size_t j = 0; j < m.candidateIds.size(); j++)
+                cout << "\t" << (i == j ? string("-") : to_string(m.at(i, j)));
+            cout << "\n";
+        }
+    }
+    cout << "Copeland:";
+    for (const CandidateResult &c : pairwise.copeland)
+        cout << " " << c.candidateId << "=" << c.votes;
+    cout << "\nSchulze:";
+    for (const CandidateResult &c : pairwise.schulze)
+        cout << " " << c.candidateId << "=" << c.votes;
+    cout << "\n";
+    if (pairwise.condorcetWinner >= 0)
+        cout << "Condorcet winner: " << pairwise.condorcetWinner << "\n";
+    else
+        cout << "No Condorcet winner.\n";
+    if (pairwise.schulzeWinner < 0)
+        cout << "No single Schulze winner." << endl;
+    else
+    {
+        User *u = system->findUser(pairwise.schulzeWinner);
+        cout << "Schulze winner: " << (u ? u->getUsername() : "unknown") << " (ID " << pairwise.schulzeWinner << ")"
+             << endl;
+    }
+}
+void Admin::auditElection(int electionId)
+{
+    vector<AuditMismatch> mismatches;
+    if (VotingService(*system).auditElection(electionId, mismatches) != ServiceStatus::OK)
+    {
+        cout << "Election with ID " << electionId << " not found." << endl;
+        return;
+    }
+
+    for (const AuditMismatch &m : mismatches)
+    {
+        cout << "Candidate " << m.candidateId << ": tally " << m.tally
+             << ", recount " << m.recount << endl;
+    }
+    cout << "Audit of Election " << electionId << " (" << recountKernelName(bestRecountKernel())
+         << "): " << (mismatches.empty() ? "recount matches the tallies." : "MISMATCH.") << endl;
+}
+//////////////////////////////////////
+/*Guest  methods implementation*/
+void Guest::viewElections()
+{
+
+    cout << "===== Available Elections =====\n";
+    for (const ElectionInfo &e : VotingService(*system).listElections())
+    {
+        cout << "ID: " << e.electionId
+             << "  Title: " << e.title
+             << "  Status: " << electionStatusName(e.status) << endl;
+    }
+}
+
+
+void Guest::viewElectionDetails(int electionId)
+{
+    ElectionInfo e;
+    if (VotingService(*system).getElection(electionId, e) != ServiceStatus::OK)
+    {
+        cout << "Election not found.\n";
+        return;
+    }
+
+    cout << "===== Election Details =====\n";
+    cout << "Title: " << e.title << endl;
+    cout << "Description: " << e.description << endl;
+    cout << "Status: " << electionStatusName(e.status) << endl;
+}
+
+void Guest::viewCandidates(int electionId) // tamer , mo3tasem
+{
+    VotingService service(*system);
+    ElectionInfo e;
+    vector<CandidateInfo> candidates;
+    if (service.getElection(electionId, e) != ServiceStatus::OK ||
+        service.listCandidates(electionId, candidates) != ServiceStatus::OK)
+    {
+        cout << "Election with ID " << electionId << " not found.\n";
+        return;
+    }
+
+    cout << "Candidates for Election: " << e.title << "\n";
+
+    for (const CandidateInfo &c : candidates)
+    {
+        cout << "- Candidate ID: " << c.candidateId
+             << ", Username: " << c.username
+             << ", Email: " << c.email << endl;
+    }
+}
+///////////////////////////////////////////
+/*---  candidate methods implementation */
+
+
+
+void Candidate::promptCredentials()
+{
+    User::promptCredentials(); // ask for the base fields first
+
+    string inputProfileInfo;
+    cout << "Enter profile info: ";
+    cin.ignore(); // to ignore the newline character left in the buffer
+    getline(cin, inputProfileInfo);
+    profileInfo = inputProfileInfo;
+}
+
+bool Candidate::addToSystem() const
+{
+    return system->addUser(*this) != nullptr;
+}
+
+void Candidate::viewMyElections()
+{
+    VotingService service(*system);
+    cout << "Elections for Candidate " << username << ":\n";
+    service.forEachCandidateElection(userId, [&](int electionId)
+    {
+        ElectionInfo e;
+        if (service.getElection(electionId, e) == ServiceStatus::OK)
+        {
+            cout << "Election ID: " << e.electionId
+                 << ", Title: " << e.title << endl;
+        }
+    });
+}
+
+void Candidate::viewVoteCount(int electionId)
+{
+    long long votes = 0;
+    if (VotingService(*system).getVoteCount(electionId, userId, votes) == ServiceStatus::ELECTION_NOT_FOUND)
+    {
+        cout << "Election with ID " << electionId << " not found." << endl;
+        return;
+    }
+    cout << "Total votes received in Election " << electionId
+         << ": " << votes << endl;
+}
+void testGuest(VotingSystem& system);
+void testVoter(VotingSystem& system);
+void testConcurrentVoting();
+void testWriteAheadLog();
+void testSnapshot();
+void testVoteStore();
+void benchRecount(size_t voteCount);
+void testClosedResults();
+void testCandidateMembership();
+void testBallotImport();
+int importBallotFile(VotingSystem &system, const string &path);
+int importRosterFile(VotingSystem &system, const string &path);
+void testStreamingParser();
+void benchParse(size_t ballotCount);
+void testService();
+void testCredentials();
+void testTallyFeed();
+void testMetrics();
+void testRankedChoice();
+void benchRunoff(size_t ballotCount, int candidateCount);
+void testPairwise();
+void benchPairwise(size_t ballotCount, int candidateCount);
+void testScheduler();
+void benchScheduler(int electionCount, int spreadMillis);
+void testCatalog();
+void benchCatalog(int readerCount, int millis);
+void testSyntheticData();
+int generateDataset(int voters, int elections, double ballotsPerVoter, uint64_t seed);
+int runBenchmarkSuite(int argc, char *argv[]);
+void benchFeed(int subscriberCount, int intervalMs);
+void benchLogin(size_t userCount, uint32_t cost);
+#ifdef __linux__
+void testServer();
+void benchServer(int connectionCount, int votesPerConnection);
+#endif
+void benchResults(size_t voteCount);
+#ifdef VS_BENCHMARK_MAIN
+void benchUsers(size_t userCount); // vs_bench only: it replaces operator new to count allocations
+#endif
+
+
+
+
+
+
+
+
+
+
+static void printVoteStatus(VoteStatus status)
+{
+    switch (status)
+    {
+    case VoteStatus::ACCEPTED:
+        cout << "Vote submitted successfully.\n";
+        break;
+    case VoteStatus::ELECTION_NOT_FOUND:
+        cout << "Election not found.\n";
+        break;
+    case VoteStatus::ELECTION_NOT_OPEN:
+        cout << "Election not Open.\n";
+        break;
+    case VoteStatus::CANDIDATE_NOT_FOUND:
+        cout << "This candidate is not part of this election.\n";
+        break;
+    case VoteStatus::VOTER_NOT_ALLOWED:
+        cout << "You are not allowed to vote.\n";
+        break;
+    case VoteStatus::ALREADY_VOTED:
+        cout << "You have already voted in this election.\n";
+        break;
+    case VoteStatus::INVALID_RANKING:
+        cout << "Rank at least one candidate, each at most once.\n";
+        break;
+    case VoteStatus::NOT_DURABLE:
+        cout << "Vote not recorded: the vote log could not be written.\n";
+        break;
+    }
+}
+
+void Voter::vote(int electionId, int candidateId)
+{
+    printVoteStatus(VotingService(*system).castVote(userId, electionId, candidateId));
+}
+
+void Voter::rankedVote(int electionId, const vector<int> &ranking)
+{
+    printVoteStatus(VotingService(*system).castRankedVote(userId, electionId, ranking));
+}
+
+
+bool Voter::addToSystem() const
+{
+    return system->addUser(*this) != nullptr;
+}
+
+bool Voter::hasVoted(int electionId) const
+{
+    const Election *e = system->findElection(electionId);
+    return e && e->hasVoted(userId);
+}
+
+/* ---------- Console menus ---------- */
+// Menu choice; 0 (back/exit) once input runs out.
+static int readChoice()
+{
+    cout << "Choice: ";
+    int choice;
+    if (cin >> choice)
+        return choice;
+    if (cin.eof())
+        return 0;
+    cin.clear();
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    return -1;
+}
+
+static int readId(const char *prompt)
+{
+    cout << prompt;
+    int id = 0;
+    if (!(cin >> id))
+    {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        return -1;
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    return id;
+}
+
+void VotingSystem::run()
+{
+    VotingService service(*this);
+    while (true)
+    {
+        cout << "\n===== Voting System =====\n"
+             << "1. Continue as guest\n2. Login\n3. Register as voter\n4. Register as candidate\n0. Exit\n";
+        switch (readChoice())
+        {
+        case 0:
+            return;
+        case 1:
+            guestMenu();
+            break;
+        case 2:
+        {
+            string username, password;
+            cout << "Enter username: ";
+            cin >> username;
+            cout << "Enter password: ";
+            cin >> password;
+            User *user;
+            if (service.login(username, password, user) != ServiceStatus::OK)
+            {
+                cout << "Invalid username or password." << endl;
+                break;
+            }
+            cout << "Login successful!" << endl;
+            if (user->getRole() == UserRole::ADMIN)
+                adminMenu(static_cast<Admin *>(user));
+            else if (user->getRole() == UserRole::CANDIDATE)
+                candidateMenu(static_cast<Candidate *>(user));
+            else
+                voterMenu(static_cast<Voter *>(user));
+            break;
+        }
+        case 3:
+        {
+            Voter voter(nextUserId(), "", "", "", this);
+            voter.registerUser();
+            break;
+        }
+        case 4:
+        {
+            Candidate candidate(nextUserId(), "", "", "", "", this);
+            candidate.registerUser();
+            break;
+        }
+        default:
+            cout << "Invalid choice." << endl;
+        }
+    }
+}
+
+void VotingSystem::guestMenu()
+{
+    Guest guest(this);
+    while (true)
+    {
+        cout << "\n===== Guest =====\n"
+             << "1. View elections\n2. Election details\n3. View candidates\n4. Voting rules\n0. Back\n";
+        switch (readChoice())
+        {
+        case 0:
+            return;
+        case 1:
+            guest.viewElections();
+            break;
+        case 2:
+            guest.viewElectionDetails(readId("Election ID: "));
+            break;
+        case 3:
+            guest.viewCandidates(readId("Election ID: "));
+            break;
+        case 4:
+            guest.viewVotingRules();
+            break;
+        default:
+            cout << "Invalid choice." << endl;
+        }
+    }
+}
+
+void VotingSystem::voterMenu(Voter *voter)
+{
+    Guest guest(this);
+    while (true)
+    {
+        cout << "\n===== Voter: " << voter->getUsername() << " =====\n"
+             << "1. View elections\n2. View candidates\n3. Vote\n4. Have I voted?\n5. Ranked vote\n0. Logout\n";
+        switch (readChoice())
+        {
+        case 0:
+            voter->logout();
+            return;
+        case 1:
+            guest.viewElections();
+            break;
+        case 2:
+            guest.viewCandidates(readId("Election ID: "));
+            break;
+        case 3:
+        {
+            int electionId = readId("Election ID: ");
+            voter->vote(electionId, readId("Candidate ID: "));
+            break;
+        }
+        case 4:
+        {
+            int electionId = readId("Election ID: ");
+            cout << (voter->hasVoted(electionId) ? "You have voted in this election." : "You have not voted in this election.") << endl;
+            break;
+        }
+        case 5:
+        {
+            int electionId = readId("Election ID: ");
+            vector<int> ranking;
+            cout << "Candidate IDs, most preferred first, 0 to finish:\n";
+            for (int candidateId; (candidateId = readId("Candidate ID: ")) > 0;)
+                ranking.push_back(candidateId);
+            voter->rankedVote(electionId, ranking);
+            break;
+        }
+        default:
+            cout << "Invalid choice." << endl;
+        }
+    }
+}
+
+void VotingSystem::candidateMenu(Candidate *candidate)
+{
+    while (true)
+    {
+        cout << "\n===== Candidate: " << candidate->getUsername() << " =====\n"
+             << "1. My elections\n2. My vote count\n0. Logout\n";
+        switch (readChoice())
+        {
+        case 0:
+            candidate->logout();
+            return;
+        case 1:
+            candidate->viewMyElections();
+            break;
+        case 2:
+            candidate->viewVoteCount(readId("Election ID: "));
+            break;
+        default:
+            cout << "Invalid choice." << endl;
+        }
+    }
+}
+
+void VotingSystem::adminMenu(Admin *admin)
+{
+    Guest guest(this);
+    while (true)
+    {
+        cout << "\n===== Admin: " << admin->getUsername() << " =====\n"
+             << "1. View elections\n2. Create election\n3. Update election\n4. Open election\n"
+             << "5. Close election\n6. Add candidate\n7. Remove candidate\n8. Results\n9. Audit\n"
+             << "10. Latency metrics\n11. Instant-runoff results\n12. Pairwise results\n0. Logout\n";
+        switch (readChoice())
+        {
+        case 0:
+            admin->logout();
+            return;
+        case 1:
+            guest.viewElections();
+            break;
+        case 2:
+            admin->createElection();
+            break;
+        case 3:
+            admin->updateElection(readId("Election ID: "));
+            break;
+        case 4:
+            admin->openElection(readId("Election ID: "));
+            break;
+        case 5:
+            admin->closeElection(readId("Election ID: "));
+            break;
+        case 6:
+        {
+            int electionId = readId("Election ID: ");
+            admin->addCandidate(electionId, readId("Candidate ID: "));
+            break;
+        }
+        case 7:
+        {
+            int electionId = readId("Election ID: ");
+            admin->removeCandidate(electionId, readId("Candidate ID: "));
+            break;
+        }
+        case 8:
+            admin->viewResults(readId("Election ID: "));
+            break;
+        case 9:
+            admin->auditElection(readId("Election ID: "));
+            break;
+        case 10:
+            writeMetrics(cout);
+            break;
+        case 11:
+            admin->viewRunoff(readId("Election ID: "));
+            break;
+        case 12:
+            admin->viewPairwise(readId("Election ID: "));
+            break;
+        default:
+            cout << "Invalid choice." << endl;
+        }
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/* ---------- main ---------- */
+int main(int argc, char *argv[])
+{
+#ifdef VS_BENCHMARK_MAIN
+    // the vs_bench target
+    if (argc > 1 && string(argv[1]) == "--bench-users")
+    {
+        benchUsers(argc > 2 ? stoull(argv[2]) : 1000000);
+        return 0;
+    }
+    return runBenchmarkSuite(argc - 1, argv + 1);
+#endif
+    if (argc > 1 && string(argv[1]) == "--bench-suite")
+        return runBenchmarkSuite(argc - 2, argv + 2);
+    if (argc > 1 && string(argv[1]) == "--bench-recount")
+    {
+        benchRecount(argc > 2 ? stoull(argv[2]) : 20000000);
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "--import")
+    {
+        VotingSystem system;
+        if (!system.openLog("votes.wal", "votes.snap"))
+            system.fillDate();
+        return importBallotFile(system, argv[2]);
+    }
+    if (argc > 1 && string(argv[1]) == "--interactive")
+    {
+        VotingSystem system;
+        if (!system.openLog("votes.wal", "votes.snap"))
+            system.fillDate();
+        system.run();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--serve")
+    {
+#ifdef __linux__
+        VotingSystem system;
+        if (!system.openLog("votes.wal", "votes.snap"))
+            system.fillDate();
+        VotingService service(system);
+        VotingServer server(service);
+        if (!server.start(argc > 2 ? stoi(argv[2]) : 5050, false))
+        {
+            cerr << "Cannot listen on that port\n";
+            return 1;
+        }
+        ElectionScheduler scheduler(system);
+        scheduler.setOnClose([](const ElectionResults &results)
+        {
+            cout << "Election " << results.electionId << " closed on schedule, " << results.totalVotes << " votes";
+            if (!results.results.empty())
+                cout << ", leader " << results.results[0].candidateId;
+            cout << endl;
+        });
+        scheduler.start();
+        cout << "Serving on port " << server.port() << ", type metrics [file] for latency stats, "
+             << "schedule <election> <open in s> <close in s> for a timed window, quit to stop\n";
+        string line;
+        while (getline(cin, line) && line != "quit")
         {
-            if (user->getUsername() == inputUsername)
+            if (line == "metrics")
+                writeMetrics(cout);
+            else if (line.rfind("metrics ", 0) == 0)
+                cout << (exportMetrics(line.substr(8)) ? "Metrics written\n" : "Cannot write that file\n");
+            else if (line.rfind("schedule ", 0) == 0)
             {
-                cout << "Username already exists." << endl;
-                exists = true;
-                break;
+                istringstream in(line.substr(9));
+                int electionId;
+                double openIn, closeIn;
+                if (!(in >> electionId >> openIn >> closeIn))
+                {
+                    cout << "Usage: schedule <election> <open in s> <close in s>\n";
+                    continue;
+                }
+                using Clock = ElectionScheduler::Clock;
+                Clock::time_point now = Clock::now();
+                auto at = [&](double seconds)
+                { return now + chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds)); };
+                cout << serviceStatusName(scheduler.schedule(electionId, at(openIn), at(closeIn))) << "\n";
+            }
+        }
+        scheduler.stop();
+        return 0;
+#else
+        cerr << "--serve needs epoll (Linux)\n";
+        return 1;
+#endif
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-server")
+    {
+#ifdef __linux__
+        benchServer(argc > 2 ? stoi(argv[2]) : 8, argc > 3 ? stoi(argv[3]) : 20000);
+#endif
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "--import-roster")
+    {
+        VotingSystem system;
+        if (!system.openLog("votes.wal", "votes.snap"))
+            system.fillDate();
+        return importRosterFile(system, argv[2]);
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-parse")
+    {
+        benchParse(argc > 2 ? stoull(argv[2]) : 5000000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--generate")
+        return generateDataset(argc > 2 ? stoi(argv[2]) : 2000000, argc > 3 ? stoi(argv[3]) : 2000,
+                               argc > 4 ? stod(argv[4]) : 5, argc > 5 ? stoull(argv[5]) : 1);
+    if (argc > 1 && string(argv[1]) == "--bench-feed")
+    {
+        benchFeed(argc > 2 ? stoi(argv[2]) : 2000, argc > 3 ? stoi(argv[3]) : 50);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-runoff")
+    {
+        benchRunoff(argc > 2 ? stoull(argv[2]) : 1000000, argc > 3 ? stoi(argv[3]) : 20);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-pairwise")
+    {
+        benchPairwise(argc > 2 ? stoull(argv[2]) : 1000000, argc > 3 ? stoi(argv[3]) : 20);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-scheduler")
+    {
+        benchScheduler(argc > 2 ? stoi(argv[2]) : 5000, argc > 3 ? stoi(argv[3]) : 3000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-catalog")
+    {
+        benchCatalog(argc > 2 ? stoi(argv[2]) : max(2, (int)thread::hardware_concurrency()),
+                     argc > 3 ? stoi(argv[3]) : 1000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-login")
+    {
+        benchLogin(argc > 2 ? stoull(argv[2]) : 1000000, argc > 3 ? stoul(argv[3]) : 10000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-results")
+    {
+        benchResults(argc > 2 ? stoull(argv[2]) : 4000000);
+        return 0;
+    }
+
+    VotingSystem system;
+    if (!system.openLog("votes.wal", "votes.snap")) // replays earlier runs
+        system.fillDate(); // IMPORTANT: first run only, the seed data goes into the log
+    system.setSnapshotInterval(100000);
+
+    const StartupStats &startup = system.getStartupStats();
+    cout << "Startup: snapshot " << startup.snapshotUsers << " users, "
+         << startup.snapshotVotes << " votes in " << startup.snapshotMs << " ms; replayed "
+         << startup.replayedRecords << " log records in " << startup.replayMs << " ms\n";
+    testGuest(system);//test
+    testVoter(system);//test
+    testConcurrentVoting();//test
+    testWriteAheadLog();//test
+    testSnapshot();//test
+    testVoteStore();//test
+    testClosedResults();//test
+    testCandidateMembership();//test
+    testBallotImport();//test
+    testStreamingParser();//test
+    testService();//test
+    testCredentials();//test
+    testTallyFeed();//test
+    testMetrics();//test
+    testRankedChoice();//test
+    testPairwise();//test
+    testScheduler();//test
+    testCatalog();//test
+    testSyntheticData();//test
+#ifdef __linux__
+    testServer();//test
+#endif
+
+    cout << "\n===== TEST: ensure if admins created sucessfully =====\n";
+    system.getAdmins().forEach([](const Admin &u)
+    {
+        cout << "Admin User - ID: " << u.getUserId() << ", Username: " << u.getUsername() << endl;
+    }); /// COMPLETED
+    cout << "\n===== TEST: ensure if create election logic is correct =====\n";
+    Admin *adminUser = nullptr;
+    if (system.getAdmins().size() > 0)
+        adminUser = &system.getAdmins()[0]; // admins are kept apart, no cast needed
+    if (adminUser)
+    {
+        int id = adminUser->createElection(); // Test creating a new election
+        // make sure  that the election created sucessfully
+
+        if (const Election *e = system.findElection(id))
+        {
+            cout << "ID: " << e->getElectionId()
+                 << " | Title: " << e->getTitle()
+                 << " | Status: ";
+
+            if (e->getStatus() == ElectionStatus::CREATED)
+                cout << "Created";
+            else if (e->getStatus() == ElectionStatus::OPENED)
+                cout << "Opened";
+            else
+                cout << "Closed";
+
+            cout << endl;
+        }
+
+        cout << "Enter the election id : ";
+        cin >> id;
+        cin.ignore();
+        adminUser->updateElection(id);
+        if (const Election *e = system.findElection(id))
+        {
+            cout << "ID: " << e->getElectionId()
+                 << " | Title: " << e->getTitle()
+                 << " | Status: ";
+
+            if (e->getStatus() == ElectionStatus::CREATED)
+                cout << "Created";
+            else if (e->getStatus() == ElectionStatus::OPENED)
+                cout << "Opened";
+            else
+                cout << "Closed | ";
+            cout << e->getDescription();
+
+            cout << endl;
+        }
+        cout << "Enter the election id : ";
+        cin >> id;
+        adminUser->openElection(id);
+        if (const Election *e = system.findElection(id))
+        {
+            cout << "ID: " << e->getElectionId()
+                 << " | Title: " << e->getTitle()
+                 << " | Status: ";
+
+            if (e->getStatus() == ElectionStatus::CREATED)
+                cout << "Created ---";
+            else if (e->getStatus() == ElectionStatus::OPENED)
+                cout << "Opened -- ";
+            else
+                cout << "Closed | ";
+            cout << e->getDescription();
+
+            cout << endl;
+        }
+        cout << "Enter the election id to CLOSE IT: ";
+        cin >> id;
+        adminUser->closeElection(id);
+        if (const Election *e = system.findElection(id))
+        {
+            cout << "ID: " << e->getElectionId()
+                 << " | Title: " << e->getTitle()
+                 << " | Status: ";
+
+            if (e->getStatus() == ElectionStatus::CREATED)
+                cout << "Created";
+            else if (e->getStatus() == ElectionStatus::OPENED)
+                cout << "Opened";
+            else
+                cout << "Closed | ";
+            cout << e->getDescription();
+
+            cout << endl;
+        }
+    }
+
+
+    TestCandidate(system);
+
+    return 0;
+}
+
+void testGuest(VotingSystem& system) // Mo3tasem, Ziad Tamer
+{
+    cout << "\n===== TEST: Guest View Elections =====\n";
+    Guest guest(&system);
+
+    cout << "\n===== TEST: Guest View Rules =====\n";
+    guest.viewVotingRules();
+
+    // Test view all elections
+    guest.viewElections();
+
+    cout << "\n===== TEST: Guest View Election Details (Election ID = 1) =====\n";
+    guest.viewElectionDetails(1);
+
+    cout << "\n===== TEST: Guest View Election Details (Invalid ID) =====\n";
+    guest.viewElectionDetails(999);
+
+    cout << "\n===== TEST: Guest View Candidates (Election ID = 1) =====\n";
+    guest.viewCandidates(1);
+
+    cout << "\n===== TEST: Guest View Candidates (Invalid Election ID) =====\n";
+    guest.viewCandidates(999);
+}
+
+
+void testVoter(VotingSystem& system)
+{
+    cout << "\n===== TEST: Voter Vote =====\n";
+    Voter *voter = system.findVoter(6);
+    Election *election = system.findElection(1);
+    if (!voter || !election)
+    {
+        cout << "Test data missing.\n";
+        return;
+    }
+
+    system.openElection(1);
+    voter->vote(1, 101);
+
+    cout << "\n===== TEST: Voter Double Vote (should be rejected) =====\n";
+    voter->vote(1, 102);
+    cout << "hasVoted(1): " << voter->hasVoted(1)
+         << ", hasVoted(2): " << voter->hasVoted(2) << endl;
+
+    cout << "\n===== TEST: Admin View Results =====\n";
+    Admin *admin = system.findAdmin(1001);
+    if (admin)
+    {
+        admin->viewResults(1);
+        admin->viewResults(2);
+        admin->auditElection(1);
+        admin->auditElection(2);
+    }
+
+    cout << "\n===== TEST: Voted Set Memory =====\n";
+    for (const Election &e : system.getElections())
+    {
+        cout << "Election " << e.getElectionId()
+             << ": " << e.getVoterCount() << " voters, "
+             << e.getVotedMemoryBytes() << " bytes" << endl;
+    }
+}
+
+void testConcurrentVoting()
+{
+    cout << "\n===== TEST: Concurrent Voting Stress =====\n";
+    const int voterCount = 50000;
+    const int candidateCount = 8;
+    const int threadCount = 4;
+
+    VotingSystem system;
+    system.setHashCost(1); // bulk users: hashing is covered by testCredentials
+    system.addElection(1, "Stress Election", "Concurrent ballots");
+    Election *election = system.findElection(1);
+    for (int c = 0; c < candidateCount; c++)
+        system.addCandidateToElection(1, 100000 + c);
+    for (int v = 1; v <= voterCount; v++)
+        system.addUser(Voter(v, "v" + to_string(v), "v" + to_string(v) + "@mail.com", "123", &system));
+    system.openElection(1);
+
+    // every thread tries every voter, so each voter races threadCount ballots
+    atomic<long long> accepted{0}, duplicates{0}, other{0};
+    vector<thread> workers;
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < threadCount; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            for (int v = 1; v <= voterCount; v++)
+            {
+                int voter = (v + t * 7919) % voterCount + 1; // each thread walks in a different order
+                VoteStatus status = system.castVote(1, voter, 100000 + (voter + t) % candidateCount);
+                if (status == VoteStatus::ACCEPTED)
+                    accepted++;
+                else if (status == VoteStatus::ALREADY_VOTED)
+                    duplicates++;
+                else
+                    other++;
+            }
+        });
+    }
+    for (thread &w : workers)
+        w.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // every voter exactly once, ids 1..voterCount with no gaps or repeats
+    vector<Vote> votes = system.getVotes();
+    vector<char> seenVoter(voterCount + 1, 0);
+    bool idsOk = votes.size() == (size_t)voterCount;
+    bool votersOk = true;
+    for (size_t i = 0; i < votes.size(); i++)
+    {
+        if (votes[i].getVoteId() != (int)i + 1)
+            idsOk = false;
+        if (seenVoter[votes[i].getVoterId()]++)
+            votersOk = false;
+    }
+    bool talliesOk = election->getTotalVotes() == voterCount &&
+                     election->getVoterCount() == (size_t)voterCount;
+
+    cout << "Accepted: " << accepted << ", duplicates rejected: " << duplicates
+         << ", other: " << other << " (" << seconds << " s)\n";
+    cout << "Vote ids: " << (idsOk ? "OK" : "FAIL")
+         << " | One vote per voter: " << (votersOk ? "OK" : "FAIL")
+         << " | Tallies: " << (talliesOk ? "OK" : "FAIL") << endl;
+    cout << ((accepted == voterCount && duplicates == (long long)voterCount * (threadCount - 1) &&
+              other == 0 && idsOk && votersOk && talliesOk)
+                 ? "PASS\n"
+                 : "FAIL\n");
+
+    cout << "\n===== TEST: ingestVotes Scaling =====\n";
+    vector<Ballot> ballots;
+    ballots.reserve(voterCount);
+    for (int v = 1; v <= voterCount; v++)
+        ballots.push_back({1, v, 100000 + v % candidateCount});
+    for (int threads = 1; threads <= 8; threads *= 2)
+    {
+        // fresh election each round so every ballot is new
+        int electionId = 1 + threads;
+        system.addElection(electionId, "Scaling", "");
+        for (int c = 0; c < candidateCount; c++)
+            system.addCandidateToElection(electionId, 100000 + c);
+        system.openElection(electionId);
+        for (Ballot &b : ballots)
+            b.electionId = electionId;
+
+        auto t0 = chrono::steady_clock::now();
+        IngestReport report = system.ingestVotes(ballots, threads);
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        cout << "threads=" << threads << ": " << report.accepted << " accepted, "
+             << (long long)(report.accepted / secs) << " votes/s\n";
+    }
+}
+
+void testWriteAheadLog()
+{
+    cout << "\n===== TEST: Write-Ahead Log Replay =====\n";
+    const string path = "test_votes.wal";
+    const int voterCount = 2000;
+    const int threadCount = 4;
+    remove(path.c_str());
+
+    vector<long long> expected;
+    size_t stored = 0;
+    uint64_t records = 0, fsyncs = 0;
+    {
+        VotingSystem system;
+        system.setHashCost(1);
+        system.openLog(path);
+        system.addElection(1, "Logged Election", "Survives a restart");
+        for (int c = 1; c <= 3; c++)
+            system.addCandidateToElection(1, 500 + c);
+        for (int v = 1; v <= voterCount; v++)
+            system.addUser(Voter(v, "v" + to_string(v), "v" + to_string(v) + "@mail.com", "123", &system));
+        system.openElection(1);
+
+        vector<thread> workers;
+        for (int t = 0; t < threadCount; t++)
+        {
+            workers.emplace_back([&system, t]()
+            {
+                for (int v = 1 + t; v <= voterCount; v += threadCount)
+                    system.castVote(1, v, 501 + v % 3);
+            });
+        }
+        // candidate 503 comes and goes mid-vote: replay must count exactly what was counted live
+        workers.emplace_back([&system]()
+        {
+            for (int i = 0; i < 50; i++)
+            {
+                system.removeCandidateFromElection(1, 503);
+                system.addCandidateToElection(1, 503);
             }
+        });
+        for (thread &w : workers)
+            w.join();
+        system.closeElection(1);
+
+        for (int c = 1; c <= 3; c++)
+            expected.push_back(system.findElection(1)->getVoteCount(500 + c));
+        stored = system.getVoteCount();
+        records = system.getLog()->getRecordCount();
+        fsyncs = system.getLog()->getFsyncCount();
+    }
+    cout << "Records: " << records << ", fsyncs: " << fsyncs << endl;
+
+    // a crash in the middle of a write leaves half a record at the end
+    FILE *f = fopen(path.c_str(), "ab");
+    if (f)
+    {
+        fwrite("\x30\x00\x00\x00garbage", 1, 11, f);
+        fclose(f);
+    }
+
+    VotingSystem restored;
+    bool replayed = restored.openLog(path);
+    Election *e = restored.findElection(1);
+    bool ok = replayed && e && e->getStatus() == ElectionStatus::CLOSED &&
+              restored.getVoteCount() == stored;
+    for (int c = 1; ok && c <= 3; c++)
+        ok = e->getVoteCount(500 + c) == expected[c - 1];
+    cout << (ok ? "PASS\n" : "FAIL\n");
+
+    remove(path.c_str());
+}
+
+void testSnapshot()
+{
+    cout << "\n===== TEST: Snapshot + Log Tail Replay =====\n";
+    const string logFile = "test_snapshot.wal";
+    const string snapFile = "test_snapshot.snap";
+    const int voterCount = 20000;
+    remove(logFile.c_str());
+    remove(snapFile.c_str());
+
+    vector<long long> expected;
+    {
+        VotingSystem system;
+        system.setHashCost(1);
+        system.openLog(logFile, snapFile);
+        system.addElection(1, "Snapshot Election", "Most votes before the snapshot");
+        for (int c = 1; c <= 4; c++)
+            system.addCandidateToElection(1, 700 + c);
+        for (int v = 1; v <= voterCount; v++)
+            system.addUser(Voter(v, "v" + to_string(v), "v" + to_string(v) + "@mail.com", "123", &system));
+        system.openElection(1);
+
+        vector<Ballot> ballots;
+        for (int v = 1; v <= voterCount - 100; v++)
+            ballots.push_back({1, v, 701 + v % 4});
+        system.ingestVotes(ballots, 4);
+        system.writeSnapshot();
+
+        // these only live in the log tail
+        for (int v = voterCount - 99; v <= voterCount; v++)
+            system.castVote(1, v, 701);
+
+        for (int c = 1; c <= 4; c++)
+            expected.push_back(system.findElection(1)->getVoteCount(700 + c));
+    }
+
+    VotingSystem restored;
+    restored.openLog(logFile, snapFile);
+    const StartupStats &stats = restored.getStartupStats();
+    cout << "Snapshot: " << stats.snapshotUsers << " users, " << stats.snapshotVotes
+         << " votes in " << stats.snapshotMs << " ms; tail: " << stats.replayedRecords
+         << " records in " << stats.replayMs << " ms\n";
+
+    Election *e = restored.findElection(1);
+    bool ok = e && e->isOpen() && stats.replayedRecords == 100 &&
+              restored.getVoteCount() == (size_t)voterCount &&
+              e->getVoterCount() == (size_t)voterCount && e->hasVoted(1);
+    for (int c = 1; ok && c <= 4; c++)
+        ok = e->getVoteCount(700 + c) == expected[c - 1];
+
+    // the next vote id carries on after the restored ones
+    restored.addUser(Voter(voterCount + 1, "late", "late@mail.com", "123", &restored));
+    restored.castVote(1, voterCount + 1, 701);
+    Vote last(0, 0, 0, 0);
+    ok = ok && restored.findVote(voterCount + 1, last) && last.getVoterId() == voterCount + 1;
+
+    // an election status outside the enum marks the file corrupt: none of it is loaded
+    const string corruptLog = "test_snapshot_corrupt.wal";
+    {
+        ifstream in(snapFile, ios::binary);
+        string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        SnapshotHeader header{};
+        int32_t badStatus = 7;
+        if (bytes.size() >= sizeof header)
+            memcpy(&header, bytes.data(), sizeof header);
+        ok = ok && header.electionCount > 0;
+        if (ok)
+        {
+            memcpy(&bytes[header.electionOffset + offsetof(SnapshotElection, status)], &badStatus, sizeof badStatus);
+            ofstream(snapFile, ios::binary | ios::trunc).write(bytes.data(), bytes.size());
+        }
+    }
+    VotingSystem corrupt;
+    corrupt.openLog(corruptLog, snapFile);
+    ok = ok && !corrupt.findElection(1) && corrupt.getStartupStats().snapshotUsers == 0;
+    cout << (ok ? "PASS\n" : "FAIL\n");
+
+    remove(logFile.c_str());
+    remove(snapFile.c_str());
+    remove(corruptLog.c_str());
+}
+
+void testVoteStore()
+{
+    cout << "\n===== TEST: Columnar Vote Store =====\n";
+    const int voterCount = 100000;
+    VotingSystem system;
+    system.setHashCost(1);
+    for (int id = 1; id <= 2; id++)
+    {
+        system.addElection(id, "Columns", "");
+        for (int c = 1; c <= 5; c++)
+            system.addCandidateToElection(id, id * 10 + c);
+        system.openElection(id);
+    }
+    for (int v = 1; v <= voterCount; v++)
+        system.addUser(Voter(v, "v" + to_string(v), "v" + to_string(v) + "@mail.com", "123", &system));
+
+    vector<Ballot> ballots;
+    for (int v = 1; v <= voterCount; v++)
+        ballots.push_back({1 + v % 2, v, (1 + v % 2) * 10 + 1 + v % 5});
+    system.ingestVotes(ballots, 4);
+
+    size_t votes = system.getVoteCount();
+    cout << "Column store: " << (double)system.getVoteStoreBytes() / votes << " bytes/vote\n";
+
+    bool ok = votes == (size_t)voterCount;
+    for (int id = 1; id <= 2; id++)
+    {
+        PackedBallots packed = system.packElection(id);
+        cout << "Election " << id << " packed: " << packed.size() << " ballots, "
+             << (double)packed.memoryBytes() / packed.size() << " bytes/ballot\n";
+
+        // decoding the packed copy must give back the live tallies
+        unordered_map<int, long long> counts;
+        int previous = 0;
+        packed.forEach([&](int voterId, int candidateId)
+        {
+            ok = ok && voterId > previous;
+            previous = voterId;
+            counts[candidateId]++;
+        });
+        const Election *e = system.findElection(id);
+        for (int candidateId : e->copyCandidates())
+            ok = ok && counts[candidateId] == e->getVoteCount(candidateId);
+    }
+
+    Vote v(0, 0, 0, 0);
+    ok = ok && system.findVote(4242, v) && v.getVoteId() == 4242 && !system.findVote(voterCount + 1, v);
+    cout << (ok ? "PASS\n" : "FAIL\n");
+}
+
+void benchRecount(size_t voteCount)
+{
+    cout << "\n===== BENCH: Recount " << voteCount << " ballots =====\n";
+    const int electionCount = 4;
+    const int candidatesPerElection = 5;
+
+    // only the two columns a recount reads
+    vector<int> electionIds(voteCount), candidateIds(voteCount);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < voteCount; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        int election = 1 + (seed >> 8) % electionCount;
+        electionIds[i] = election;
+        candidateIds[i] = election * 100 + 1 + (seed >> 20) % candidatesPerElection;
+    }
+    const int target = 2;
+    vector<int> candidates;
+    for (int c = 1; c <= candidatesPerElection; c++)
+        candidates.push_back(target * 100 + c);
+
+    auto report = [&](const char *name, double seconds, const vector<long long> &counts)
+    {
+        long long total = 0;
+        for (long long c : counts)
+            total += c;
+        cout << name << ": " << seconds * 1000 << " ms, "
+             << (long long)(voteCount / seconds / 1e6) << " M ballots/s (counted " << total << ")\n";
+    };
+
+    // the loop Candidate::viewVoteCount used to run, once per candidate
+    vector<long long> baseline(candidates.size(), 0);
+    auto t0 = chrono::steady_clock::now();
+    for (size_t k = 0; k < candidates.size(); k++)
+    {
+        int count = 0;
+        for (size_t i = 0; i < voteCount; i++)
+        {
+            if (electionIds[i] == target && candidateIds[i] == candidates[k])
+                count++;
         }
+        baseline[k] = count;
+    }
+    report("viewVoteCount loop", chrono::duration<double>(chrono::steady_clock::now() - t0).count(), baseline);
+
+    bool ok = true;
+    for (RecountKernel kernel : {RecountKernel::SCALAR, RecountKernel::SSE2, RecountKernel::AVX2})
+    {
+        if ((int)kernel > (int)bestRecountKernel())
+            continue; // not supported on this CPU
+        vector<long long> counts(candidates.size(), 0);
+        auto start = chrono::steady_clock::now();
+        recountColumns(kernel, electionIds.data(), candidateIds.data(), voteCount, target, candidates, counts.data());
+        report(recountKernelName(kernel), chrono::duration<double>(chrono::steady_clock::now() - start).count(), counts);
+        ok = ok && counts == baseline;
+    }
+    cout << (ok ? "All kernels agree.\n" : "KERNELS DISAGREE\n");
+}
+
+// --import: loads a ballot file into the persistent system and reports on it.
+int importBallotFile(VotingSystem &system, const string &path)
+{
+    auto start = chrono::steady_clock::now();
+    BallotFile file;
+    if (!readBallotFile(path, file))
+    {
+        cout << "Cannot read " << path << endl;
+        return 1;
+    }
+    double parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Parsed " << file.ballots.size() << " ballots in " << parseSeconds * 1000 << " ms ("
+         << (long long)(file.ballots.size() / max(parseSeconds, 1e-9)) << " ballots/s), "
+         << file.malformed.size() << " malformed\n";
+    for (size_t i = 0; i < file.malformed.size() && i < 20; i++)
+        cout << "  line/record " << file.malformed[i] << ": malformed\n";
+
+    ImportReport report = system.importBallots(file.ballots);
+    cout << "Imported " << report.accepted << " ballots in " << report.seconds * 1000 << " ms ("
+         << (long long)(file.ballots.size() / max(report.seconds, 1e-9)) << " ballots/s), "
+         << report.rejections.size() << " rejected" << (report.durable ? "" : ", NOT DURABLE") << "\n";
+
+    long long byStatus[(int)VoteStatus::NOT_DURABLE + 1] = {};
+    for (const ImportRejection &r : report.rejections)
+        byStatus[(int)r.status]++;
+    for (int s = 0; s <= (int)VoteStatus::NOT_DURABLE; s++)
+    {
+        if (byStatus[s])
+            cout << "  " << voteStatusName((VoteStatus)s) << ": " << byStatus[s] << "\n";
+    }
+    for (size_t i = 0; i < report.rejections.size() && i < 20; i++)
+    {
+        cout << "  line/record " << file.sources[report.rejections[i].row] << ": "
+             << voteStatusName(report.rejections[i].status) << "\n";
+    }
+    return report.durable ? 0 : 1;
+}
 
-        if (exists)
-            continue;
+// --import-roster: adds the users of a roster file to the persistent system.
+int importRosterFile(VotingSystem &system, const string &path)
+{
+    RosterReport report = system.importRoster(path);
+    if (!report.readable)
+    {
+        cout << "Cannot read " << path << endl;
+        return 1;
+    }
+    cout << "Added " << report.added << " users in " << report.seconds * 1000 << " ms, "
+         << report.duplicates.size() << " duplicates, " << report.malformed.size() << " malformed"
+         << (report.durable ? "" : ", NOT DURABLE") << "\n";
+    for (size_t i = 0; i < report.duplicates.size() && i < 20; i++)
+        cout << "  line " << report.duplicates[i] << ": id, username or email already taken\n";
+    for (size_t i = 0; i < report.malformed.size() && i < 20; i++)
+        cout << "  line " << report.malformed[i] << ": malformed\n";
+    return report.durable ? 0 : 1;
+}
 
-        cout << "Enter email: ";
-        cin >> inputEmail;
+void testCredentials()
+{
+    cout << "\n===== TEST: Hashed Credentials and Sessions =====\n";
+    auto hex = [](const uint8_t *bytes, size_t size)
+    {
+        string out;
+        appendHex(out, bytes, size);
+        return out;
+    };
+    uint8_t digest[32];
+    Sha256 sha;
+    sha.update("abc", 3);
+    sha.finish(digest);
+    bool ok = hex(digest, 32) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    // RFC 7914 section 11 style vectors for PBKDF2-HMAC-SHA256
+    pbkdf2Sha256("password", (const uint8_t *)"salt", 4, 1, digest);
+    ok = ok && hex(digest, 32) == "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b";
+    pbkdf2Sha256("password", (const uint8_t *)"salt", 4, 4096, digest);
+    ok = ok && hex(digest, 32) == "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a";
+
+    PasswordHash first = PasswordHash::create("secret", 50), second = PasswordHash::create("secret", 50), decoded;
+    ok = ok && first.matches("secret") && !first.matches("secreT") && !first.matches("");
+    ok = ok && memcmp(first.salt, second.salt, sizeof(first.salt)) != 0; // same password, different hash
+    ok = ok && PasswordHash::decode(first.encode(), decoded) && decoded.matches("secret") && decoded.cost == 50;
+    ok = ok && !PasswordHash::decode("secret", decoded) && !PasswordHash::decode("pbkdf2-sha256$0$00$00", decoded);
+
+    // only the hash reaches the log, and it survives a restart
+    string path = (filesystem::temp_directory_path() / "vs_test_credentials.wal").string();
+    filesystem::remove(path);
+    {
+        VotingSystem system;
+        system.setHashCost(100);
+        system.openLog(path);
+        VotingService service(system);
+        service.registerUser(UserRole::VOTER, 7, "vic", "vic@mail.com", "hunter22");
+        User *user = system.findUser(7);
+        ok = ok && user->getPassword().empty() && user->getCredential().cost == 100;
+    }
+    {
+        ifstream in(path, ios::binary);
+        string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        ok = ok && bytes.find("hunter22") == string::npos && bytes.find("pbkdf2-sha256$100$") != string::npos;
+    }
+    {
+        VotingSystem system;
+        system.openLog(path);
+        VotingService service(system);
+        User *user = nullptr;
+        ok = ok && service.login("vic", "hunter22", user) == ServiceStatus::OK && user->getUserId() == 7;
+        ok = ok && service.login("vic", "hunter2", user) == ServiceStatus::BAD_CREDENTIALS;
+        ok = ok && service.login("nobody", "hunter22", user) == ServiceStatus::BAD_CREDENTIALS;
+        ok = ok && system.findUser(7)->getCredential().cost == 100; // replay does not re-hash
+    }
+    filesystem::remove(path);
 
-        if (inputEmail.empty())
+    // sessions: a token stands in for the password until it is revoked or expires
+    VotingSystem system;
+    system.setHashCost(1);
+    VotingService service(system);
+    service.registerUser(UserRole::VOTER, 3, "vera", "vera@mail.com", "pw");
+    service.registerUser(UserRole::CANDIDATE, 2, "cara", "cara@mail.com", "pw");
+    service.createElection(10, "Board", "");
+    service.addCandidate(10, 2);
+    service.openElection(10);
+    User *user = nullptr;
+    SessionToken voter, candidate, parsed;
+    ok = ok && service.startSession("vera", "nope", user, voter) == ServiceStatus::BAD_CREDENTIALS && voter.empty();
+    ok = ok && service.startSession("vera", "pw", user, voter) == ServiceStatus::OK && !voter.empty();
+    ok = ok && service.startSession("cara", "pw", user, candidate) == ServiceStatus::OK;
+    ok = ok && SessionToken::parse(voter.toString(), parsed) && parsed == voter && service.resolveSession(parsed) == system.findUser(3);
+    ok = ok && service.castVote(candidate, 10, 2) == VoteStatus::VOTER_NOT_ALLOWED;
+    ok = ok && service.castVote(SessionToken{1, 2}, 10, 2) == VoteStatus::VOTER_NOT_ALLOWED;
+    ok = ok && service.castVote(voter, 10, 2) == VoteStatus::ACCEPTED;
+    service.endSession(voter);
+    ok = ok && !service.resolveSession(voter) && service.castVote(voter, 10, 2) == VoteStatus::VOTER_NOT_ALLOWED;
+    system.getSessions().setLifetime(chrono::milliseconds(0));
+    ok = ok && service.startSession("vera", "pw", user, voter) == ServiceStatus::OK && !service.resolveSession(voter);
+    cout << (ok ? "PASS\n" : "FAIL\n");
+}
+
+// Builds the username index at cost 1, then adds a sample of users hashed at `cost`
+// and times logins against them, plus the session path that replaces re-authentication.
+void benchLogin(size_t userCount, uint32_t cost)
+{
+    cout << "\n===== BENCH: Login, " << userCount << " users, hash cost " << cost << " =====\n";
+    VotingSystem system;
+    VotingService service(system);
+    system.setHashCost(1);
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 1; i <= userCount; i++)
+        service.registerUser(UserRole::VOTER, (int)i, "v" + to_string(i), "v" + to_string(i) + "@mail.com", "pw");
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "register at cost 1: " << (long long)(userCount / seconds) << " users/s\n";
+
+    auto timeLogins = [&](const char *name, size_t firstId, size_t count, size_t spread)
+    {
+        uint32_t seed = 99;
+        User *user = nullptr;
+        size_t accepted = 0;
+        auto begin = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++)
         {
-            cout << "Email cannot be empty." << endl;
-            continue;
+            seed = seed * 1664525u + 1013904223u;
+            size_t id = firstId + seed % spread;
+            accepted += service.login("v" + to_string(id), "pw", user) == ServiceStatus::OK;
         }
-        for (User *user : system->getUsers())
+        double took = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        cout << name << ": " << (long long)(count / took) << " logins/s, " << took / count * 1e6 << " us each"
+             << (accepted == count ? "" : " (FAILED LOGINS)") << "\n";
+    };
+    timeLogins("login at cost 1", 1, 200000, userCount);
+
+    // the sampled users are hashed at the benchmark cost
+    size_t sample = max<size_t>(1, min<size_t>(2000, 20000000 / max(cost, 1u)));
+    system.setHashCost(cost);
+    start = chrono::steady_clock::now();
+    for (size_t i = userCount + 1; i <= userCount + sample; i++)
+        service.registerUser(UserRole::VOTER, (int)i, "v" + to_string(i), "v" + to_string(i) + "@mail.com", "pw");
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "register at cost " << cost << ": " << (long long)(sample / seconds) << " users/s\n";
+    string name = "login at cost " + to_string(cost);
+    timeLogins(name.c_str(), userCount + 1, sample, sample);
+
+    // votes on a session token skip the hash entirely
+    service.registerUser(UserRole::CANDIDATE, (int)(userCount + sample + 1), "cand", "cand@mail.com", "pw");
+    const int elections = 200000;
+    for (int e = 1; e <= elections; e++)
+    {
+        service.createElection(e, "E", "");
+        service.addCandidate(e, (int)(userCount + sample + 1));
+        service.openElection(e);
+    }
+    User *user = nullptr;
+    SessionToken token;
+    service.startSession("v" + to_string(userCount + 1), "pw", user, token);
+    start = chrono::steady_clock::now();
+    size_t resolved = 0;
+    for (int i = 0; i < 1000000; i++)
+        resolved += service.resolveSession(token) != nullptr;
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "session check: " << (long long)(resolved / seconds) << " /s\n";
+    start = chrono::steady_clock::now();
+    size_t accepted = 0;
+    for (int e = 1; e <= elections; e++)
+        accepted += service.castVote(token, e, (int)(userCount + sample + 1)) == VoteStatus::ACCEPTED;
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "castVote on a session: " << (long long)(accepted / seconds) << " votes/s\n";
+}
+
+/* ---------- Benchmark suite ---------- */
+// Non-interactive timings of the core operations on synthetic data, one JSON
+// object per line so runs can be diffed or checked against a saved baseline.
+struct SuiteOptions
+{
+    int voters = 200000;
+    int elections = 100;
+    int candidates = 8; // per election
+    double ballotsPerVoter = 5; // mean
+    int threads = 0; // 0 = one per hardware thread
+    uint32_t hashCost = 1;
+    int repeats = 3;
+    uint32_t seed = 1;
+    string outPath; // empty = stdout
+    string baselinePath;
+    double tolerance = 0.25; // allowed slowdown against the baseline
+    string metricsPath; // latency histograms of the whole run, needs a VS_METRICS build
+};
+
+struct SuiteResult
+{
+    string name;
+    long long ops = 0;
+    vector<double> rates; // ops per second, one per repeat
+};
+
+// fn returns how many operations it did
+static void timeOperation(vector<SuiteResult> &results, const string &name, const function<long long()> &fn)
+{
+    auto start = chrono::steady_clock::now();
+    long long ops = fn();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    auto it = find_if(results.begin(), results.end(), [&](const SuiteResult &r) { return r.name == name; });
+    if (it == results.end())
+        it = results.insert(results.end(), SuiteResult{name, ops, {}});
+    it->rates.push_back(ops / max(seconds, 1e-9));
+    cerr << "  " << name << ": " << (long long)(ops / max(seconds, 1e-9)) << " ops/s\n";
+}
+
+static void runSuiteOnce(const SuiteOptions &options, vector<SuiteResult> &results)
+{
+    VotingSystem system;
+    VotingService service(system);
+    ThreadPool pool(options.threads);
+    SyntheticConfig config;
+    config.seed = options.seed;
+    config.voters = options.voters;
+    config.elections = options.elections;
+    config.candidatesPerElection = options.candidates;
+    config.ballotsPerVoter = options.ballotsPerVoter;
+    config.hashCost = options.hashCost;
+    SyntheticGenerator generator(config, system);
+    uint32_t seed = options.seed;
+    auto nextRandom = [&]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    SyntheticReport report;
+    timeOperation(results, "generate_users", [&]
+    {
+        generator.addUsersAndElections(system, pool, report);
+        return report.users;
+    });
+    vector<Ballot> ballots;
+    timeOperation(results, "generate_ballots", [&]
+    {
+        ballots = generator.makeBallots(pool);
+        return (long long)ballots.size();
+    });
+    size_t half = ballots.size() / 2;
+    vector<Ballot> serial(ballots.begin(), ballots.begin() + half), parallel(ballots.begin() + half, ballots.end());
+
+    timeOperation(results, "cast_vote", [&]
+    {
+        for (const Ballot &b : serial)
+            service.castVote(b.voterId, b.electionId, b.candidateId);
+        return (long long)serial.size();
+    });
+    timeOperation(results, "cast_vote_parallel", [&]
+    {
+        system.ingestVotes(parallel, pool.size());
+        return (long long)parallel.size();
+    });
+    long long duplicates = 0;
+    timeOperation(results, "duplicate_detection", [&]
+    {
+        for (const Ballot &b : ballots)
+            duplicates += service.castVote(b.voterId, b.electionId, b.candidateId) == VoteStatus::ALREADY_VOTED;
+        return (long long)ballots.size();
+    });
+    if (duplicates != (long long)ballots.size())
+        cerr << "  duplicate_detection: only " << duplicates << " of " << ballots.size() << " rejected\n";
+
+    timeOperation(results, "tally_live", [&]
+    {
+        ElectionResults out;
+        const int passes = max(1, 200000 / options.elections);
+        for (int pass = 0; pass < passes; pass++)
+            for (int e = 0; e < options.elections; e++)
+                service.getResults(generator.firstElection() + e, out);
+        return (long long)passes * options.elections;
+    });
+    timeOperation(results, "candidate_listing", [&]
+    {
+        vector<CandidateInfo> candidates;
+        for (int i = 0; i < 200000; i++)
         {
-            if (user->getEmail() == inputEmail)
-            {
-                cout << "Email already registered." << endl;
-                exists = true;
-                break;
-            }
+            candidates.clear();
+            service.listCandidates(generator.firstElection() + (int)(nextRandom() % options.elections), candidates);
         }
-        if (exists)
+        return 200000LL;
+    });
+    timeOperation(results, "login", [&]
+    {
+        int logins = max(1, min(200000, (int)(2000000 / options.hashCost)));
+        User *user;
+        for (int i = 0; i < logins; i++)
+            service.login("voter" + to_string(generator.firstVoter() + nextRandom() % options.voters), config.password,
+                          user);
+        return (long long)logins;
+    });
+    User *user = nullptr;
+    SessionToken token;
+    service.startSession("voter" + to_string(generator.firstVoter()), config.password, user, token);
+    timeOperation(results, "session_check", [&]
+    {
+        for (int i = 0; i < 1000000; i++)
+            service.resolveSession(token);
+        return 1000000LL;
+    });
+
+    for (int e = 0; e < options.elections; e++)
+        service.closeElection(generator.firstElection() + e);
+    timeOperation(results, "tally_closed_recount", [&]
+    {
+        system.computeClosedResults(pool);
+        return (long long)ballots.size();
+    });
+}
+
+// Pulls "benchmark" and "ops_per_sec" back out of lines this suite wrote.
+static map<string, double> readSuiteBaseline(const string &path)
+{
+    map<string, double> rates;
+    ifstream in(path);
+    string line;
+    while (getline(in, line))
+    {
+        size_t name = line.find("\"benchmark\":\"");
+        size_t rate = line.find("\"ops_per_sec\":");
+        if (name == string::npos || rate == string::npos)
             continue;
+        name += 13;
+        rates[line.substr(name, line.find('"', name) - name)] = atof(line.c_str() + rate + 14);
+    }
+    return rates;
+}
 
-        cout << "Enter password: ";
-        cin >> inputPassword;
-        if (inputPassword.empty())
+int runBenchmarkSuite(int argc, char *argv[])
+{
+    SuiteOptions options;
+    for (int i = 0; i < argc; i++)
+    {
+        string flag = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
         {
-            cout << "Password cannot be empty." << endl;
-            continue;
+            cerr << "Missing value for " << flag << "\n";
+            return 2;
+        }
+        if (flag == "--voters")
+            options.voters = max(1, atoi(value));
+        else if (flag == "--elections")
+            options.elections = max(1, atoi(value));
+        else if (flag == "--candidates")
+            options.candidates = max(1, atoi(value));
+        else if (flag == "--ballots-per-voter")
+            options.ballotsPerVoter = max(0.0, atof(value));
+        else if (flag == "--threads")
+            options.threads = max(0, atoi(value));
+        else if (flag == "--hash-cost")
+            options.hashCost = (uint32_t)max(1, atoi(value));
+        else if (flag == "--repeat")
+            options.repeats = max(1, atoi(value));
+        else if (flag == "--seed")
+            options.seed = (uint32_t)strtoul(value, nullptr, 10);
+        else if (flag == "--out")
+            options.outPath = value;
+        else if (flag == "--baseline")
+            options.baselinePath = value;
+        else if (flag == "--tolerance")
+            options.tolerance = atof(value);
+        else if (flag == "--metrics")
+            options.metricsPath = value;
+        else
+        {
+            cerr << "Unknown option " << flag << "\n"
+                 << "Options: --voters --elections --candidates --ballots-per-voter --threads --hash-cost "
+                    "--repeat --seed --out FILE --baseline FILE --tolerance FRACTION --metrics FILE\n";
+            return 2;
         }
+        i++;
+    }
 
-        exists = false;
-        // navigation to menu will be added later
+    vector<SuiteResult> results;
+    resetMetrics();
+    for (int r = 0; r < options.repeats; r++)
+    {
+        cerr << "repeat " << r + 1 << "/" << options.repeats << "\n";
+        runSuiteOnce(options, results);
+    }
+    if (!options.metricsPath.empty())
+    {
+        if (!exportMetrics(options.metricsPath))
+            cerr << "Cannot write " << options.metricsPath << "\n";
+        else if (!VS_METRICS)
+            cerr << "Metrics are compiled out of this build, rebuild with VS_METRICS=1\n";
+    }
 
-        break; // exit loop on successful registration
+    ofstream file;
+    if (!options.outPath.empty())
+        file.open(options.outPath);
+    ostream &out = options.outPath.empty() ? cout : file;
+    int threadCount = ThreadPool(options.threads).size();
+    for (SuiteResult &result : results)
+    {
+        sort(result.rates.begin(), result.rates.end());
+        double median = result.rates[result.rates.size() / 2];
+        out << "{\"benchmark\":\"" << result.name << "\",\"ops\":" << result.ops << ",\"ops_per_sec\":"
+            << (long long)median << ",\"ns_per_op\":" << 1e9 / median << ",\"best\":" << (long long)result.rates.back()
+            << ",\"worst\":" << (long long)result.rates.front() << ",\"repeats\":" << result.rates.size()
+            << ",\"voters\":" << options.voters << ",\"elections\":" << options.elections
+            << ",\"candidates\":" << options.candidates << ",\"threads\":" << threadCount
+            << ",\"hash_cost\":" << options.hashCost << "}\n";
+    }
 
-    } while (true);
+    if (options.baselinePath.empty())
+        return 0;
+    map<string, double> baseline = readSuiteBaseline(options.baselinePath);
+    int regressions = 0;
+    for (const SuiteResult &result : results)
+    {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0)
+            continue;
+        double ratio = result.rates[result.rates.size() / 2] / it->second;
+        bool slower = ratio < 1 - options.tolerance;
+        regressions += slower;
+        cerr << (slower ? "REGRESSION " : "ok         ") << result.name << ": " << ratio * 100 << "% of baseline\n";
+    }
+    return regressions ? 1 : 0;
+}
 
-    // Registration logic (e.g., saving to database) will be added later
-    cout << "Registration successful!" << endl;
-    username = inputUsername;
-    email = inputEmail;
-    password = inputPassword;
-    system->getUsers().push_back(this); // add user to list of users
+// Order-sensitive hash of every tally, to compare two generated datasets.
+static uint64_t tallyFingerprint(const VotingSystem &system)
+{
+    uint64_t hash = 1469598103934665603ull;
+    system.forEachElection([&](const Election &e)
+    {
+        e.forEachTally([&](int candidateId, long long votes)
+        {
+            for (uint64_t value : {(uint64_t)e.getElectionId(), (uint64_t)candidateId, (uint64_t)votes,
+                                   (uint64_t)e.getStatus()})
+                hash = (hash ^ value) * 1099511628211ull;
+        });
+    });
+    return hash;
 }
 
-void User::logout()
+void testSyntheticData()
 {
-    cout << "Logged out successfully." << endl;
-    // Navigation to main menu will be added later
+    cout << "\n===== TEST: Synthetic Data Generator =====\n";
+    SyntheticConfig config;
+    config.seed = 42;
+    config.voters = 40000;
+    config.elections = 60;
+    config.closedFraction = 0.5;
+    config.firstUserId = 1; // fixed, so a second generator below maps ids the same way
+    config.firstElectionId = 1;
+
+    auto build = [&](VotingSystem &system, int threads)
+    {
+        ThreadPool pool(threads);
+        return SyntheticGenerator(config, system).populate(system, pool);
+    };
+    VotingSystem one, three;
+    SyntheticReport a = build(one, 1), b = build(three, 3);
+    bool ok = a.users == 40000 + 60 * 6 / 4 + 10 && a.elections == 60 && a.ballots == a.accepted && a.ballots == b.ballots;
+    ok = ok && tallyFingerprint(one) == tallyFingerprint(three) && one.getVoteCount() == (size_t)a.accepted;
+    double mean = (double)a.ballots / config.voters;
+    ok = ok && mean > 4.5 && mean < 5.5;
+
+    // popular elections draw far more ballots, and each has a clear favourite
+    vector<long long> turnout;
+    long long favourite = 0, leastFavoured = 0;
+    int closed = 0;
+    one.forEachElection([&](const Election &e)
+    {
+        turnout.push_back(e.getTotalVotes());
+        closed += e.getStatus() == ElectionStatus::CLOSED;
+    });
+    sort(turnout.begin(), turnout.end());
+    Election *busiest = nullptr;
+    one.forEachElection([&](const Election &e)
+    {
+        if (e.getTotalVotes() == turnout.back())
+            busiest = one.findElection(e.getElectionId());
+    });
+    vector<int> ranked;
+    SyntheticGenerator(config, one).electionCandidates(busiest->getElectionId() - 1, ranked);
+    favourite = busiest->getVoteCount(ranked.front());
+    leastFavoured = busiest->getVoteCount(ranked.back());
+    ok = ok && turnout.back() > 10 * turnout.front() && favourite > 2 * leastFavoured && closed == 30;
+
+    User *user = nullptr;
+    ok = ok && VotingService(one).login("voter1", "pw", user) == ServiceStatus::OK;
+
+    VotingSystem other;
+    config.seed = 43;
+    build(other, 1);
+    ok = ok && tallyFingerprint(other) != tallyFingerprint(one);
+    cout << (ok ? "PASS\n" : "FAIL\n");
 }
 
-///////////////////////////////
-/*Admin methods implementation */
-void Admin::addCandidate(int electionId, int candidateId)
+int generateDataset(int voters, int elections, double ballotsPerVoter, uint64_t seed)
 {
-    Election *targetElection = nullptr;
-    Candidate *targetCandidate = nullptr;
+    SyntheticConfig config;
+    config.voters = voters;
+    config.elections = elections;
+    config.ballotsPerVoter = ballotsPerVoter;
+    config.seed = seed;
+    VotingSystem system;
+    ThreadPool pool;
+    auto start = chrono::steady_clock::now();
+    SyntheticReport report = SyntheticGenerator(config, system).populate(system, pool);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Generated " << report.users << " users, " << report.elections << " elections and " << report.accepted
+         << " votes (of " << report.ballots << " ballots) in " << seconds << " s on " << pool.size() << " threads\n"
+         << "  users + elections " << report.userSeconds << " s, ballots " << report.ballotSeconds << " s, import "
+         << report.importSeconds << " s\n"
+         << "  fingerprint " << hex << tallyFingerprint(system) << dec << "\n";
+    return report.accepted == report.ballots ? 0 : 1;
+}
 
-    // 1 Find election
-    for (Election &e : system->getElections())
+// Skewed ranked ballots: candidates picked by Zipf popularity without repeats,
+// ranking lengths geometric around meanLength and capped at the candidate count.
+static vector<vector<int>> makeRankedBallots(const vector<int> &candidateIds, size_t count, double meanLength,
+                                             uint64_t seed)
+{
+    SplitMix64 rng(seed);
+    vector<double> cdf = zipfCdf((int)candidateIds.size(), 0.8);
+    vector<char> ranked(candidateIds.size());
+    vector<vector<int>> ballots(count);
+    for (vector<int> &ballot : ballots)
     {
-        if (e.getElectionId() == electionId)
+        size_t length = 1 + (size_t)(log(1 - rng.uniform()) / log(1 - 1 / max(meanLength, 1.0001)));
+        length = min(length, candidateIds.size());
+        fill(ranked.begin(), ranked.end(), 0);
+        ballot.reserve(length);
+        while (ballot.size() < length)
         {
-            targetElection = &e;
-            break;
+            int pick = sampleCdf(cdf, rng.uniform());
+            for (int tries = 0; ranked[pick] && tries < 64; tries++)
+                pick = sampleCdf(cdf, rng.uniform());
+            while (ranked[pick]) // the popular ones are taken: next free one
+                pick = (pick + 1) % (int)candidateIds.size();
+            ranked[pick] = 1;
+            ballot.push_back(candidateIds[pick]);
         }
     }
+    return ballots;
+}
 
-    if (!targetElection)
-    {
-        cout << "Election with ID " << electionId << " not found.\n";
-        return;
-    }
+// Instant runoff the plain way, every ballot every round; the reference for the trie count.
+static RunoffResult naiveRunoff(const vector<int> &candidateIds, const vector<vector<int>> &ballots)
+{
+    RunoffResult result;
+    result.ballots = (long long)ballots.size();
+    size_t candidateCount = candidateIds.size();
+    vector<vector<int>> slots(ballots.size());
+    for (size_t b = 0; b < ballots.size(); b++)
+        for (int candidateId : ballots[b])
+        {
+            auto it = lower_bound(candidateIds.begin(), candidateIds.end(), candidateId);
+            if (it != candidateIds.end() && *it == candidateId)
+                slots[b].push_back((int)(it - candidateIds.begin()));
+        }
 
-    // 2 Find candidate in users
-    for (User *u : system->getUsers())
+    vector<char> continuing(candidateCount, 1);
+    vector<vector<long long>> history;
+    for (size_t remaining = candidateCount; remaining > 0; remaining--)
     {
-        if (u->getUserId() == candidateId)
+        vector<long long> counts(candidateCount, 0);
+        long long exhausted = 0, active = 0;
+        for (const vector<int> &ballot : slots)
+        {
+            auto it = find_if(ballot.begin(), ballot.end(), [&](int slot) { return continuing[slot]; });
+            if (it == ballot.end())
+                exhausted++;
+            else
+                counts[*it]++;
+        }
+        RunoffRound round{{}, exhausted, -1};
+        for (size_t slot = 0; slot < candidateCount; slot++)
+        {
+            if (continuing[slot])
+            {
+                round.counts.push_back({candidateIds[slot], counts[slot]});
+                active += counts[slot];
+            }
+        }
+        sort(round.counts.begin(), round.counts.end(),
+             [](const CandidateResult &a, const CandidateResult &b)
+             { return a.votes != b.votes ? a.votes > b.votes : a.candidateId < b.candidateId; });
+        history.push_back(counts);
+        if (active == 0 || remaining == 1 || round.counts[0].votes * 2 > active)
         {
-            targetCandidate = dynamic_cast<Candidate *>(u);
+            result.winner = active ? round.counts[0].candidateId : -1;
+            result.rounds.push_back(move(round));
             break;
         }
+        vector<size_t> tied;
+        for (size_t slot = 0; slot < candidateCount; slot++)
+        {
+            if (continuing[slot] && counts[slot] == round.counts.back().votes)
+                tied.push_back(slot);
+        }
+        for (size_t r = history.size() - 1; r-- > 0 && tied.size() > 1;)
+        {
+            long long least = history[r][tied[0]];
+            for (size_t slot : tied)
+                least = min(least, history[r][slot]);
+            tied.erase(remove_if(tied.begin(), tied.end(), [&](size_t slot) { return history[r][slot] != least; }),
+                       tied.end());
+        }
+        continuing[tied.back()] = 0;
+        round.eliminated = candidateIds[tied.back()];
+        result.rounds.push_back(move(round));
     }
+    return result;
+}
 
-    if (!targetCandidate)
+static bool sameRunoff(const RunoffResult &a, const RunoffResult &b)
+{
+    if (a.winner != b.winner || a.ballots != b.ballots || a.rounds.size() != b.rounds.size())
+        return false;
+    for (size_t r = 0; r < a.rounds.size(); r++)
     {
-        cout << "User is not a valid candidate or does not exist.\n";
-        return;
+        const RunoffRound &x = a.rounds[r], &y = b.rounds[r];
+        if (x.exhausted != y.exhausted || x.eliminated != y.eliminated || x.counts.size() != y.counts.size())
+            return false;
+        for (size_t c = 0; c < x.counts.size(); c++)
+        {
+            if (x.counts[c].candidateId != y.counts[c].candidateId || x.counts[c].votes != y.counts[c].votes)
+                return false;
+        }
     }
+    return true;
+}
 
-    // 3  Check if candidate already added
-    for (int cid : targetElection->getCandidates())
+void testRankedChoice()
+{
+    cout << "\n===== TEST: Ranked Choice / Instant Runoff =====\n";
+    // plurality would pick 1; once 3 drops out its ballots go to 2
+    Election small(1, "Runoff", "");
+    for (int c : {1, 2, 3})
+        small.addCandidate(c);
+    small.open();
+    int voter = 1;
+    for (int i = 0; i < 4; i++)
+        small.recordVote(voter++, 1); // single-choice ballots take part as rankings of one
+    for (int i = 0; i < 3; i++)
+        small.recordRankedVote(voter++, {2, 3});
+    for (int i = 0; i < 2; i++)
+        small.recordRankedVote(voter++, {3, 2});
+    small.recordRankedVote(voter++, {3}); // runs out once 3 is gone
+    RunoffResult runoff = small.runInstantRunoff();
+    // 2 and 3 tie for last with no earlier round to split them: the higher id goes
+    bool ok = runoff.winner == 2 && runoff.ballots == 10 && runoff.rounds.size() == 2 &&
+              runoff.rounds[0].eliminated == 3 && runoff.rounds[1].exhausted == 1 &&
+              runoff.rounds[1].counts[0].candidateId == 2 && runoff.rounds[1].counts[0].votes == 5;
+    ok = ok && small.getVoteCount(1) == 4 && small.getVoteCount(2) == 3 && small.getVoteCount(3) == 3;
+    ok = ok && small.recordRankedVote(voter, {}) == VoteStatus::INVALID_RANKING &&
+         small.recordRankedVote(voter, {1, 1}) == VoteStatus::INVALID_RANKING &&
+         small.recordRankedVote(voter, {1, 9}) == VoteStatus::CANDIDATE_NOT_FOUND &&
+         small.recordRankedVote(1, {2}) == VoteStatus::ALREADY_VOTED && !small.hasVoted(voter);
+    small.close();
+    ok = ok && small.recordRankedVote(voter, {1}) == VoteStatus::ELECTION_NOT_OPEN;
+
+    // random skewed ballots: the trie count matches counting every ballot every round
+    vector<int> candidates = {10, 11, 12, 13, 14, 15, 16, 17};
+    vector<vector<int>> ballots = makeRankedBallots(candidates, 30000, 2.5, 7);
+    Election big(2, "Random", "");
+    for (int c : candidates)
+        big.addCandidate(c);
+    big.open();
+    for (size_t b = 0; b < ballots.size(); b++)
+    {
+        VoteStatus status = ballots[b].size() == 1 && b % 2 ? big.recordVote((int)b + 1, ballots[b][0])
+                                                             : big.recordRankedVote((int)b + 1, ballots[b]);
+        ok = ok && status == VoteStatus::ACCEPTED;
+    }
+    RunoffResult trie = big.runInstantRunoff();
+    ok = ok && trie.rounds.size() > 1 && sameRunoff(trie, naiveRunoff(candidates, ballots));
+
+    // through the system: the rankings survive log replay and a snapshot
+    const string logFile = "test_ranked.wal", snapFile = "test_ranked.snap";
+    remove(logFile.c_str());
+    remove(snapFile.c_str());
+    RunoffResult expected;
     {
-        if (cid == candidateId)
+        VotingSystem system;
+        system.setHashCost(1);
+        system.openLog(logFile, snapFile);
+        VotingService service(system);
+        for (int v = 1; v <= 40; v++)
+            service.registerUser(UserRole::VOTER, v, "rv" + to_string(v), "rv" + to_string(v) + "@mail.com", "pw");
+        for (int c = 101; c <= 104; c++)
+            service.registerUser(UserRole::CANDIDATE, c, "rc" + to_string(c), "rc" + to_string(c) + "@mail.com", "pw");
+        service.createElection(5, "Club", "Ranked");
+        for (int c = 101; c <= 104; c++)
+            service.addCandidate(5, c);
+        service.openElection(5);
+        vector<vector<int>> clubBallots = makeRankedBallots({101, 102, 103, 104}, 40, 2, 3);
+        for (int v = 1; v <= 20; v++)
+            ok = ok && service.castRankedVote(v, 5, clubBallots[v - 1]) == VoteStatus::ACCEPTED;
+        ok = ok && service.castRankedVote(1, 5, {101}) == VoteStatus::ALREADY_VOTED &&
+             service.castRankedVote(999, 5, {101}) == VoteStatus::VOTER_NOT_ALLOWED;
         {
-            cout << "Candidate already added to this election.\n";
-            return;
+            VotingSystem replayed;
+            replayed.openLog(logFile);
+            RunoffResult fromLog;
+            ok = ok && VotingService(replayed).getRunoff(5, fromLog) == ServiceStatus::OK &&
+                 sameRunoff(fromLog, system.findElection(5)->runInstantRunoff());
         }
+        ok = ok && system.writeSnapshot();
+        for (int v = 21; v <= 40; v++) // these only live in the log tail
+            ok = ok && (v % 3 ? service.castRankedVote(v, 5, clubBallots[v - 1])
+                              : service.castVote(v, 5, clubBallots[v - 1][0])) == VoteStatus::ACCEPTED;
+        service.getRunoff(5, expected);
+        ok = ok && expected.ballots == 40;
+    }
+    {
+        VotingSystem restored;
+        restored.openLog(logFile, snapFile);
+        VotingService service(restored);
+        RunoffResult runoffAfter;
+        vector<AuditMismatch> mismatches;
+        ok = ok && service.getRunoff(5, runoffAfter) == ServiceStatus::OK && sameRunoff(runoffAfter, expected);
+        ok = ok && service.auditElection(5, mismatches) == ServiceStatus::OK && mismatches.empty();
     }
+    remove(logFile.c_str());
+    remove(snapFile.c_str());
 
-    //  Add candidate
-    targetElection->addCandidate(candidateId);
-    cout << "Candidate " << candidateId
-         << " added to Election " << electionId << " successfully.\n";
+    cout << "Runoff: winner " << trie.winner << " after " << trie.rounds.size() << " rounds, "
+         << ballots.size() << " ballots in " << big.getRankedBallots() << " ranked\n";
+    cout << (ok ? "PASS\n" : "FAIL\n");
 }
 
-void Admin::removeCandidate(int electionId, int candidateId)
+// Ranked ballots into one election, then the trie runoff against counting every ballot.
+void benchRunoff(size_t ballotCount, int candidateCount)
 {
+    cout << "\n===== BENCH: Instant runoff, " << ballotCount << " ballots, " << candidateCount
+         << " candidates =====\n";
+    vector<int> candidates(max(candidateCount, 1));
+    iota(candidates.begin(), candidates.end(), 1);
+    vector<vector<int>> ballots = makeRankedBallots(candidates, ballotCount, 3, 1);
+    size_t preferences = 0;
+    for (const vector<int> &b : ballots)
+        preferences += b.size();
+
+    Election e(1, "Bench", "");
+    for (int c : candidates)
+        e.addCandidate(c);
+    e.open();
+    auto start = chrono::steady_clock::now();
+    for (size_t b = 0; b < ballots.size(); b++)
+        e.recordRankedVote((int)b + 1, ballots[b]);
+    double castSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double trieSeconds = 1e9;
+    RunoffResult trie;
+    for (int r = 0; r < 5; r++)
+    {
+        start = chrono::steady_clock::now();
+        trie = e.runInstantRunoff();
+        trieSeconds = min(trieSeconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    start = chrono::steady_clock::now();
+    RunoffResult naive = naiveRunoff(candidates, ballots);
+    double naiveSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t prefixes = 0;
+    e.forEachRanking([&](const vector<int> &, long long) { prefixes++; });
+    cout << "cast: " << (long long)(ballots.size() / max(castSeconds, 1e-9)) << " ranked ballots/s ("
+         << (double)preferences / max<size_t>(ballots.size(), 1) << " preferences each)\n";
+    cout << "distinct rankings: " << prefixes << "\n";
+    cout << "trie runoff: " << trieSeconds * 1000 << " ms, " << trie.rounds.size() << " rounds, winner "
+         << trie.winner << "\n";
+    cout << "per-ballot runoff: " << naiveSeconds * 1000 << " ms (" << naiveSeconds / max(trieSeconds, 1e-9)
+         << "x slower)" << (sameRunoff(trie, naive) ? "" : " MISMATCH") << "\n";
+}
 
-    Election *targetElection = nullptr;
-    Candidate *targetCandidate = nullptr;
-
-    // 1 Find election
-    for (Election &e : system->getElections())
+// Head-to-head counts the plain way, every pair of every ballot; the reference for countPairwise.
+static PairwiseMatrix naivePairwise(const vector<int> &candidateIds, const vector<vector<int>> &ballots)
+{
+    size_t n = candidateIds.size();
+    PairwiseMatrix matrix{candidateIds, vector<long long>(n * n, 0), (long long)ballots.size()};
+    vector<size_t> position(n);
+    for (const vector<int> &ballot : ballots)
     {
-        if (e.getElectionId() == electionId)
+        fill(position.begin(), position.end(), n); // left off: below everyone ranked
+        for (size_t p = 0; p < ballot.size(); p++)
+            position[lower_bound(candidateIds.begin(), candidateIds.end(), ballot[p]) - candidateIds.begin()] = p;
+        for (size_t i = 0; i < n; i++)
         {
-            targetElection = &e;
-            break;
+            for (size_t j = 0; j < n; j++)
+                matrix.prefer[i * n + j] += position[i] < position[j];
         }
     }
+    return matrix;
+}
 
-    if (!targetElection)
+void testPairwise()
+{
+    cout << "\n===== TEST: Pairwise / Condorcet Counts =====\n";
+    ThreadPool pool(4);
+    // the Schulze method's worked example: a Copeland cycle with E on top by path strength
+    Election example(1, "Schulze", "");
+    for (int c = 1; c <= 5; c++) // A..E
+        example.addCandidate(c);
+    example.open();
+    const pair<int, vector<int>> groups[] = {{5, {1, 3, 2, 5, 4}}, {5, {1, 4, 5, 3, 2}}, {8, {2, 5, 4, 1, 3}},
+                                             {3, {3, 1, 2, 5, 4}}, {7, {3, 1, 5, 2, 4}}, {2, {3, 2, 1, 4, 5}},
+                                             {7, {4, 3, 5, 2, 1}}, {8, {5, 2, 1, 4, 3}}};
+    int voter = 1;
+    for (const auto &group : groups)
     {
-        cout << "Election with ID " << electionId << " not found.\n";
-        return;
+        for (int i = 0; i < group.first; i++)
+            example.recordRankedVote(voter++, group.second);
+    }
+    example.close();
+    PairwiseResult schulze = tabulatePairwise(example.countPairwise(pool));
+    const PairwiseMatrix &m = schulze.matrix;
+    bool ok = m.ballots == 45 && m.at(0, 1) == 20 && m.at(1, 0) == 25 && m.at(0, 3) == 30 && m.at(4, 3) == 31 &&
+              m.at(3, 1) == 12 && m.at(2, 2) == 0;
+    ok = ok && schulze.condorcetWinner == -1 && schulze.schulzeWinner == 5 &&
+         schulze.copeland[0].candidateId == 5 && schulze.copeland[0].votes == 6;
+    const int schulzeOrder[] = {5, 1, 3, 2, 4};
+    for (int i = 0; i < 5; i++)
+        ok = ok && schulze.schulze[i].candidateId == schulzeOrder[i] && schulze.schulze[i].votes == 4 - i;
+
+    // a Condorcet winner, with single-choice votes beating everyone they leave off
+    Election small(2, "Condorcet", "");
+    for (int c : {1, 2, 3})
+        small.addCandidate(c);
+    small.open();
+    for (int i = 0; i < 4; i++)
+        small.recordVote(voter++, 1);
+    for (int i = 0; i < 3; i++)
+        small.recordRankedVote(voter++, {2, 3});
+    for (int i = 0; i < 2; i++)
+        small.recordRankedVote(voter++, {3, 2});
+    PairwiseResult condorcet = tabulatePairwise(small.countPairwise(pool));
+    ok = ok && condorcet.matrix.at(1, 0) == 5 && condorcet.matrix.at(0, 1) == 4 && condorcet.matrix.at(1, 2) == 3 &&
+         condorcet.condorcetWinner == 2 && condorcet.schulzeWinner == 2;
+
+    // random skewed ballots, merged from several workers: matches counting every pair
+    vector<int> candidates(16);
+    iota(candidates.begin(), candidates.end(), 20);
+    vector<vector<int>> ballots = makeRankedBallots(candidates, 40000, 4, 11);
+    Election big(3, "Random", "");
+    for (int c : candidates)
+        big.addCandidate(c);
+    big.open();
+    for (size_t b = 0; b < ballots.size(); b++)
+    {
+        VoteStatus status = ballots[b].size() == 1 && b % 2 ? big.recordVote((int)b + 1, ballots[b][0])
+                                                             : big.recordRankedVote((int)b + 1, ballots[b]);
+        ok = ok && status == VoteStatus::ACCEPTED;
+    }
+    PairwiseMatrix naive = naivePairwise(candidates, ballots);
+    PairwiseMatrix counted = big.countPairwise(pool);
+    ok = ok && counted.prefer == naive.prefer && counted.ballots == naive.ballots;
+    ThreadPool single(1);
+    ok = ok && big.countPairwise(single).prefer == naive.prefer;
+
+    // through the service: closed elections only
+    VotingSystem system;
+    VotingService service(system);
+    service.createElection(7, "Service", "");
+    for (int c = 301; c <= 303; c++)
+    {
+        service.registerUser(UserRole::CANDIDATE, c, "pc" + to_string(c), "pc" + to_string(c) + "@mail.com", "pw");
+        service.addCandidate(7, c);
     }
+    PairwiseResult fromService;
+    ok = ok && service.getPairwise(7, pool, fromService) == ServiceStatus::INVALID_STATE;
+    service.openElection(7);
+    ok = ok && service.getPairwise(7, pool, fromService) == ServiceStatus::INVALID_STATE;
+    service.closeElection(7);
+    ok = ok && service.getPairwise(7, pool, fromService) == ServiceStatus::OK && fromService.matrix.ballots == 0 &&
+         fromService.condorcetWinner == -1 && fromService.schulzeWinner == -1 &&
+         service.getPairwise(8, pool, fromService) == ServiceStatus::ELECTION_NOT_FOUND;
+
+    cout << "Schulze example: winner " << schulze.schulzeWinner << "; random: " << ballots.size() << " ballots, "
+         << candidates.size() << " candidates\n";
+    cout << (ok ? "PASS\n" : "FAIL\n");
+}
 
-    // 2 Find candidate in users
-    for (User *u : system->getUsers())
+// Ranked ballots into one election, then the pairwise matrix from the trie on growing
+// thread counts against counting every pair of every ballot.
+void benchPairwise(size_t ballotCount, int candidateCount)
+{
+    cout << "\n===== BENCH: Pairwise matrix, " << ballotCount << " ballots, " << candidateCount
+         << " candidates =====\n";
+    vector<int> candidates(max(candidateCount, 1));
+    iota(candidates.begin(), candidates.end(), 1);
+    vector<vector<int>> ballots = makeRankedBallots(candidates, ballotCount, 3, 1);
+    Election e(1, "Bench", "");
+    for (int c : candidates)
+        e.addCandidate(c);
+    e.open();
+    for (size_t b = 0; b < ballots.size(); b++)
+        e.recordRankedVote((int)b + 1, ballots[b]);
+    e.close();
+
+    PairwiseMatrix counted;
+    int hardware = max(1, (int)thread::hardware_concurrency());
+    for (int threads = 1; threads <= hardware; threads *= 2)
     {
-        if (u->getUserId() == candidateId)
+        ThreadPool pool(threads);
+        double best = 1e9;
+        for (int r = 0; r < 5; r++)
         {
-            targetCandidate = dynamic_cast<Candidate *>(u);
-            break;
+            auto start = chrono::steady_clock::now();
+            counted = e.countPairwise(pool);
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
         }
+        cout << "trie matrix, " << threads << " threads: " << best * 1000 << " ms\n";
     }
+    auto start = chrono::steady_clock::now();
+    PairwiseResult result = tabulatePairwise(counted);
+    double tabulateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    PairwiseMatrix naive = naivePairwise(candidates, ballots);
+    double naiveSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Copeland + Schulze: " << tabulateSeconds * 1000 << " ms, Condorcet winner "
+         << result.condorcetWinner << ", Schulze winner " << result.schulzeWinner << "\n";
+    cout << "per-ballot matrix: " << naiveSeconds * 1000 << " ms"
+         << (naive.prefer == counted.prefer ? "" : " MISMATCH") << "\n";
+}
 
-    if (!targetCandidate)
+void testScheduler()
+{
+    cout << "\n===== TEST: Election Scheduler =====\n";
+    using Clock = ElectionScheduler::Clock;
+    const int electionCount = 3000;
+    bool ok = true;
     {
-        cout << "User is not a valid candidate or does not exist.\n";
-        return;
+        // driven by hand against a simulated clock, far from the real one
+        VotingSystem system;
+        system.setHashCost(1);
+        system.addUser(Voter(1, "early", "early@mail.com", "123", &system));
+        for (int id = 1; id <= electionCount; id++)
+        {
+            system.addElection(id, "Timed " + to_string(id), "");
+            system.addCandidateToElection(id, 900 + id % 3);
+        }
+        ElectionScheduler scheduler(system);
+        Clock::time_point base = Clock::now() + chrono::hours(24);
+        for (int id = 1; id <= electionCount; id++) // windows in reverse order of id
+        {
+            Clock::time_point openAt = base + chrono::milliseconds(electionCount - id);
+            ok = ok && scheduler.schedule(id, openAt, openAt + chrono::seconds(5)) == ServiceStatus::OK;
+        }
+        ok = ok && scheduler.schedule(electionCount + 1, base, base + chrono::seconds(1)) ==
+                       ServiceStatus::ELECTION_NOT_FOUND &&
+             scheduler.schedule(1, base, base) == ServiceStatus::INVALID_INPUT;
+        ok = ok && scheduler.schedule(2, base + chrono::seconds(20), base + chrono::seconds(30)) == ServiceStatus::OK &&
+             scheduler.cancel(3) && !scheduler.cancel(3) && scheduler.pending() == electionCount - 1;
+
+        ok = ok && scheduler.runDue(base - chrono::seconds(1)) == 0 &&
+             system.findElection(electionCount)->getStatus() == ElectionStatus::CREATED;
+        // the first 1000 ms of windows open; the rest wait
+        ok = ok && scheduler.runDue(base + chrono::milliseconds(999)) == 1000 &&
+             system.findElection(electionCount)->isOpen() && system.findElection(electionCount - 999)->isOpen() &&
+             system.findElection(electionCount - 1000)->getStatus() == ElectionStatus::CREATED;
+        ok = ok && system.castVote(electionCount, 1, 900 + electionCount % 3) == VoteStatus::ACCEPTED;
+
+        // a vote reserved before its close and published during it still makes the final count
+        Election *late = system.findElection(electionCount);
+        uint64_t tallyId = 0;
+        bool reserved = late->reserveVote(2, 900 + electionCount % 3, nullptr, [] {}, tallyId) == VoteStatus::ACCEPTED;
+        thread publisher([&]
+        {
+            this_thread::sleep_for(chrono::milliseconds(50));
+            if (reserved)
+                late->publishVote(2, 900 + electionCount % 3, nullptr, tallyId);
+        });
+
+        // opens and closes both due: the open still goes first
+        ok = ok && reserved && scheduler.runDue(base + chrono::seconds(10)) == 2 * (electionCount - 2) - 1000 &&
+             scheduler.pending() == 1;
+        publisher.join();
+        ElectionResults final;
+        ok = ok && system.findElection(1)->getStatus() == ElectionStatus::CLOSED &&
+             system.findElection(2)->getStatus() == ElectionStatus::CREATED &&
+             system.findElection(3)->getStatus() == ElectionStatus::CREATED;
+        ok = ok && scheduler.getFinalResults(electionCount, final) && final.totalVotes == 2 &&
+             final.results[0].candidateId == 900 + electionCount % 3 && !scheduler.getFinalResults(3, final);
+        ok = ok && scheduler.schedule(1, base, base + chrono::seconds(1)) == ServiceStatus::INVALID_STATE;
+        ok = ok && scheduler.runDue(base + chrono::seconds(40)) == 2 &&
+             system.findElection(2)->getStatus() == ElectionStatus::CLOSED && scheduler.pending() == 0;
     }
 
-    // 3 Remove candidate
-    targetElection->removeCandidate(candidateId);
-    cout << "Candidate " << candidateId
-         << " deleted  from Election " << electionId << " successfully.\n";
+    // on its own thread against the real clock, asleep when nothing is due
+    VotingSystem system;
+    system.addElection(1, "Lunch vote", "");
+    system.addCandidateToElection(1, 42);
+    ElectionScheduler scheduler(system);
+    atomic<int> closes{0};
+    scheduler.setOnClose([&](const ElectionResults &results) { closes += results.electionId == 1; });
+    scheduler.start();
+    this_thread::sleep_for(chrono::milliseconds(100));
+    uint64_t idleWakeups = scheduler.getWakeups();
+    Clock::time_point now = Clock::now();
+    ok = ok && scheduler.schedule(1, now + chrono::milliseconds(20), now + chrono::milliseconds(60)) ==
+                   ServiceStatus::OK;
+    ElectionResults final;
+    for (int waited = 0; waited < 5000 && !scheduler.getFinalResults(1, final); waited += 10)
+        this_thread::sleep_for(chrono::milliseconds(10));
+    ok = ok && closes == 1 && final.electionId == 1 && system.findElection(1)->getStatus() == ElectionStatus::CLOSED;
+    uint64_t busyWakeups = scheduler.getWakeups();
+    this_thread::sleep_for(chrono::milliseconds(100));
+    ok = ok && idleWakeups == 0 && scheduler.getWakeups() == busyWakeups;
+    scheduler.stop();
+
+    cout << electionCount << " elections opened and closed on schedule; thread woke " << busyWakeups
+         << " times for one window\n";
+    cout << (ok ? "PASS\n" : "FAIL\n");
 }
 
-int Admin::createElection()
+// Thousands of windows over a few seconds on the scheduler's own thread: how late the
+// closes land, and the CPU it takes while waiting.
+void benchScheduler(int electionCount, int spreadMillis)
 {
-    int id;
-    cout << "Enter Election ID: ";
-    cin >> id;
-
-    cin.ignore(numeric_limits<streamsize>::max(), '\n'); // to ignore leftover newline or any extra input
+    cout << "\n===== BENCH: Election scheduler, " << electionCount << " elections over " << spreadMillis
+         << " ms =====\n";
+    using Clock = ElectionScheduler::Clock;
+    VotingSystem system;
+    for (int id = 1; id <= electionCount + 1; id++)
+    {
+        system.addElection(id, "Timed", "");
+        system.addCandidateToElection(id, 1);
+    }
+    ElectionScheduler scheduler(system);
+    vector<Clock::time_point> closeAt(electionCount + 1);
+    vector<double> lateMillis;
+    lateMillis.reserve(electionCount);
+    atomic<int> closes{0};
+    scheduler.setOnClose([&](const ElectionResults &results)
+    {
+        lateMillis.push_back(chrono::duration<double, milli>(Clock::now() - closeAt[results.electionId]).count());
+        closes++;
+    });
+    scheduler.start();
+
+    Clock::time_point start = Clock::now() + chrono::milliseconds(100);
+    SplitMix64 rng(1);
+    for (int id = 1; id <= electionCount; id++)
+    {
+        Clock::time_point openAt = start + chrono::microseconds((long long)(rng.uniform() * spreadMillis * 500));
+        closeAt[id] = openAt + chrono::microseconds((long long)(rng.uniform() * spreadMillis * 500) + 1);
+        scheduler.schedule(id, openAt, closeAt[id]);
+    }
+    clock_t cpuStart = clock();
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(spreadMillis) + chrono::seconds(10);
+    while (closes < electionCount && chrono::steady_clock::now() < deadline)
+        this_thread::sleep_for(chrono::milliseconds(20));
+    double busyCpu = (double)(clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    // one far-off window: the thread should sleep straight through
+    scheduler.schedule(electionCount + 1, Clock::now() + chrono::hours(1), Clock::now() + chrono::hours(2));
+    uint64_t wakeups = scheduler.getWakeups();
+    cpuStart = clock();
+    this_thread::sleep_for(chrono::seconds(1));
+    double idleCpu = (double)(clock() - cpuStart) / CLOCKS_PER_SEC;
+    scheduler.stop();
+
+    sort(lateMillis.begin(), lateMillis.end());
+    size_t n = min(lateMillis.size(), (size_t)closes);
+    cout << "closes: " << n << ", lateness p50 " << (n ? lateMillis[n / 2] : 0) << " ms, p99 "
+         << (n ? lateMillis[n * 99 / 100] : 0) << " ms, max " << (n ? lateMillis.back() : 0) << " ms\n";
+    cout << "process CPU while firing: " << busyCpu * 1000 << " ms; while idle for 1 s: " << idleCpu * 1000
+         << " ms, " << scheduler.getWakeups() - wakeups << " wake-ups\n";
+}
 
-    for (const Election &e : system->getElections())
+void testCatalog()
+{
+    cout << "\n===== TEST: Election Catalog Views =====\n";
+    VotingSystem system;
+    VotingService service(system);
+    // ids out of order, far apart and negative: the listing keeps creation order
+    const int ids[] = {7, 2, 1 << 30, -5, 40000};
+    for (int id : ids)
+        service.createElection(id, "E" + to_string(id), "D");
+    vector<ElectionInfo> listed = service.listElections();
+    bool ok = listed.size() == 5;
+    for (size_t i = 0; ok && i < listed.size(); i++)
+        ok = listed[i].electionId == ids[i] && listed[i].title == "E" + to_string(ids[i]);
+    ElectionInfo info;
+    ok = ok && service.getElection(3, info) == ServiceStatus::ELECTION_NOT_FOUND &&
+         service.getElection(1 << 29, info) == ServiceStatus::ELECTION_NOT_FOUND &&
+         service.getElection(-5, info) == ServiceStatus::OK && info.title == "E-5";
+
+    // a view keeps its version while edits land, and holds back their reclamation
+    {
+        CatalogView before = system.viewCatalog();
+        service.updateElection(7, "Renamed", ""); // empty keeps the description
+        system.addCandidateToElection(7, 501);
+        service.openElection(7);
+        CatalogView after = system.viewCatalog();
+        const CatalogEntry *old = before->find(7), *now = after->find(7);
+        ok = ok && old->title == "E7" && old->candidates.empty() && old->status == ElectionStatus::CREATED;
+        ok = ok && now->title == "Renamed" && now->description == "D" && now->candidates == vector<int>{501} &&
+             now->status == ElectionStatus::OPENED && after->number == before->number + 3 && after->size == 5;
+        ok = ok && system.getCatalogRetired() >= 3;
+    }
+    service.closeElection(7); // no view left: everything retired goes
+    ok = ok && system.getCatalogRetired() == 0;
+
+    // readers against a stream of edits: each sees whole versions, never going back
+    system.addElection(100, "Busy", "");
+    atomic<bool> done{false};
+    atomic<long long> reads{0};
+    atomic<bool> consistent{true};
+    vector<thread> readers;
+    for (int r = 0; r < 3; r++)
     {
-        if (e.getElectionId() == id)
+        readers.emplace_back([&]()
         {
-            cout << "Election ID already exists.\n";
-            return -1;
-        }
+            uint64_t last = 0;
+            long long n = 0;
+            while (!done || n == 0)
+            {
+                CatalogView view = system.viewCatalog();
+                const CatalogEntry *e = view->find(100);
+                bool fine = e && view->number >= last && view->size == 6 &&
+                            is_sorted(e->candidates.begin(), e->candidates.end()) &&
+                            adjacent_find(e->candidates.begin(), e->candidates.end()) == e->candidates.end() &&
+                            (e->title == "Busy" || e->title.rfind("Edit ", 0) == 0);
+                if (!fine)
+                    consistent = false;
+                last = view->number;
+                n++;
+            }
+            reads += n;
+        });
     }
-    string title, description;
-
-    cout << "Enter Election Title: ";
-    getline(cin, title);
-
-    cout << "Enter Election Description: ";
-    getline(cin, description);
+    for (int i = 0; i < 3000; i++)
+    {
+        if (i % 3 == 0)
+            system.updateElection(100, "Edit " + to_string(i), "");
+        else if (i % 3 == 1)
+            system.addCandidateToElection(100, 600 + i % 17);
+        else
+            system.removeCandidateFromElection(100, 600 + (i / 3) % 17);
+    }
+    done = true;
+    for (thread &t : readers)
+        t.join();
+    system.updateElection(100, "Quiet", "");
+    ok = ok && consistent && system.getCatalogRetired() == 0;
+
+    // the log and the snapshot rebuild the catalog on startup
+    const string logFile = "test_catalog.wal", snapFile = "test_catalog.snap";
+    remove(logFile.c_str());
+    remove(snapFile.c_str());
+    {
+        VotingSystem logged;
+        logged.openLog(logFile, snapFile);
+        logged.addElection(1, "Before", "Snapshot");
+        logged.addCandidateToElection(1, 11);
+        ok = ok && logged.writeSnapshot();
+        logged.updateElection(1, "After", "Log");
+        logged.openElection(1);
+    }
+    {
+        VotingSystem restored;
+        restored.openLog(logFile, snapFile);
+        ok = ok && VotingService(restored).getElection(1, info) == ServiceStatus::OK && info.title == "After" &&
+             info.description == "Log" && info.status == ElectionStatus::OPENED && info.candidateCount == 1;
+    }
+    remove(logFile.c_str());
+    remove(snapFile.c_str());
 
-    system->getElections().emplace_back(id, title, description); // this will call Election constructor
-    cout << "Election has been created successfully.\n";
-    return id;
-} // completed
+    cout << "Reads during 3000 edits: " << reads << "\n";
+    cout << (ok ? "PASS\n" : "FAIL\n");
+}
 
-void Admin::updateElection(int electionId)
+// Guest reads of election details while an admin thread keeps editing: through a
+// catalog view, against the same reads under a shared_mutex that the edits take alone.
+void benchCatalog(int readerCount, int millis)
 {
+    cout << "\n===== BENCH: Election reads during edits, " << readerCount << " readers, " << millis
+         << " ms each =====\n";
+    const int electionCount = 1000;
+    VotingSystem system;
+    for (int id = 1; id <= electionCount; id++)
+    {
+        system.addElection(id, "Election " + to_string(id), "Bench");
+        for (int c = 1; c <= 8; c++)
+            system.addCandidateToElection(id, 100000 + c);
+    }
+    VotingService service(system);
+    shared_mutex detailsLock; // the locking alternative
 
-    for (Election &e : system->getElections())
+    auto run = [&](const char *name, bool locked, bool editing)
     {
-        if (e.getElectionId() == electionId)
+        atomic<bool> stop{false};
+        atomic<long long> reads{0}, edits{0};
+        vector<thread> threads;
+        for (int r = 0; r < readerCount; r++)
         {
-            string newTitle, newDescription;
-            cout << "Current title: " << e.getTitle() << endl;
-            cout << "Enter new title (or press Enter to keep current): ";
-
-            getline(cin, newTitle);
-            if (!newTitle.empty())
+            threads.emplace_back([&, r]()
             {
-                e.setTitle(newTitle); // updating via setter more safe than direct access via friendship
-            }
-
-            cout << "Current description: " << e.getDescription() << endl;
-            cout << "Enter new description (or press Enter to keep current): ";
-            getline(cin, newDescription);
-            if (!newDescription.empty())
+                SplitMix64 rng(r + 1);
+                ElectionInfo info;
+                long long n = 0;
+                while (!stop.load(memory_order_relaxed))
+                {
+                    int id = 1 + (int)(rng.next() % electionCount);
+                    if (locked)
+                    {
+                        shared_lock<shared_mutex> guard(detailsLock);
+                        const Election *e = system.findElection(id);
+                        info = {id, e->getTitle(), e->getDescription(), e->getStatus(), e->copyCandidates().size()};
+                    }
+                    else
+                        service.getElection(id, info);
+                    n++;
+                }
+                reads += n;
+            });
+        }
+        if (editing)
+        {
+            threads.emplace_back([&]()
             {
-                e.setDescription(newDescription); // updating via setter more safe than direct access via friendship
-            }
-
-            cout << "Election has been updated successfully." << endl;
-            return;
+                long long n = 0;
+                for (int i = 0; !stop.load(memory_order_relaxed); i++)
+                {
+                    int id = 1 + i % electionCount;
+                    unique_lock<shared_mutex> guard(detailsLock, defer_lock);
+                    if (locked)
+                        guard.lock();
+                    system.updateElection(id, "Edit " + to_string(i), "Bench");
+                    if (i / electionCount % 2)
+                        system.addCandidateToElection(id, 100000);
+                    else
+                        system.removeCandidateFromElection(id, 100000);
+                    n++;
+                }
+                edits += n;
+            });
         }
+        this_thread::sleep_for(chrono::milliseconds(millis));
+        stop = true;
+        for (thread &t : threads)
+            t.join();
+        double seconds = millis / 1000.0;
+        cout << name << ": " << (long long)(reads / seconds) << " reads/s";
+        if (editing)
+            cout << ", " << (long long)(edits / seconds) << " edits/s";
+        cout << "\n";
+    };
+    run("locked, no edits", true, false);
+    run("locked, during edits", true, true);
+    run("catalog view, no edits", false, false);
+    run("catalog view, during edits", false, true);
+    cout << "edits awaiting reclamation: " << system.getCatalogRetired() << "\n";
+}
+
+void testMetrics()
+{
+    cout << "\n===== TEST: Latency Metrics =====\n";
+#if VS_METRICS
+    // exact below 16 ns, then every value lands within 1/16 of its bucket's middle
+    bool ok = LatencyHistogram::bucketOf(1ull << 50) == LatencyHistogram::bucketCount - 1;
+    for (uint64_t v : {0ull, 1ull, 15ull, 16ull, 17ull, 31ull, 32ull, 1000ull, 123456789ull, (1ull << 40) - 1})
+    {
+        uint64_t middle = LatencyHistogram::bucketValue(LatencyHistogram::bucketOf(v));
+        ok = ok && (v < 16 ? middle == v : (middle > v ? middle - v : v - middle) <= v / 16);
     }
-    cout << "Election with ID " << electionId << " not found." << endl;
+    LatencyHistogram spread;
+    for (uint64_t i = 1; i <= 10000; i++)
+    {
+        spread.buckets[LatencyHistogram::bucketOf(i * 1000)]++;
+        spread.count++;
+        spread.maxNanos = i * 1000;
+    }
+    ok = ok && llabs((long long)spread.percentile(0.5) - 5000000) <= 5000000 / 16;
+    ok = ok && llabs((long long)spread.percentile(0.99) - 9900000) <= 9900000 / 16;
+    ok = ok && spread.percentile(1.0) == 10000000;
+
+    resetMetrics();
+    VotingSystem system;
+    system.setHashCost(1);
+    VotingService service(system);
+    for (int v = 1; v <= 4; v++)
+        service.registerUser(UserRole::VOTER, v, "mv" + to_string(v), "mv" + to_string(v) + "@mail.com", "pw");
+    service.registerUser(UserRole::CANDIDATE, 10, "mc", "mc@mail.com", "pw");
+    service.createElection(1, "Metrics", "");
+    service.addCandidate(1, 10);
+    service.openElection(1);
+    service.openElection(1); // already open
+    // each voter votes twice from its own thread; the second is a duplicate
+    vector<thread> voters;
+    for (int v = 1; v <= 4; v++)
+        voters.emplace_back([&service, v]()
+        {
+            service.castVote(v, 1, 10);
+            service.castVote(v, 1, 10);
+        });
+    for (thread &t : voters)
+        t.join(); // their blocks retire into the totals
+    User *user;
+    service.login("mv1", "pw", user);
+    service.login("mv1", "wrong", user);
+    ElectionResults results;
+    service.getResults(1, results);
+    service.getResults(99, results);
+    service.closeElection(1);
+
+    vector<LatencyHistogram> metrics = collectMetrics();
+    const LatencyHistogram &votes = metrics[(int)Metric::VOTE];
+    ok = ok && votes.count == 8 && votes.failed == 4 && votes.percentile(0.5) > 0;
+    ok = ok && votes.percentile(0.5) <= votes.percentile(0.99) && votes.percentile(0.99) <= votes.maxNanos;
+    ok = ok && metrics[(int)Metric::LOGIN].count == 2 && metrics[(int)Metric::LOGIN].failed == 1;
+    ok = ok && metrics[(int)Metric::OPEN_ELECTION].count == 2 && metrics[(int)Metric::OPEN_ELECTION].failed == 1;
+    ok = ok && metrics[(int)Metric::CLOSE_ELECTION].count == 1 && metrics[(int)Metric::CLOSE_ELECTION].failed == 0;
+    ok = ok && metrics[(int)Metric::RESULTS].count == 2 && metrics[(int)Metric::VOTE_COUNT].count == 0;
+
+    ostringstream report;
+    writeMetrics(report);
+    cout << report.str();
+    ok = ok && report.str().find("vote: 8 calls, 4 failed") != string::npos;
+    ok = ok && report.str().find("vote_count") == string::npos; // nothing recorded, nothing shown
+
+    string path = (filesystem::temp_directory_path() / "vs_metrics_test.jsonl").string();
+    ok = ok && exportMetrics(path);
+    ifstream exported(path);
+    string line;
+    int lines = 0;
+    while (getline(exported, line))
+        lines += line.rfind("{\"metric\":", 0) == 0;
+    ok = ok && lines == (int)Metric::COUNT;
+    exported.close();
+    filesystem::remove(path);
+
+    resetMetrics();
+    ok = ok && collectMetrics()[(int)Metric::VOTE].count == 0;
+    cout << (ok ? "PASS" : "FAIL") << "\n";
+#else
+    cout << "PASS (metrics compiled out)\n";
+#endif
 }
 
+void testTallyFeed()
+{
+    cout << "\n===== TEST: Live Tally Feed =====\n";
+    VotingSystem system;
+    system.setHashCost(1);
+    VotingService service(system);
+    for (int c = 1; c <= 3; c++)
+        service.registerUser(UserRole::CANDIDATE, 500000 + c, "c" + to_string(c), "c" + to_string(c) + "@mail.com", "pw");
+    for (int v = 1; v <= 3000; v++)
+        service.registerUser(UserRole::VOTER, v, "v" + to_string(v), "v" + to_string(v) + "@mail.com", "pw");
+    for (int e : {10, 11})
+    {
+        service.createElection(e, "E" + to_string(e), "");
+        service.addCandidate(e, 500001);
+        service.addCandidate(e, 500002);
+        service.openElection(e);
+    }
+    service.createElection(12, "Not open", "");
 
-void Admin::openElection(int electionId)
+    TallyFeed &feed = system.getTallyFeed();
+    TallySubscription everything = system.subscribeTallies(), onlyTen = system.subscribeTallies({10});
+    auto sameDeltas = [](const TallyBatch &batch, vector<TallyDelta> expected)
+    {
+        auto key = [](const TallyDelta &d) { return make_tuple(d.electionId, d.candidateId, d.delta, d.total); };
+        vector<TallyDelta> got = batch.changes;
+        auto byKey = [&](const TallyDelta &a, const TallyDelta &b) { return key(a) < key(b); };
+        sort(got.begin(), got.end(), byKey);
+        sort(expected.begin(), expected.end(), byKey);
+        return equal(got.begin(), got.end(), expected.begin(), expected.end(),
+                     [&](const TallyDelta &a, const TallyDelta &b) { return key(a) == key(b); });
+    };
+
+    bool ok = feed.publishNow() == 0; // nothing voted yet
+    for (int v = 1; v <= 5; v++)
+        service.castVote(v, 10, 500001);
+    for (int v = 1; v <= 3; v++)
+        service.castVote(v, 11, 500002);
+    ok = ok && feed.publishNow() == 1;
+    auto batches = everything.next(chrono::milliseconds(0));
+    ok = ok && batches.size() == 1 && !batches[0]->resync &&
+         sameDeltas(*batches[0], {{10, 500001, 5, 5}, {11, 500002, 3, 3}});
+    batches = onlyTen.next(chrono::milliseconds(0));
+    size_t seen = 0;
+    for (const TallyDelta &d : batches[0]->changes)
+        seen += onlyTen.covers(d.electionId);
+    ok = ok && seen == 1 && everything.next(chrono::milliseconds(0)).empty();
+
+    // a burst becomes one delta per candidate; a removed candidate drops to zero
+    for (int v = 6; v <= 2005; v++)
+        service.castVote(v, 10, v % 2 ? 500001 : 500002);
+    service.addCandidate(11, 500003);
+    service.castVote(2006, 11, 500003);
+    service.removeCandidate(11, 500002);
+    ok = ok && feed.publishNow() == 2;
+    batches = everything.next(chrono::milliseconds(0));
+    ok = ok && batches.size() == 1 &&
+         sameDeltas(*batches[0], {{10, 500001, 1000, 1005}, {10, 500002, 1000, 1000},
+                                  {11, 500002, -3, 0}, {11, 500003, 1, 1}});
+
+    // closing publishes the final totals once, then the election is left alone
+    service.castVote(2007, 10, 500002);
+    service.closeElection(10);
+    ok = ok && feed.publishNow() == 3 && feed.publishNow() == 0;
+    batches = everything.next(chrono::milliseconds(0));
+    ok = ok && batches.size() == 1 && batches[0]->closedElections == vector<int>({10}) &&
+         sameDeltas(*batches[0], {{10, 500002, 1, 1001}});
+
+    // a reader further behind than the history gets one resync with the totals
+    TallyFeed shortFeed(system, 2);
+    TallySubscription late(shortFeed, {});
+    shortFeed.publishNow();
+    for (int v = 2008; v <= 2010; v++)
+    {
+        service.castVote(v, 11, 500001);
+        shortFeed.publishNow();
+    }
+    batches = late.next(chrono::milliseconds(0));
+    ok = ok && batches.size() == 1 && batches[0]->resync && batches[0]->sequence == 4 &&
+         sameDeltas(*batches[0], {{10, 500001, 1005, 1005}, {10, 500002, 1001, 1001},
+                                  {11, 500001, 3, 3}, {11, 500003, 1, 1}});
+
+    // the background publisher wakes a waiting reader within a couple of intervals
+    feed.start(chrono::milliseconds(5));
+    service.castVote(2011, 11, 500001);
+    auto start = chrono::steady_clock::now();
+    batches = everything.next(chrono::milliseconds(2000));
+    double waited = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    feed.stop();
+    // the three votes counted for shortFeed were never published here, so they arrive together
+    ok = ok && batches.size() == 1 && sameDeltas(*batches[0], {{11, 500001, 4, 4}}) && waited < 1000;
+    cout << (ok ? "PASS\n" : "FAIL\n");
+}
+
+// subscriberCount readers, each on its own thread and keeping its own totals, while a
+// writer casts votes; latency is publish time to the moment each reader holds the batch.
+void benchFeed(int subscriberCount, int intervalMs)
 {
-    for (Election &e : system->getElections())
+    cout << "\n===== BENCH: Tally feed, " << subscriberCount << " subscribers, " << intervalMs
+         << " ms interval =====\n";
+    const int electionCount = 100, candidatesPerElection = 5, voterCount = 200000;
+    VotingSystem system;
+    system.setHashCost(1);
+    VotingService service(system);
+    for (int c = 1; c <= candidatesPerElection; c++)
+        service.registerUser(UserRole::CANDIDATE, 500000 + c, "c" + to_string(c), "c" + to_string(c) + "@mail.com", "pw");
+    for (int e = 1; e <= electionCount; e++)
     {
-        if (e.getElectionId() == electionId)
+        service.createElection(e, "E" + to_string(e), "");
+        for (int c = 1; c <= candidatesPerElection; c++)
+            service.addCandidate(e, 500000 + c);
+        service.openElection(e);
+    }
+    for (int v = 1; v <= voterCount; v++)
+        service.registerUser(UserRole::VOTER, v, "v" + to_string(v), "v" + to_string(v) + "@mail.com", "pw");
+
+    atomic<bool> done{false};
+    vector<vector<double>> latencies(subscriberCount);
+    vector<map<pair<int, int>, long long>> views(subscriberCount);
+    vector<thread> readers;
+    for (int i = 0; i < subscriberCount; i++)
+        readers.emplace_back([&, i]
         {
-            if (e.getStatus() == ElectionStatus::CREATED)
-            {
-                e.open();
-                cout << "Election " << electionId << " is now open for voting." << endl;
-            }
-            else
-            {
-                cout << "Election " << electionId << " is already " << (e.getStatus() == ElectionStatus::OPENED ? "open" : "closed") << "." << endl;
-            }
-            return;
+            TallySubscription subscription = system.subscribeTallies();
+            while (!done)
+                for (const auto &batch : subscription.next(chrono::milliseconds(100)))
+                {
+                    latencies[i].push_back(
+                        chrono::duration<double, micro>(chrono::steady_clock::now() - batch->publishedAt).count());
+                    for (const TallyDelta &d : batch->changes)
+                    {
+                        long long &votes = views[i][{d.electionId, d.candidateId}];
+                        votes = batch->resync ? d.total : votes + d.delta;
+                    }
+                }
+        });
+
+    TallyFeed &feed = system.getTallyFeed();
+    feed.start(chrono::milliseconds(intervalMs));
+    auto start = chrono::steady_clock::now();
+    long long cast = 0;
+    uint32_t seed = 7;
+    for (int v = 1; v <= voterCount; v++)
+        for (int round = 0; round < 5; round++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            cast += service.castVote(v, 1 + (seed >> 8) % electionCount, 500001 + (seed >> 20) % candidatesPerElection) ==
+                    VoteStatus::ACCEPTED;
         }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    this_thread::sleep_for(chrono::milliseconds(intervalMs * 3)); // let the last batch drain
+    feed.stop();
+    done = true;
+    for (thread &t : readers)
+        t.join();
+
+    vector<double> all;
+    for (const vector<double> &l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    map<pair<int, int>, long long> truth;
+    system.forEachElection([&](const Election &e)
+    {
+        e.forEachTally([&](int candidateId, long long votes)
+        {
+            if (votes)
+                truth[{e.getElectionId(), candidateId}] = votes;
+        });
+    });
+    int consistent = 0;
+    for (auto &view : views)
+    {
+        for (auto it = view.begin(); it != view.end();)
+            it = it->second ? next(it) : view.erase(it);
+        consistent += view == truth;
     }
-    cout << "Election with ID " << electionId << " not found." << endl;
+    cout << cast << " votes in " << seconds * 1000 << " ms while publishing; "
+         << all.size() / max(subscriberCount, 1) << " batches per subscriber\n";
+    if (!all.empty())
+        cout << "fan-out latency: p50 " << all[all.size() / 2] << " us, p99 " << all[all.size() * 99 / 100]
+             << " us, max " << all.back() << " us\n";
+    cout << consistent << "/" << subscriberCount << " subscribers match the final tallies\n";
 }
 
-void Admin::closeElection(int electionId)
+void testService()
 {
-    for (Election &e : system->getElections())
+    cout << "\n===== TEST: Headless Service Layer =====\n";
+    VotingSystem system;
+    system.setHashCost(1); // the throughput loop below measures the service, not the hash
+    VotingService service(system);
+
+    bool ok = service.registerUser(UserRole::ADMIN, 1, "boss", "boss@mail.com", "pw") == ServiceStatus::OK;
+    ok = ok && service.registerUser(UserRole::CANDIDATE, 2, "cara", "cara@mail.com", "pw", "Hi") == ServiceStatus::OK;
+    ok = ok && service.registerUser(UserRole::VOTER, 3, "boss", "x@mail.com", "pw") == ServiceStatus::ALREADY_EXISTS;
+    ok = ok && service.registerUser(UserRole::VOTER, 3, "", "x@mail.com", "pw") == ServiceStatus::INVALID_INPUT;
+
+    User *user = nullptr;
+    ok = ok && service.login("boss", "nope", user) == ServiceStatus::BAD_CREDENTIALS && !user;
+    ok = ok && service.login("boss", "pw", user) == ServiceStatus::OK && user && user->getRole() == UserRole::ADMIN;
+
+    ok = ok && service.createElection(10, "Board", "Pick one") == ServiceStatus::OK;
+    ok = ok && service.createElection(10, "Again", "") == ServiceStatus::ALREADY_EXISTS;
+    ok = ok && service.addCandidate(10, 2) == ServiceStatus::OK;
+    ok = ok && service.addCandidate(10, 2) == ServiceStatus::ALREADY_EXISTS;
+    ok = ok && service.addCandidate(10, 1) == ServiceStatus::USER_NOT_FOUND; // an admin, not a candidate
+    ok = ok && service.addCandidate(11, 2) == ServiceStatus::ELECTION_NOT_FOUND;
+    ok = ok && service.closeElection(10) == ServiceStatus::INVALID_STATE;
+    ok = ok && service.updateElection(10, "", "New text") == ServiceStatus::OK;
+
+    ElectionInfo info;
+    vector<CandidateInfo> candidates;
+    ok = ok && service.getElection(10, info) == ServiceStatus::OK && info.title == "Board" &&
+         info.description == "New text" && info.candidateCount == 1;
+    ok = ok && service.listCandidates(10, candidates) == ServiceStatus::OK && candidates.size() == 1 &&
+         candidates[0].profile == "Hi";
+
+    // drive the core at speed: no terminal in the loop
+    const int voterCount = 100000;
+    for (int v = 100; v < 100 + voterCount; v++)
+        service.registerUser(UserRole::VOTER, v, "v" + to_string(v), "v" + to_string(v) + "@mail.com", "pw");
+    ok = ok && service.castVote(100, 10, 2) == VoteStatus::ELECTION_NOT_OPEN;
+    ok = ok && service.openElection(10) == ServiceStatus::OK && service.openElection(10) == ServiceStatus::INVALID_STATE;
+
+    auto start = chrono::steady_clock::now();
+    long long accepted = 0;
+    for (int v = 100; v < 100 + voterCount; v++)
     {
-        if (e.getElectionId() == electionId)
-        {
-            if (e.getStatus() == ElectionStatus::OPENED)
-            {
-                e.close();
-                cout << "Election " << electionId << " has been closed successfully." << endl;
-            }
-            else
-            {
-                cout << "Election " << electionId << " is already " << (e.getStatus() == ElectionStatus::CLOSED ? "closed" : "not yet open") << "." << endl;
-            }
-            return;
-        }
+        string name = "v" + to_string(v);
+        if (service.login(name, "pw", user) == ServiceStatus::OK &&
+            service.castVote(user->getUserId(), 10, 2) == VoteStatus::ACCEPTED)
+            accepted++;
     }
-    cout << "Election with ID " << electionId << " not found." << endl;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "login + castVote: " << (long long)(voterCount / seconds) << " voters/s\n";
+
+    ElectionResults results;
+    vector<AuditMismatch> mismatches;
+    long long votes = 0;
+    ok = ok && accepted == voterCount && service.castVote(100, 10, 2) == VoteStatus::ALREADY_VOTED;
+    ok = ok && service.closeElection(10) == ServiceStatus::OK;
+    ok = ok && service.getResults(10, results) == ServiceStatus::OK && results.totalVotes == voterCount;
+    ok = ok && service.auditElection(10, mismatches) == ServiceStatus::OK && mismatches.empty();
+    ok = ok && service.getVoteCount(10, 2, votes) == ServiceStatus::OK && votes == voterCount;
+    vector<int> joined;
+    service.forEachCandidateElection(2, [&](int electionId) { joined.push_back(electionId); });
+    ok = ok && joined == vector<int>({10});
+    ok = ok && service.removeCandidate(10, 2) == ServiceStatus::OK && service.removeCandidate(10, 2) == ServiceStatus::NOT_IN_ELECTION;
+    cout << (ok ? "PASS\n" : "FAIL\n");
 }
-//////////////////////////////////////
-/*Guest  methods implementation*/
-void Guest::viewElections()
-{
 
-    cout << "===== Available Elections =====\n";
-    for (const Election &e : system->getElections())
+#ifdef __linux__
+static int connectLoopback(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
     {
-        cout << "ID: " << e.getElectionId()
-             << "  Title: " << e.getTitle()
-             << "  Status: ";
-
-        if (e.getStatus() == ElectionStatus::CREATED)
-            cout << "Created";
-        else if (e.getStatus() == ElectionStatus::OPENED)
-            cout << "Opened";
-        else
-            cout << "Closed";
-
-        cout << endl;
+        if (fd >= 0)
+            close(fd);
+        return -1;
     }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
 }
 
+static bool sendAll(int fd, const string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
 
-void Guest::viewElectionDetails(int electionId)
+// Reads until `count` whole lines arrived; bytes past them stay in `buffer`.
+static bool readReplyLines(int fd, string &buffer, size_t count, vector<string> &lines)
 {
-    for (const Election &e : system->getElections())
+    char chunk[4096];
+    while (true)
     {
-        if (e.getElectionId() == electionId)
+        size_t newline;
+        while (count > 0 && (newline = buffer.find('\n')) != string::npos)
         {
-            cout << "===== Election Details =====\n";
-            cout << "Title: " << e.getTitle() << endl;
-            cout << "Description: " << e.getDescription() << endl;
-            cout << "Status: ";
-
-            if (e.getStatus() == ElectionStatus::CREATED)
-                cout << "Created";
-            else if (e.getStatus() == ElectionStatus::OPENED)
-                cout << "Opened";
-            else
-                cout << "Closed";
-
-            cout << endl;
-            return;
+            lines.push_back(buffer.substr(0, newline));
+            buffer.erase(0, newline + 1);
+            count--;
         }
-
-
+        if (count == 0)
+            return true;
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, n);
     }
-     cout << "Election not found.\n";
 }
 
- void Guest::viewCandidates(int electionId) // tamer , mo3tasem
-     {
-         bool electionFound = false;
-
-         for ( Election& e : system->getElections())
-         {
-             if (e.getElectionId() == electionId)
-             {
-                 electionFound = true;
-                 cout << "Candidates for Election: " << e.getTitle() << "\n";
-
-                 for (int candidateId : e.getCandidates())
-                 {
-                     for (User* u : system->getUsers())
-                     {
-                         if (u->getUserId() == candidateId &&
-                             u->getRole() == "Candidate")
-                         {
-                             cout << "- Candidate ID: " << u->getUserId()
-                                  << ", Username: " << u->getUsername()
-                                  << ", Email: " << u->getEmail() << endl;
-                         }
-                     }
-                 }
-                 return;
-             }
-         }
-
-         if (!electionFound)
-         {
-             cout << "Election with ID " << electionId << " not found.\n";
-         }
-     }
-///////////////////////////////////////////
-/*---  candidate methods implementation */
-
-
-
-void Candidate::registerUser()
+void testServer()
 {
-    User::registerUser(); // call base registration first
+    cout << "\n===== TEST: Voting Server =====\n";
+    VotingSystem system;
+    VotingService service(system);
+    uint32_t cost = system.getHashCost();
+    system.setHashCost(cost * 20); // a password check that takes a while
+    service.registerUser(UserRole::VOTER, 5, "slow", "slow@mail.com", "pw");
+    system.setHashCost(cost);
+    service.registerUser(UserRole::VOTER, 3, "vera", "vera@mail.com", "pw");
+    service.registerUser(UserRole::CANDIDATE, 2, "cara", "cara@mail.com", "pw", "Hi");
+    service.registerUser(UserRole::ADMIN, 4, "ada", "ada@mail.com", "pw");
+    service.createElection(10, "Board", "Pick one");
+    service.addCandidate(10, 2);
+    service.openElection(10);
+
+    VotingServer server(service);
+    bool ok = server.start(0);
+    int fd = ok ? connectLoopback(server.port()) : -1;
+    ok = ok && fd >= 0;
+
+    // pipelined: the whole batch goes out at once, and the last request is split over two writes
+    ok = ok && sendAll(fd, "VOTE 10 2\nLOGIN vera pw\nELECTIONS\nCANDIDATES 10\nVOTE 10 2\nVOTE 10 2\n"
+                           "CANDIDATES 99\nNOPE\nVO");
+    this_thread::sleep_for(chrono::milliseconds(20));
+    ok = ok && sendAll(fd, "TE 11 2\r\nQUIT\n");
+
+    vector<string> expected = {"ERR login as a voter first", "OK 3 " + string(roleName(UserRole::VOTER)) + " ",
+                               "OK 1", "10 Opened 1 Board", "OK 1", "2 cara", "OK",
+                               "ERR " + string(voteStatusName(VoteStatus::ALREADY_VOTED)),
+                               "ERR " + string(serviceStatusName(ServiceStatus::ELECTION_NOT_FOUND)),
+                               "ERR unknown command",
+                               "ERR " + string(voteStatusName(VoteStatus::ELECTION_NOT_FOUND)), "OK bye"};
+    string buffer;
+    vector<string> lines;
+    char extra;
+    ok = ok && readReplyLines(fd, buffer, expected.size(), lines) && lines.size() == expected.size();
+    string token = ok ? lines[1].substr(expected[1].size()) : "";
+    if (ok)
+        lines[1].resize(expected[1].size()); // the token is random
+    ok = ok && lines == expected && token.size() == 32;
+    ok = ok && buffer.empty() && recv(fd, &extra, 1, 0) == 0; // QUIT closes the connection
+    if (fd >= 0)
+        close(fd);
+
+    // a second connection resumes the session without the password, until logout
+    fd = ok ? connectLoopback(server.port()) : -1;
+    ok = ok && fd >= 0 && sendAll(fd, "SESSION " + token + "\nVOTE 10 2\nRANK 10\nRANK 10 2 2\nRANK 10 2\nLOGOUT\nSESSION " +
+                                          token + "\nVOTE 10 2\n");
+    expected = {"OK 3 " + string(roleName(UserRole::VOTER)),
+                "ERR " + string(voteStatusName(VoteStatus::ALREADY_VOTED)),
+                "ERR usage: RANK <electionId> <candidateId>...",
+                "ERR " + string(voteStatusName(VoteStatus::INVALID_RANKING)),
+                "ERR " + string(voteStatusName(VoteStatus::ALREADY_VOTED)), "OK",
+                "ERR unknown or expired session", "ERR login as a voter first"};
+    lines.clear();
+    ok = ok && readReplyLines(fd, buffer, expected.size(), lines) && lines == expected;
+    if (fd >= 0)
+        close(fd);
+
+    // latency stats are for admins only
+    fd = ok ? connectLoopback(server.port()) : -1;
+    ok = ok && fd >= 0 && sendAll(fd, "METRICS\nLOGIN ada pw\nMETRICS\n");
+    lines.clear();
+    ok = ok && readReplyLines(fd, buffer, 3, lines) && lines[0] == "ERR login as an admin first";
+    ok = ok && lines[1].rfind("OK 4 " + string(roleName(UserRole::ADMIN)), 0) == 0 && lines[2].rfind("OK ", 0) == 0;
+    size_t reportLines = ok ? stoul(lines[2].substr(3)) : 0;
+    string adminToken = ok ? lines[1].substr(lines[1].rfind(' ') + 1) : "";
+    lines.clear();
+    ok = ok && reportLines > 0 && readReplyLines(fd, buffer, reportLines, lines);
+    ok = ok && (!VS_METRICS || any_of(lines.begin(), lines.end(), [](const string &l) { return l.rfind("vote: ", 0) == 0; }));
+
+    // logging in again revokes the session it replaces
+    SessionToken replaced;
+    lines.clear();
+    ok = ok && sendAll(fd, "LOGIN ada pw\n") && readReplyLines(fd, buffer, 1, lines) && lines[0].rfind("OK 4 ", 0) == 0;
+    ok = ok && SessionToken::parse(adminToken, replaced) && !service.resolveSession(replaced);
+    if (fd >= 0)
+        close(fd);
+
+    // the slow login runs on a worker: another client is answered while it hashes
+    int slowFd = ok ? connectLoopback(server.port()) : -1;
+    fd = ok ? connectLoopback(server.port()) : -1;
+    ok = ok && slowFd >= 0 && fd >= 0 && sendAll(slowFd, "LOGIN slow pw\nELECTIONS\n");
+    this_thread::sleep_for(chrono::milliseconds(20));
+    string quick, probe(1, 0);
+    lines.clear();
+    ok = ok && sendAll(fd, "ELECTIONS\n") && readReplyLines(fd, quick, 2, lines) && lines[0] == "OK 1";
+    ok = ok && recv(slowFd, &probe[0], 1, MSG_DONTWAIT) < 0 && errno == EAGAIN; // still hashing
+    lines.clear();
+    ok = ok && readReplyLines(slowFd, quick, 3, lines) && lines[0].rfind("OK 5 ", 0) == 0 && lines[1] == "OK 1";
+    for (int f : {slowFd, fd})
+    {
+        if (f >= 0)
+            close(f);
+    }
 
-    string inputProfileInfo;
-    cout << "Enter profile info: ";
-    cin.ignore(); // to ignore the newline character left in the buffer
-    getline(cin, inputProfileInfo);
-    profileInfo = inputProfileInfo;
+    // a full read buffer followed by FIN: every request that arrived still gets its answer
+    string batch;
+    for (int i = 0; i < 1600; i++)
+        batch += "VOTE 10 2\n";
+    batch += "VOTE 10 2" + string(16384 - batch.size() - 10, ' ') + "\n"; // exactly 16 KiB
+    fd = ok ? connectLoopback(server.port()) : -1;
+    ok = ok && fd >= 0 && sendAll(fd, batch) && shutdown(fd, SHUT_WR) == 0;
+    lines.clear();
+    ok = ok && readReplyLines(fd, buffer, 1601, lines) && lines.back() == "ERR login as a voter first";
+    ok = ok && buffer.empty() && recv(fd, &extra, 1, 0) == 0;
+    if (fd >= 0)
+        close(fd);
+
+    long long votes = 0;
+    ok = ok && service.getVoteCount(10, 2, votes) == ServiceStatus::OK && votes == 1;
+    server.stop();
+    cout << (ok ? "PASS\n" : "FAIL\n");
 }
 
-void Candidate::viewMyElections()
+// Each connection logs in as its own voter and votes once in every election, keeping
+// up to `depth` requests in flight; latency is measured from send to reply.
+void benchServer(int connectionCount, int votesPerConnection)
 {
-    cout << "Elections for Candidate " << username << ":\n";
-    auto &elections = system->getElections();
-    for (auto &e : elections)
+    cout << "\n===== BENCH: Voting server, " << connectionCount << " connections x "
+         << votesPerConnection << " votes =====\n";
+    for (int depth : {1, 16, 128})
     {
-        vector<int> candidates = e.getCandidates();
-        for (int cid : candidates)
+        VotingSystem system;
+        system.setHashCost(1);
+        VotingService service(system);
+        for (int c = 1; c <= connectionCount; c++)
+            service.registerUser(UserRole::VOTER, c, "v" + to_string(c), "v" + to_string(c) + "@mail.com", "pw");
+        service.registerUser(UserRole::CANDIDATE, 500001, "c1", "c1@mail.com", "pw");
+        service.registerUser(UserRole::CANDIDATE, 500002, "c2", "c2@mail.com", "pw");
+        for (int e = 1; e <= votesPerConnection; e++)
+        {
+            service.createElection(e, "E" + to_string(e), "");
+            service.addCandidate(e, 500001);
+            service.addCandidate(e, 500002);
+            service.openElection(e);
+        }
+        VotingServer server(service);
+        if (!server.start(0))
         {
-            if (cid == userId)
+            cout << "cannot listen on loopback\n";
+            return;
+        }
+        resetMetrics(); // only the votes below
+
+        vector<vector<double>> latencies(connectionCount);
+        vector<long long> accepted(connectionCount, 0);
+        auto start = chrono::steady_clock::now();
+        vector<thread> clients;
+        for (int c = 0; c < connectionCount; c++)
+            clients.emplace_back([&, c]
             {
-                cout << "Election ID: " << e.getElectionId()
-                     << ", Title: " << e.getTitle() << endl;
-            }
+                int fd = connectLoopback(server.port());
+                string buffer, batch;
+                vector<string> lines;
+                if (fd < 0 || !sendAll(fd, "LOGIN v" + to_string(c + 1) + " pw\n") ||
+                    !readReplyLines(fd, buffer, 1, lines))
+                    return;
+                latencies[c].reserve(votesPerConnection);
+                deque<chrono::steady_clock::time_point> inFlight;
+                char chunk[65536];
+                int next = 1;
+                size_t lineStart = 0;
+                while ((int)latencies[c].size() < votesPerConnection)
+                {
+                    batch.clear();
+                    auto now = chrono::steady_clock::now();
+                    while (next <= votesPerConnection && (int)inFlight.size() < depth)
+                    {
+                        batch.append("VOTE ").append(to_string(next)).append(next % 3 ? " 500001\n" : " 500002\n");
+                        inFlight.push_back(now);
+                        next++;
+                    }
+                    if (!batch.empty() && !sendAll(fd, batch))
+                        break;
+                    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                    if (n <= 0)
+                        break;
+                    auto arrived = chrono::steady_clock::now();
+                    buffer.append(chunk, n);
+                    size_t newline;
+                    while ((newline = buffer.find('\n', lineStart)) != string::npos)
+                    {
+                        if (buffer.compare(lineStart, 2, "OK") == 0)
+                            accepted[c]++;
+                        latencies[c].push_back(chrono::duration<double, micro>(arrived - inFlight.front()).count());
+                        inFlight.pop_front();
+                        lineStart = newline + 1;
+                    }
+                    buffer.erase(0, lineStart);
+                    lineStart = 0;
+                }
+                close(fd);
+            });
+        for (thread &t : clients)
+            t.join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        server.stop();
+
+        vector<double> all;
+        long long total = 0;
+        for (int c = 0; c < connectionCount; c++)
+        {
+            all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+            total += accepted[c];
+        }
+        sort(all.begin(), all.end());
+        bool complete = total == (long long)connectionCount * votesPerConnection;
+        cout << "pipeline depth " << depth << ": " << (long long)(total / seconds) << " votes/s, p50 "
+             << (all.empty() ? 0 : all[all.size() / 2]) << " us, p99 "
+             << (all.empty() ? 0 : all[all.size() * 99 / 100]) << " us" << (complete ? "" : " (INCOMPLETE)") << "\n";
+        if (VS_METRICS)
+        {
+            // inside the server: castVote alone, without the network and queueing
+            LatencyHistogram votes = collectMetrics()[(int)Metric::VOTE];
+            cout << "  castVote in the server: p50 " << votes.percentile(0.5) / 1000.0 << " us, p99 "
+                 << votes.percentile(0.99) / 1000.0 << " us, max " << votes.maxNanos / 1000.0 << " us\n";
         }
     }
 }
+#endif
 
-void Candidate::viewVoteCount(int electionId)
+void testStreamingParser()
 {
-    int count = 0;
-    for (const Vote &v : system->getVotes())
+    cout << "\n===== TEST: Streaming Ballot/Roster Parser =====\n";
+    string dir = filesystem::temp_directory_path().string();
+    string csvPath = dir + "/vs_stream_test.csv", binPath = dir + "/vs_stream_test.bin";
+
+    // odd spacing, CRLF and blank lines, spread over many small windows
+    vector<Ballot> expected;
     {
-        if (v.getElectionId() == electionId &&
-            v.getVoterId() == userId)
+        ofstream csv(csvPath, ios::binary);
+        csv << "election , voter , candidate\r\n";
+        for (int i = 0; i < 50000; i++)
         {
-            count++;
+            Ballot b{i % 7, -i, 100000 + i};
+            expected.push_back(b);
+            if (i % 3 == 0)
+                csv << b.electionId << "," << b.voterId << "," << b.candidateId << "\n";
+            else if (i % 3 == 1)
+                csv << " " << b.electionId << " ,\t" << b.voterId << ", " << b.candidateId << " \r\n\n";
+            else
+                csv << b.electionId << "," << b.voterId << "," << b.candidateId << "\r\n";
         }
+        csv << "1,2\n1,2,3,4\n1,2,99999999999"; // malformed, last one without a newline
     }
-    cout << "Total votes received in Election " << electionId
-         << ": " << count << endl;
-}
-void testGuest(VotingSystem& system);
-
-
-
-
-
-
-
-
-
+    bool ok = writeBallotFile(binPath, expected, true);
 
-void Voter::vote(int electionId, int candidateId)
-{
-    Election* targetElection = nullptr;
-
-    for (Election& e : system->getElections())
+    for (size_t window : {size_t(4096), size_t(64) << 20})
     {
-        if (e.getElectionId() == electionId)
+        for (const string &path : {csvPath, binPath})
         {
-            targetElection = &e;
-            break;
+            vector<Ballot> parsed;
+            vector<size_t> malformed;
+            ok = ok && streamBallotFile(path, [&](const Ballot *ballots, const size_t *, size_t n)
+                                        { parsed.insert(parsed.end(), ballots, ballots + n); },
+                                        malformed, window);
+            ok = ok && parsed.size() == expected.size() && malformed.size() == (path == csvPath ? 3u : 0u);
+            for (size_t i = 0; ok && i < parsed.size(); i++)
+            {
+                ok = parsed[i].electionId == expected[i].electionId && parsed[i].voterId == expected[i].voterId &&
+                     parsed[i].candidateId == expected[i].candidateId;
+            }
         }
     }
 
-    if (!targetElection)
+    string rosterPath = dir + "/vs_stream_roster.csv";
     {
-        cout << "Election not found.\n";
-        return;
+        ofstream roster(rosterPath);
+        roster << "role,userId,username,email,password,profile\n"
+               << "Voter,1,ann,ann@mail.com,pw\n"
+               << "Candidate, 2 , bob , bob@mail.com , pw , Runs for chair\n"
+               << "Admin,3,cy,cy@mail.com,pw\n"
+               << "Voter,4,ann,other@mail.com,pw\n" // line 5: username taken
+               << "Mayor,5,dee,dee@mail.com,pw\n";  // line 6: unknown role
     }
+    VotingSystem system;
+    system.setHashCost(1);
+    RosterReport report = system.importRoster(rosterPath);
+    const Candidate *bob = system.findCandidate(2);
+    ok = ok && report.readable && report.added == 3 && report.duplicates == vector<size_t>({5}) &&
+         report.malformed == vector<size_t>({6}) && system.findVoter(1) && system.findAdmin(3) &&
+         bob && bob->getUsername() == "bob" && bob->getProfileInfo() == "Runs for chair";
+
+    filesystem::remove(csvPath);
+    filesystem::remove(binPath);
+    filesystem::remove(rosterPath);
+    cout << (ok ? "PASS\n" : "FAIL\n");
+}
 
-    if(!targetElection->isOpen())
+void benchParse(size_t ballotCount)
+{
+    cout << "\n===== BENCH: Parse " << ballotCount << " ballots =====\n";
+    string path = (filesystem::temp_directory_path() / "vs_bench_ballots.csv").string();
     {
-        cout << "Election not Open.\n";
-        return;
+        vector<Ballot> ballots;
+        uint32_t seed = 4242;
+        for (size_t i = 0; i < ballotCount; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            ballots.push_back({1 + (int)(seed >> 24) % 50, (int)i + 1, 1000 + (int)(seed >> 8) % 16});
+        }
+        writeBallotFile(path, ballots, false);
     }
+    double megabytes = filesystem::file_size(path) / 1e6;
 
-    bool candidateFound = false;
+    auto report = [&](const char *name, double seconds, size_t count, long long checksum)
+    {
+        cout << name << ": " << seconds * 1000 << " ms, " << (long long)(megabytes / seconds) << " MB/s, "
+             << (long long)(count / seconds / 1e6 * 10) / 10.0 << " M ballots/s (checksum " << checksum << ")\n";
+    };
 
-    for (int cid : targetElection->getCandidates())
+    // the obvious loader: one std::string per line, stoi per field, a Vote per row
     {
-        if (cid == candidateId)
+        auto start = chrono::steady_clock::now();
+        ifstream in(path);
+        string line;
+        getline(in, line); // header
+        vector<Vote> votes;
+        while (getline(in, line))
         {
-            candidateFound = true;
-            break;
+            size_t first = line.find(','), second = line.find(',', first + 1);
+            votes.push_back(Vote((int)votes.size() + 1, stoi(line.substr(0, first)),
+                                 stoi(line.substr(first + 1, second - first - 1)), stoi(line.substr(second + 1))));
         }
+        long long checksum = 0;
+        for (const Vote &v : votes)
+            checksum += v.getCandidateId();
+        report("getline + stoi", chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+               votes.size(), checksum);
     }
 
-    if (!candidateFound)
+    for (size_t window : {size_t(1) << 20, size_t(4) << 20, size_t(64) << 20})
     {
-        cout << "This candidate is not part of this election.\n";
-        return;
+        auto start = chrono::steady_clock::now();
+        vector<size_t> malformed;
+        size_t count = 0;
+        long long checksum = 0;
+        streamBallotFile(path, [&](const Ballot *ballots, const size_t *, size_t n)
+        {
+            count += n;
+            for (size_t i = 0; i < n; i++)
+                checksum += ballots[i].candidateId;
+        }, malformed, window);
+        string name = "mapped, " + to_string(window >> 20) + " MB windows";
+        report(name.c_str(), chrono::duration<double>(chrono::steady_clock::now() - start).count(), count, checksum);
     }
+    filesystem::remove(path);
+}
 
-    if(hasVoted(electionId)){
-        cout << "This candidate is not part of this election.\n";
-        return;
+void testBallotImport()
+{
+    cout << "\n===== TEST: Batch Ballot Import =====\n";
+    const int voterCount = 200000;
+    VotingSystem system;
+    system.setHashCost(1);
+    system.addElection(1, "Paper", "");
+    system.addElection(2, "Not open yet", "");
+    for (int c = 1; c <= 4; c++)
+    {
+        system.addUser(Candidate(500000 + c, "pc" + to_string(c), "pc" + to_string(c) + "@mail.com", "123", "", &system));
+        system.addCandidateToElection(1, 500000 + c);
+        system.addCandidateToElection(2, 500000 + c);
     }
+    system.openElection(1);
+    for (int v = 1; v <= voterCount; v++)
+        system.addUser(Voter(v, "v" + to_string(v), "v" + to_string(v) + "@mail.com", "123", &system));
+    system.castVote(1, 5, 500001); // voted online before the paper import
 
+    string dir = filesystem::temp_directory_path().string();
+    string csvPath = dir + "/vs_import_test.csv";
+    {
+        ofstream csv(csvPath);
+        csv << "electionId,voterId,candidateId\n" // line 1: header
+            << "1,1,500001\n"                     // 2: ok
+            << "1,2,500999\n"                     // 3: not a candidate here
+            << "2,3,500001\n"                     // 4: election not open
+            << "7,4,500001\n"                     // 5: no such election
+            << "1,5,500002\n"                     // 6: voted online already
+            << "1,500001,500002\n"                // 7: a candidate is not a voter
+            << "1,x,500001\n"                     // 8: malformed
+            << "1,6,500003\n"                     // 9: ok
+            << "1,6,500004\n";                    // 10: second ballot from voter 6
+    }
+    BallotFile file;
+    bool ok = readBallotFile(csvPath, file) && file.malformed == vector<size_t>({8});
+    ImportReport report = system.importBallots(file.ballots);
+    vector<pair<size_t, VoteStatus>> expected = {
+        {3, VoteStatus::CANDIDATE_NOT_FOUND}, {4, VoteStatus::ELECTION_NOT_OPEN},
+        {5, VoteStatus::ELECTION_NOT_FOUND}, {6, VoteStatus::ALREADY_VOTED},
+        {7, VoteStatus::VOTER_NOT_ALLOWED}, {10, VoteStatus::ALREADY_VOTED}};
+    ok = ok && report.accepted == 2 && report.rejections.size() == expected.size();
+    for (size_t i = 0; ok && i < expected.size(); i++)
+    {
+        ok = file.sources[report.rejections[i].row] == expected[i].first &&
+             report.rejections[i].status == expected[i].second;
+    }
 
-    int voteId = system->getVotes().size() + 1;
-    Vote newVote(voteId, electionId, userId, candidateId);
-    system->getVotes().push_back(newVote);
-    cout << "Vote submitted successfully.\n";
+    // bulk: binary round trip, then every other voter
+    vector<Ballot> ballots;
+    for (int v = 7; v <= voterCount; v++)
+        ballots.push_back({1, v, 500001 + v % 4});
+    string binPath = dir + "/vs_import_test.bin";
+    BallotFile bulk;
+    ok = ok && writeBallotFile(binPath, ballots, true) && readBallotFile(binPath, bulk) &&
+         bulk.ballots.size() == ballots.size() && bulk.malformed.empty();
+    report = system.importBallots(bulk.ballots);
+    cout << "Imported " << report.accepted << " ballots in " << report.seconds * 1000 << " ms ("
+         << (long long)(report.accepted / max(report.seconds, 1e-9)) << " ballots/s)\n";
+
+    const Election *e = system.findElection(1);
+    long long counted = 0;
+    for (int candidateId : e->copyCandidates())
+        counted += e->getVoteCount(candidateId);
+    ok = ok && report.accepted == (long long)ballots.size() && report.rejections.empty() &&
+         e->getTotalVotes() == 3 + (long long)ballots.size() && counted == e->getTotalVotes() &&
+         system.getVoteCount() == (size_t)e->getTotalVotes() && e->hasVoted(voterCount);
+    Vote last(0, 0, 0, 0);
+    ok = ok && system.findVote((int)system.getVoteCount(), last) && last.getVoterId() == voterCount;
+
+    filesystem::remove(csvPath);
+    filesystem::remove(binPath);
+    cout << (ok ? "PASS\n" : "FAIL\n");
 }
 
+void testCandidateMembership()
+{
+    cout << "\n===== TEST: Candidate Membership Index =====\n";
+    VotingSystem system;
+    system.setHashCost(1);
+    for (int id = 1; id <= 3; id++)
+        system.addElection(id, "Membership", "");
+    for (int c : {305, 301, 303, 302, 304})
+        system.addCandidateToElection(2, c);
+    system.addCandidateToElection(3, 303);
+    system.addCandidateToElection(1, 303);
+
+    bool ok = system.addCandidateToElection(2, 303) == ChangeStatus::REJECTED; // already in
+    ok = ok && system.removeCandidateFromElection(2, 302) == ChangeStatus::APPLIED &&
+         system.removeCandidateFromElection(2, 302) == ChangeStatus::REJECTED;
+    auto electionsOf = [&](int candidateId)
+    {
+        vector<int> ids;
+        system.forEachCandidateElection(candidateId, [&](int electionId) { ids.push_back(electionId); });
+        return ids;
+    };
+    ok = ok && electionsOf(303) == vector<int>({1, 2, 3});
+    ok = ok && electionsOf(302).empty();
+
+    const Election *e = system.findElection(2);
+    ok = ok && e->copyCandidates() == vector<int>({301, 303, 304, 305});
+    ok = ok && e->findCandidate(304) == 2 && e->findCandidate(302) < 0;
+
+    // tallies must stay with their candidate when the set shifts
+    system.openElection(2);
+    system.addVote(Vote(1, 2, 1, 304));
+    system.addCandidateToElection(2, 300);
+    system.removeCandidateFromElection(2, 301);
+    ok = ok && e->getVoteCount(304) == 1 && e->getVoteCount(305) == 0;
+    cout << (ok ? "PASS\n" : "FAIL\n");
+}
 
-bool Voter::hasVoted(int electionId) const
+// Closed elections spread over all shards, plus an open one the pass must skip.
+static void fillResultsElections(VotingSystem &system, int electionCount, size_t voteCount)
 {
-    // Loop through all votes in the system
-    for (const Vote& v : system->getVotes())
+    const int candidatesPerElection = 8;
+    for (int id = 1; id <= electionCount + 1; id++)
     {
-        // Check if this voter has already voted in this election
-        if (v.getVoterId() == userId &&
-            v.getElectionId() == electionId)
-        {
-            return true;
-        }
+        system.addElection(id, "Results", "");
+        for (int c = 1; c <= candidatesPerElection; c++)
+            system.addCandidateToElection(id, id * 100 + c);
+        system.openElection(id);
     }
-
-    // No vote found for this voter in this election
-    return false;
+    uint32_t seed = 777;
+    for (size_t i = 0; i < voteCount; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        int election = 1 + (seed >> 8) % (electionCount + 1);
+        int candidate = election * 100 + 1 + (seed >> 20) % candidatesPerElection;
+        system.addVote(Vote((int)i + 1, election, (int)i + 1, candidate));
+    }
+    for (int id = 1; id <= electionCount; id++)
+        system.closeElection(id);
 }
 
+// every count must match the live tallies of a closed election
+static bool resultsMatchTallies(VotingSystem &system, const vector<ElectionResults> &all)
+{
+    bool ok = true;
+    for (const ElectionResults &er : all)
+    {
+        const Election *e = system.findElection(er.electionId);
+        ok = ok && e && e->getStatus() == ElectionStatus::CLOSED && er.totalVotes == e->getTotalVotes();
+        for (const CandidateResult &r : er.results)
+            ok = ok && e && r.votes == e->getVoteCount(r.candidateId);
+    }
+    return ok;
+}
 
+void testClosedResults()
+{
+    cout << "\n===== TEST: Parallel Results For Closed Elections =====\n";
+    VotingSystem system;
+    system.setHashCost(1);
+    fillResultsElections(system, 3, 200000);
 
+    ThreadPool pool(4);
+    vector<ElectionResults> all = system.computeClosedResults(pool);
+    for (const ElectionResults &er : all)
+    {
+        cout << "Election " << er.electionId << ": " << er.totalVotes << " votes, winner "
+             << er.results.front().candidateId << " (" << er.results.front().votes << ")\n";
+    }
+    bool ok = all.size() == 3 && resultsMatchTallies(system, all);
+    cout << (ok ? "PASS\n" : "FAIL\n");
+}
 
+void benchResults(size_t voteCount)
+{
+    cout << "\n===== BENCH: Results for closed elections, " << voteCount << " votes =====\n";
+    VotingSystem system;
+    system.setHashCost(1);
+    fillResultsElections(system, 200, voteCount);
 
+    bool ok = true;
+    double single = 0;
+    for (int threads : {1, 2, 4, 8})
+    {
+        ThreadPool pool(threads);
+        system.computeClosedResults(pool); // warm up
+        auto start = chrono::steady_clock::now();
+        vector<ElectionResults> all = system.computeClosedResults(pool);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (threads == 1)
+            single = seconds;
+        cout << threads << " thread(s): " << seconds * 1000 << " ms, "
+             << (long long)(voteCount / seconds / 1e6) << " M votes/s, speedup "
+             << single / seconds << "x, " << all.size() << " elections\n";
+        ok = ok && resultsMatchTallies(system, all);
+    }
+    cout << (ok ? "Results match the tallies.\n" : "RESULTS DISAGREE\n");
+}
 
+/* ---------- Allocation counting ---------- */
+// Only the vs_bench binary replaces the global allocator; the application keeps the standard one.
+#ifdef VS_BENCHMARK_MAIN
+// Per-thread count of operator new calls, read by benchUsers.
+static thread_local size_t allocationCount = 0;
 
+// GCC can't see that these replacements pair malloc with free
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
 
+void *operator new(size_t size)
+{
+    allocationCount++;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
 
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
 
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
 
+// the other forms route through the two above, so every pair matches
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
 
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+    allocationCount++;
+    return malloc(size ? size : 1);
+}
 
+void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+    return operator new(size, nothrow);
+}
 
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
 
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
 
+void operator delete(void *p, const nothrow_t &) noexcept
+{
+    free(p);
+}
 
+void operator delete[](void *p, const nothrow_t &) noexcept
+{
+    free(p);
+}
 
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 
-
-
-/* ---------- main ---------- */
-int main()
+// Resident set size, 0 where /proc is not available.
+static size_t currentRssBytes()
 {
-    VotingSystem system;
-    system.fillDate(); // IMPORTANT
-    testGuest(system);//test
-
-    cout << "\n===== TEST: ensure if admins created sucessfully =====\n";
-    for (User *u : system.getUsers())
-    {
-        if (u->getRole() == "Admin")
-        {
-            cout << "Admin User - ID: " << u->getUserId() << ", Username: " << u->getUsername() << endl;
-        }
-    } /// COMPLETED
-    cout << "\n===== TEST: ensure if create election logic is correct =====\n";
-    Admin *adminUser = nullptr;
-    for (User *u : system.getUsers())
+#ifdef _WIN32
+    return 0;
+#else
+    size_t pages = 0, resident = 0;
+    if (FILE *f = fopen("/proc/self/statm", "r"))
     {
-        if (u->getRole() == "Admin")
-        {
-            adminUser = dynamic_cast<Admin *>(u); // to convert from user to admin
-            break;
-        }
+        if (fscanf(f, "%zu %zu", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
     }
-    if (adminUser)
-    {
-        int id = adminUser->createElection(); // Test creating a new election
-        // make sure  that the election created sucessfully
-
-        for (const Election &e : system.getElections())
-        {
-            if (e.getElectionId() == id)
-            {
-                cout << "ID: " << e.getElectionId()
-                     << " | Title: " << e.getTitle()
-                     << " | Status: ";
-
-                if (e.getStatus() == ElectionStatus::CREATED)
-                    cout << "Created";
-                else if (e.getStatus() == ElectionStatus::OPENED)
-                    cout << "Opened";
-                else
-                    cout << "Closed";
-
-                cout << endl;
-            }
-        }
-
-        cout << "Enter the election id : ";
-        cin >> id;
-        cin.ignore();
-        adminUser->updateElection(id);
-        for (const Election &e : system.getElections())
-        {
-            if (e.getElectionId() == id)
-            {
-                cout << "ID: " << e.getElectionId()
-                     << " | Title: " << e.getTitle()
-                     << " | Status: ";
-
-                if (e.getStatus() == ElectionStatus::CREATED)
-                    cout << "Created";
-                else if (e.getStatus() == ElectionStatus::OPENED)
-                    cout << "Opened";
-                else
-                    cout << "Closed | ";
-                cout << e.getDescription();
-
-                cout << endl;
-            }
-        }
-        cout << "Enter the election id : ";
-        cin >> id;
-        adminUser->openElection(id);
-        for (const Election &e : system.getElections())
-        {
-            if (e.getElectionId() == id)
-            {
-                cout << "ID: " << e.getElectionId()
-                     << " | Title: " << e.getTitle()
-                     << " | Status: ";
-
-                if (e.getStatus() == ElectionStatus::CREATED)
-                    cout << "Created ---";
-                else if (e.getStatus() == ElectionStatus::OPENED)
-                    cout << "Opened -- ";
-                else
-                    cout << "Closed | ";
-                cout << e.getDescription();
-
-                cout << endl;
-            }
-        }
-        cout << "Enter the election id to CLOSE IT: ";
-        cin >> id;
-        adminUser->closeElection(id);
-        for (const Election &e : system.getElections())
-        {
-            if (e.getElectionId() == id)
-            {
-                cout << "ID: " << e.getElectionId()
-                     << " | Title: " << e.getTitle()
-                     << " | Status: ";
-
-                if (e.getStatus() == ElectionStatus::CREATED)
-                    cout << "Created";
-                else if (e.getStatus() == ElectionStatus::OPENED)
-                    cout << "Opened";
-                else
-                    cout << "Closed | ";
-                cout << e.getDescription();
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
 
-                cout << endl;
-            }
-        }
+// Runs fn in a child process (where available) so each measurement starts from
+// a heap the others have not grown.
+static void isolated(const function<void()> &fn)
+{
+#ifdef _WIN32
+    fn();
+#else
+    cout.flush();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        fn();
+        cout.flush();
+        _exit(0);
     }
-
-
-    TestCandidate(system);
-
-    return 0;
+    if (child > 0)
+        waitpid(child, nullptr, 0);
+    else
+        fn();
+#endif
 }
 
-void testGuest(VotingSystem& system) // Mo3tasem, Ziad Tamer
+void benchUsers(size_t userCount)
 {
-    cout << "\n===== TEST: Guest View Elections =====\n";
-    Guest guest(&system);
-
-    cout << "\n===== TEST: Guest View Rules =====\n";
-    guest.viewVotingRules();
-
-    // Test view all elections
-    guest.viewElections();
-
-    cout << "\n===== TEST: Guest View Election Details (Election ID = 1) =====\n";
-    guest.viewElectionDetails(1);
-
-    cout << "\n===== TEST: Guest View Election Details (Invalid ID) =====\n";
-    guest.viewElectionDetails(999);
+    cout << "\n===== BENCH: User store, " << userCount << " voters =====\n";
+    // built up front so only the store's own allocations are counted
+    vector<string> names, mails;
+    for (size_t i = 1; i <= userCount; i++)
+    {
+        names.push_back("voter" + to_string(i));
+        mails.push_back("voter" + to_string(i) + "@mail.com");
+    }
 
-    cout << "\n===== TEST: Guest View Candidates (Election ID = 1) =====\n";
-    guest.viewCandidates(1);
+    auto report = [&](const char *label, size_t allocations, size_t rss,
+                      double loadSeconds, double scanSeconds, long long sum)
+    {
+        cout << label << ": " << (double)allocations / userCount << " allocations/user, "
+             << (double)rss / userCount << " RSS bytes/user, load " << loadSeconds * 1000
+             << " ms, scan " << scanSeconds * 1000 << " ms (checksum " << sum << ")\n";
+    };
 
-    cout << "\n===== TEST: Guest View Candidates (Invalid Election ID) =====\n";
-    guest.viewCandidates(999);
+    isolated([&]()
+    {
+        size_t allocations = allocationCount, rss = currentRssBytes();
+        auto start = chrono::steady_clock::now();
+        UserPool<Voter> pool;
+        for (size_t i = 0; i < userCount; i++)
+            pool.emplace((int)i + 1, names[i], mails[i], "123", nullptr);
+        double load = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        allocations = allocationCount - allocations;
+        rss = currentRssBytes() - rss;
+
+        long long sum = 0;
+        start = chrono::steady_clock::now();
+        pool.forEach([&](const Voter &v)
+                     { sum += v.getBanStatus() ? 0 : v.getUserId(); });
+        report("UserPool", allocations, rss, load,
+               chrono::duration<double>(chrono::steady_clock::now() - start).count(), sum);
+    });
+
+    // what addUser(new Voter(...)) used to do
+    isolated([&]()
+    {
+        size_t allocations = allocationCount, rss = currentRssBytes();
+        auto start = chrono::steady_clock::now();
+        vector<User *> users;
+        for (size_t i = 0; i < userCount; i++)
+            users.push_back(new Voter((int)i + 1, names[i], mails[i], "123", nullptr));
+        double load = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        allocations = allocationCount - allocations;
+        rss = currentRssBytes() - rss;
+
+        long long sum = 0;
+        start = chrono::steady_clock::now();
+        for (const User *u : users)
+            sum += u->getBanStatus() ? 0 : u->getUserId();
+        report("new per user", allocations, rss, load,
+               chrono::duration<double>(chrono::steady_clock::now() - start).count(), sum);
+        for (User *u : users)
+            delete u;
+    });
 }
-
+#endif // VS_BENCHMARK_MAIN
 
 void TestCandidate(VotingSystem &system) // Youssef Wagih
 {
@@ -1025,50 +10820,41 @@ void TestCandidate(VotingSystem &system) // Youssef Wagih
         cout << "UserID: " << u->getUserId()
              << ", Username: " << u->getUsername()
              << ", Email: " << u->getEmail()
-             << ", password: " << u->getPassword()
-             << ", Role: " << u->getRole() << endl;
+             << ", credential: " << u->getCredential().encode()
+             << ", Role: " << roleName(u->getRole()) << endl;
     }
     cout << "===== TEST: Candidate Login (Existing) =====\n";
 
     // // Existing candidate (from fillDate)
     Candidate *existingCandidate = nullptr;
 
-    for (User *u : system.getUsers())
-    {
-        if (u->getRole() == "Candidate")
-        {
-            existingCandidate = dynamic_cast<Candidate *>(u);
-            break;
-        }
-    }
+    if (system.getCandidates().size() > 0)
+        existingCandidate = &system.getCandidates()[0];
 
     if (existingCandidate)
     {
         existingCandidate->login();           // test login
         existingCandidate->viewMyElections(); // test elections
         existingCandidate->logout();          // test logout
-        for (Election &e : system.getElections())
+        // viewVoteCount looks the election up, so it can't run inside the index read
+        vector<int> electionIds;
+        system.forEachCandidateElection(existingCandidate->getUserId(),
+                                        [&](int electionId) { electionIds.push_back(electionId); });
+        for (int electionId : electionIds)
         {
-            vector<int> candidates = e.getCandidates();
-            for (int cid : candidates)
-            {
-                if (cid == existingCandidate->getUserId())
-                {
-                    cout << "\nViewing vote count for Election ID: " << e.getElectionId() << " : " << e.getElectionId() << endl;
-                }
-            }
+            cout << "\nViewing vote count for Election ID: " << electionId << endl;
+            existingCandidate->viewVoteCount(electionId);
         }
     }
 
     cout << "\n===== TEST: Candidate Registration =====\n";
 
-    Candidate *newCandidate =
-        new Candidate(999, "", "", "", "", &system);
+    Candidate newCandidate(999, "", "", "", "", &system);
 
-    newCandidate->registerUser(); // should add itself to system users
+    newCandidate.registerUser(); // should add a copy of itself to system users
 
     cout << "\n===== TEST: Login After Registration =====\n";
-    newCandidate->login();
+    newCandidate.login();
 
     cout << "\n===== TEST COMPLETE =====\n";
 }